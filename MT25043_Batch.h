@@ -0,0 +1,205 @@
+// MT25043
+//
+// File: MT25043_Batch.h
+//
+// Description: Packs K consecutive messages into one msghdr for sendmsg().
+// K is bounded by IOV_MAX iovecs and an optional byte budget. It is either
+// fixed (-B K) or adapted at runtime from the socket's send-queue depth
+// (-B auto):
+// - queue below 1/4 of SO_SNDBUF: the sender is the bottleneck, so K doubles
+//   to spread each syscall over more messages
+// - queue above 3/4 of SO_SNDBUF: the receiver is the bottleneck, so K halves
+//   because larger batches only add burstiness and latency
+// Every batch slot takes the next message from the payload generator. The
+// K messages of a batch are in flight together, so counter and random
+// payloads fill a private message per slot instead of rewriting one.
+// ============================================================================
+
+#ifndef MT25043_BATCH_H
+#define MT25043_BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/sockios.h>
+
+#include "MT25043_Message.h"
+#include "MT25043_Payload.h"
+#include "MT25043_Crc32c.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#define BATCH_PROBE_INTERVAL 8 // sendmsg() calls between SIOCOUTQ probes
+
+typedef struct {
+    int sock;
+    const schema_t* schema;
+    int k;                  // Messages in the next batch
+    int max_k;              // IOV_MAX / byte-budget bound
+    int adaptive;
+    int checksum;
+    int iov_per_msg;
+    int sndbuf;
+    int probe_countdown;
+    struct iovec* iov;
+    message_t** msgs;       // Per-slot messages for refilling payloads, else NULL
+    uint32_t* crcs;         // Checksums of msgs
+    int nmsgs;              // Slots with a message so far
+    long syscalls;
+    long messages;
+    long probes;
+    int min_seen_k;
+    int max_seen_k;
+} batcher_t;
+
+// Gives the first k slots their own message when the payload refills.
+// Returns how many slots are ready, which is less than k only if
+// allocation failed.
+static inline int batcher_reserve(batcher_t* b, int k) {
+    if (!b->msgs) {
+        return k;
+    }
+    while (b->nmsgs < k) {
+        b->msgs[b->nmsgs] = create_message(b->schema);
+        if (!b->msgs[b->nmsgs]) {
+            break;
+        }
+        b->nmsgs++;
+    }
+    return b->nmsgs;
+}
+
+// batch <= 0 selects adaptive K. byte_budget == 0 means IOV_MAX only.
+static inline int batcher_init(batcher_t* b, int sock, int batch, size_t byte_budget, const payload_t* payload) {
+    const schema_t* schema = payload->schema;
+    int checksum = payload->checksum;
+    memset(b, 0, sizeof(*b));
+    b->sock = sock;
+    b->schema = schema;
+    b->checksum = checksum;
+    b->iov_per_msg = schema->num_fields + (checksum ? 1 : 0);
+
+    size_t frame = schema->total + (checksum ? CRC32C_TRAILER_SIZE : 0);
+    b->max_k = IOV_MAX / b->iov_per_msg;
+    if (byte_budget > 0 && (size_t)b->max_k * frame > byte_budget) {
+        b->max_k = (int)(byte_budget / frame);
+    }
+    if (b->max_k < 1) b->max_k = 1;
+
+    b->adaptive = batch <= 0;
+    b->k = b->adaptive ? 1 : (batch < b->max_k ? batch : b->max_k);
+    b->min_seen_k = b->max_seen_k = b->k;
+
+    socklen_t len = sizeof(b->sndbuf);
+    if (getsockopt(sock, SOL_SOCKET, SO_SNDBUF, &b->sndbuf, &len) < 0) {
+        b->sndbuf = 0;
+    }
+    b->probe_countdown = BATCH_PROBE_INTERVAL;
+
+    b->iov = (struct iovec*)malloc((size_t)b->max_k * b->iov_per_msg * sizeof(struct iovec));
+    if (!b->iov) {
+        perror("Failed to allocate batch iovecs");
+        return -1;
+    }
+    if (payload_refills(payload)) {
+        b->msgs = (message_t**)calloc((size_t)b->max_k, sizeof(message_t*));
+        b->crcs = (uint32_t*)calloc((size_t)b->max_k, sizeof(uint32_t));
+        if (!b->msgs || !b->crcs || batcher_reserve(b, b->k) < b->k) {
+            perror("Failed to allocate batch messages");
+            for (int i = 0; i < b->nmsgs; i++) {
+                free_message(b->msgs[i]);
+            }
+            free(b->msgs);
+            free(b->crcs);
+            free(b->iov);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Points hdr at the next K messages. Returns K.
+static inline int batcher_fill(batcher_t* b, payload_t* payload, struct msghdr* hdr) {
+    struct iovec* iov = b->iov;
+    for (int m = 0; m < b->k; m++) {
+        message_t* msg;
+        const uint32_t* crc;
+        if (b->msgs) {
+            msg = b->msgs[m];
+            payload_refill(payload, msg, &b->crcs[m]);
+            crc = &b->crcs[m];
+        } else {
+            msg = payload_next(payload);
+            crc = payload_crc(payload);
+        }
+        const schema_t* schema = msg->schema;
+        for (int i = 0; i < schema->num_fields; i++) {
+            iov->iov_base = msg->field[i];
+            iov->iov_len = schema->size[i];
+            iov++;
+        }
+        if (b->checksum) {
+            iov->iov_base = (void*)crc;
+            iov->iov_len = CRC32C_TRAILER_SIZE;
+            iov++;
+        }
+    }
+    hdr->msg_iov = b->iov;
+    hdr->msg_iovlen = (size_t)(iov - b->iov);
+    return b->k;
+}
+
+// Records a completed sendmsg() of msgs messages and adapts K if enabled.
+static inline void batcher_sent(batcher_t* b, int msgs) {
+    b->syscalls++;
+    b->messages += msgs;
+
+    if (!b->adaptive || b->sndbuf <= 0 || --b->probe_countdown > 0) {
+        return;
+    }
+    b->probe_countdown = BATCH_PROBE_INTERVAL;
+
+    int queued = 0;
+    if (ioctl(b->sock, SIOCOUTQ, &queued) < 0) {
+        return;
+    }
+    b->probes++;
+    if (queued < b->sndbuf / 4 && b->k < b->max_k) {
+        b->k = batcher_reserve(b, b->k * 2 < b->max_k ? b->k * 2 : b->max_k);
+    } else if (queued > b->sndbuf / 4 * 3 && b->k > 1) {
+        b->k /= 2;
+    }
+    if (b->k < b->min_seen_k) b->min_seen_k = b->k;
+    if (b->k > b->max_seen_k) b->max_seen_k = b->k;
+}
+
+static inline void batcher_report(const batcher_t* b, int client_socket) {
+    if (b->syscalls == 0) {
+        return;
+    }
+    printf("Server: Socket %d sent %ld messages in %ld sendmsg calls "
+           "(%.3f syscalls/message, batch %s %d-%d of max %d, %ld queue probes)\n",
+           client_socket, b->messages, b->syscalls, (double)b->syscalls / b->messages,
+           b->adaptive ? "auto" : "fixed", b->min_seen_k, b->max_seen_k, b->max_k, b->probes);
+}
+
+static inline void batcher_destroy(batcher_t* b) {
+    for (int i = 0; i < b->nmsgs; i++) {
+        free_message(b->msgs[i]);
+    }
+    free(b->msgs);
+    free(b->crcs);
+    free(b->iov);
+    b->msgs = NULL;
+    b->crcs = NULL;
+    b->iov = NULL;
+    b->nmsgs = 0;
+}
+
+#endif // MT25043_BATCH_H
@@ -0,0 +1,152 @@
+// MT25043
+//
+// File: MT25043_Copy.h
+//
+// Description: Gather kernels that serialize the fields of a message_t into
+// one contiguous send buffer. Small messages use plain memcpy(); large ones
+// can use AVX2 or AVX-512 loads with non-temporal (streaming) stores so the
+// copy does not evict the rest of the working set from cache. The kernel is
+// chosen at runtime from the CPU features reported by __builtin_cpu_supports.
+// ============================================================================
+
+#ifndef MT25043_COPY_H
+#define MT25043_COPY_H
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <immintrin.h>
+
+#include "MT25043_Message.h"
+
+#define COPY_NT_THRESHOLD 32768 // Messages at least this large use streaming stores
+
+typedef enum {
+    COPY_KERNEL_AUTO = 0,
+    COPY_KERNEL_MEMCPY,
+    COPY_KERNEL_AVX2,
+    COPY_KERNEL_AVX512
+} copy_kernel_t;
+
+static const char* const copy_kernel_names[] = { "auto", "memcpy", "avx2", "avx512" };
+
+static inline int parse_copy_kernel(const char* name, copy_kernel_t* kernel) {
+    for (int i = 0; i < (int)(sizeof(copy_kernel_names) / sizeof(copy_kernel_names[0])); i++) {
+        if (strcasecmp(name, copy_kernel_names[i]) == 0) {
+            *kernel = (copy_kernel_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline const char* copy_kernel_name(copy_kernel_t kernel) {
+    return copy_kernel_names[kernel];
+}
+
+static inline int copy_kernel_supported(copy_kernel_t kernel) {
+    __builtin_cpu_init();
+    switch (kernel) {
+    case COPY_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case COPY_KERNEL_AVX512:
+        return __builtin_cpu_supports("avx512f");
+    default:
+        return 1;
+    }
+}
+
+// Resolves "auto" to a concrete kernel for one message size: memcpy below
+// the threshold, otherwise the widest streaming kernel the CPU supports.
+static inline copy_kernel_t copy_kernel_select(copy_kernel_t requested, size_t msg_size, size_t nt_threshold) {
+    if (requested != COPY_KERNEL_AUTO) {
+        return requested;
+    }
+    if (msg_size < nt_threshold) {
+        return COPY_KERNEL_MEMCPY;
+    }
+    if (copy_kernel_supported(COPY_KERNEL_AVX512)) {
+        return COPY_KERNEL_AVX512;
+    }
+    if (copy_kernel_supported(COPY_KERNEL_AVX2)) {
+        return COPY_KERNEL_AVX2;
+    }
+    return COPY_KERNEL_MEMCPY;
+}
+
+// Streaming copies need an aligned destination: the unaligned head and the
+// sub-vector tail go through memcpy(), the body through 32/64-byte NT stores.
+static inline __attribute__((target("avx2")))
+void copy_stream_avx2(char* dst, const char* src, size_t len) {
+    size_t head = (32 - ((uintptr_t)dst & 31)) & 31;
+    if (head > len) head = len;
+    memcpy(dst, src, head);
+    dst += head; src += head; len -= head;
+
+    while (len >= 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(src + 96));
+        _mm256_stream_si256((__m256i*)(dst), a);
+        _mm256_stream_si256((__m256i*)(dst + 32), b);
+        _mm256_stream_si256((__m256i*)(dst + 64), c);
+        _mm256_stream_si256((__m256i*)(dst + 96), d);
+        dst += 128; src += 128; len -= 128;
+    }
+    while (len >= 32) {
+        _mm256_stream_si256((__m256i*)dst, _mm256_loadu_si256((const __m256i*)src));
+        dst += 32; src += 32; len -= 32;
+    }
+    memcpy(dst, src, len);
+}
+
+static inline __attribute__((target("avx512f")))
+void copy_stream_avx512(char* dst, const char* src, size_t len) {
+    size_t head = (64 - ((uintptr_t)dst & 63)) & 63;
+    if (head > len) head = len;
+    memcpy(dst, src, head);
+    dst += head; src += head; len -= head;
+
+    while (len >= 256) {
+        __m512i a = _mm512_loadu_si512((const void*)(src));
+        __m512i b = _mm512_loadu_si512((const void*)(src + 64));
+        __m512i c = _mm512_loadu_si512((const void*)(src + 128));
+        __m512i d = _mm512_loadu_si512((const void*)(src + 192));
+        _mm512_stream_si512((void*)(dst), a);
+        _mm512_stream_si512((void*)(dst + 64), b);
+        _mm512_stream_si512((void*)(dst + 128), c);
+        _mm512_stream_si512((void*)(dst + 192), d);
+        dst += 256; src += 256; len -= 256;
+    }
+    while (len >= 64) {
+        _mm512_stream_si512((void*)dst, _mm512_loadu_si512((const void*)src));
+        dst += 64; src += 64; len -= 64;
+    }
+    memcpy(dst, src, len);
+}
+
+// Serializes all fields of msg into dst with the given (resolved) kernel.
+static inline void gather_message(char* dst, const message_t* msg, copy_kernel_t kernel) {
+    for (int i = 0; i < msg->schema->num_fields; i++) {
+        size_t field_size = msg->schema->size[i];
+        switch (kernel) {
+        case COPY_KERNEL_AVX2:
+            copy_stream_avx2(dst, msg->field[i], field_size);
+            break;
+        case COPY_KERNEL_AVX512:
+            copy_stream_avx512(dst, msg->field[i], field_size);
+            break;
+        default:
+            memcpy(dst, msg->field[i], field_size);
+            break;
+        }
+        dst += field_size;
+    }
+    if (kernel == COPY_KERNEL_AVX2 || kernel == COPY_KERNEL_AVX512) {
+        // Streaming stores are weakly ordered: fence before send() reads them
+        _mm_sfence();
+    }
+}
+
+#endif // MT25043_COPY_H
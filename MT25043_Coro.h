@@ -0,0 +1,401 @@
+// MT25043
+//
+// File: MT25043_Coro.h
+//
+// Description: M:N coroutine runtime for the clients (--coro THREADS).
+// Every session is a coroutine with its own small stack (ucontext), and a
+// few scheduler threads each run many sessions over one epoll instance.
+// The session code stays sequential: coro_connect(), coro_send(),
+// coro_recv() and coro_wait_io() retry a non-blocking call after parking
+// the coroutine until its socket is ready. Outside a coroutine they are the
+// plain blocking calls, so the same run_client() serves both models.
+//
+// A scheduler runs every ready session until it parks, yields or returns,
+// then collects readiness events with epoll_wait() (one-shot, one socket
+// per parked session), blocking only when no session is ready. A session
+// whose socket always has data would never park, so the receive loop calls
+// coro_tick(): after CORO_SLICE_RECVS receives or CORO_SLICE_NS of running
+// the session yields, back to the end of the run queue. Sessions never
+// move between threads. The
+// per-thread state of other modules (metrics slot, trace ring) is swapped
+// in and out with the coroutine, so each session keeps its own.
+//
+// Overhead: a scheduler's wall time minus the time sessions ran and minus
+// its blocking epoll_wait() calls is what the runtime itself cost (context
+// switches, epoll registration, run queue). It is reported per resume.
+// glibc's swapcontext() also saves the signal mask with a system call,
+// which is most of a switch.
+// ============================================================================
+
+#ifndef MT25043_CORO_H
+#define MT25043_CORO_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "MT25043_Metrics.h"
+#include "MT25043_Trace.h"
+
+#define CORO_DEFAULT_STACK (64 * 1024)
+#define CORO_MAX_EVENTS 256
+#define CORO_SLICE_RECVS 8          // Receives before a busy session yields
+#define CORO_SLICE_NS 20000         // Or this long running, whichever is first
+
+typedef void* (*coro_fn)(void* arg);
+
+struct coro_sched;
+
+typedef struct {
+    ucontext_t ctx;
+    struct coro_sched* sched;
+    coro_fn fn;
+    void* arg;
+    char* stack;                    // mmap()ed; the lowest page is a guard
+    size_t stack_size;
+    int done;
+    int wait_fd;                    // Last socket registered with epoll, or -1
+    int slice_recvs;                // Receives since the session last parked or yielded
+    metrics_slot_t* metrics_slot;   // Thread-local state while it runs
+    trace_ring_t* trace_ring;
+} coro_t;
+
+typedef struct coro_sched {
+    int epfd;
+    ucontext_t main_ctx;
+    coro_t** coros;
+    int count;
+    int live;                       // Spawned and not yet returned
+    coro_t** runq;                  // Ring of ready sessions, count slots
+    int head;
+    int queued;
+    coro_t* current;
+    size_t stack_size;
+    pthread_t thread;
+    // Overhead accounting (nanoseconds)
+    long run_start;
+    long run_ns;                    // Inside sessions
+    long idle_ns;                   // Blocked in epoll_wait() with nothing ready
+    long total_ns;
+    uint64_t resumes;
+    uint64_t parks;                 // Sessions parked waiting for I/O
+    uint64_t yields;                // Sessions that used up their slice
+    uint64_t waits;                 // epoll_wait() calls
+} coro_sched_t;
+
+static __thread coro_sched_t* t_coro_sched = NULL;
+
+static inline long coro_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static inline coro_t* coro_current(void) {
+    return t_coro_sched ? t_coro_sched->current : NULL;
+}
+
+static inline void coro_ready(coro_sched_t* s, coro_t* c) {
+    s->runq[(s->head + s->queued) % s->count] = c;
+    s->queued++;
+}
+
+static inline void coro_entry(void) {
+    coro_sched_t* s = t_coro_sched;
+    coro_t* c = s->current;
+    s->run_start = coro_now_ns();
+    c->fn(c->arg);
+    s->run_ns += coro_now_ns() - s->run_start;
+    c->done = 1;
+    // Returning switches to uc_link, the scheduler
+}
+
+static inline void coro_destroy(coro_sched_t* scheds, int threads);
+
+// Schedulers for sessions coroutines on threads OS threads. Spawn every
+// session, then coro_start().
+static inline coro_sched_t* coro_create(int threads, int sessions, size_t stack_size) {
+    coro_sched_t* scheds = (coro_sched_t*)calloc(threads, sizeof(coro_sched_t));
+    if (!scheds) {
+        perror("Coro: failed to allocate schedulers");
+        return NULL;
+    }
+    int per_thread = (sessions + threads - 1) / threads;
+    for (int i = 0; i < threads; i++) {
+        coro_sched_t* s = &scheds[i];
+        s->stack_size = stack_size;
+        s->epfd = epoll_create1(EPOLL_CLOEXEC);
+        s->coros = (coro_t**)calloc(per_thread, sizeof(coro_t*));
+        s->runq = (coro_t**)calloc(per_thread, sizeof(coro_t*));
+        if (s->epfd < 0 || !s->coros || !s->runq) {
+            perror("Coro: failed to create scheduler");
+            coro_destroy(scheds, i + 1);
+            return NULL;
+        }
+    }
+    return scheds;
+}
+
+static inline int coro_spawn(coro_sched_t* s, coro_fn fn, void* arg) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    coro_t* c = (coro_t*)calloc(1, sizeof(coro_t));
+    if (!c) {
+        perror("Coro: failed to allocate session");
+        return -1;
+    }
+    c->stack_size = (s->stack_size + page - 1) / page * page + page;
+    c->stack = (char*)mmap(NULL, c->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (c->stack == MAP_FAILED) {
+        perror("Coro: failed to map session stack");
+        free(c);
+        return -1;
+    }
+    mprotect(c->stack, page, PROT_NONE); // Overflow faults instead of corrupting a neighbour
+    getcontext(&c->ctx);
+    c->ctx.uc_stack.ss_sp = c->stack;
+    c->ctx.uc_stack.ss_size = c->stack_size;
+    c->ctx.uc_link = &s->main_ctx;
+    makecontext(&c->ctx, coro_entry, 0);
+    c->sched = s;
+    c->fn = fn;
+    c->arg = arg;
+    c->wait_fd = -1;
+    s->coros[s->count++] = c;
+    s->live++;
+    coro_ready(s, c);
+    return 0;
+}
+
+static inline void coro_resume(coro_sched_t* s, coro_t* c) {
+    s->current = c;
+    s->resumes++;
+    t_metrics_slot = c->metrics_slot;
+    t_trace_ring = c->trace_ring;
+    swapcontext(&s->main_ctx, &c->ctx);
+    c->metrics_slot = t_metrics_slot;
+    c->trace_ring = t_trace_ring;
+    t_metrics_slot = NULL;
+    t_trace_ring = NULL;
+    s->current = NULL;
+    if (c->done) {
+        munmap(c->stack, c->stack_size);
+        c->stack = NULL;
+        s->live--;
+    }
+}
+
+// Call right after a socket call failed. In a coroutine, and if it failed
+// only because it would block, parks the session until fd is ready for
+// events and returns 1: retry the call. Otherwise returns 0 (errno kept).
+static inline int coro_wait_io(int fd, uint32_t events) {
+    coro_t* c = coro_current();
+    if (!c || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINPROGRESS)) {
+        return 0;
+    }
+    coro_sched_t* s = c->sched;
+    s->run_ns += coro_now_ns() - s->run_start;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events | EPOLLONESHOT;
+    ev.data.ptr = c;
+    // One-shot registrations stay in the set disarmed: re-arm them
+    int op = c->wait_fd == fd ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(s->epfd, op, fd, &ev) < 0) {
+        op = op == EPOLL_CTL_MOD ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        if ((errno != ENOENT && errno != EEXIST) || epoll_ctl(s->epfd, op, fd, &ev) < 0) {
+            s->run_start = coro_now_ns();
+            return 0;
+        }
+    }
+    c->wait_fd = fd;
+    c->slice_recvs = 0;
+    s->parks++;
+    swapcontext(&c->ctx, &s->main_ctx);
+    s->run_start = coro_now_ns();
+    return 1;
+}
+
+// Puts the running session back on the run queue so the others get a turn.
+// A no-op outside a coroutine.
+static inline void coro_yield(void) {
+    coro_t* c = coro_current();
+    if (!c) {
+        return;
+    }
+    coro_sched_t* s = c->sched;
+    s->run_ns += coro_now_ns() - s->run_start;
+    c->slice_recvs = 0;
+    s->yields++;
+    coro_ready(s, c);
+    swapcontext(&c->ctx, &s->main_ctx);
+    s->run_start = coro_now_ns();
+}
+
+// Call after every successful receive: yields once the session has used up
+// its slice.
+static inline void coro_tick(void) {
+    coro_t* c = coro_current();
+    if (c && (++c->slice_recvs >= CORO_SLICE_RECVS || coro_now_ns() - c->sched->run_start >= CORO_SLICE_NS)) {
+        coro_yield();
+    }
+}
+
+// connect() that parks instead of blocking; makes fd non-blocking in a coroutine.
+static inline int coro_connect(int fd, const struct sockaddr* addr, socklen_t len) {
+    if (!coro_current()) {
+        return connect(fd, addr, len);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (connect(fd, addr, len) == 0) {
+        return 0;
+    }
+    if (!coro_wait_io(fd, EPOLLOUT)) {
+        return -1;
+    }
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) < 0) {
+        return -1;
+    }
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+static inline ssize_t coro_send(int fd, const void* buf, size_t len, int flags) {
+    ssize_t n;
+    while ((n = send(fd, buf, len, flags)) < 0 && coro_wait_io(fd, EPOLLOUT)) {
+    }
+    return n;
+}
+
+static inline ssize_t coro_recv(int fd, void* buf, size_t len, int flags) {
+    ssize_t n;
+    while ((n = recv(fd, buf, len, flags)) < 0 && coro_wait_io(fd, EPOLLIN)) {
+    }
+    return n;
+}
+
+static inline void* coro_sched_thread(void* arg) {
+    coro_sched_t* s = (coro_sched_t*)arg;
+    struct epoll_event events[CORO_MAX_EVENTS];
+    t_coro_sched = s;
+    long start = coro_now_ns();
+    while (s->live > 0) {
+        // One round over the sessions ready now; those that yield go to the
+        // back and wait for the parked ones that became ready meanwhile
+        for (int round = s->queued; round > 0; round--) {
+            coro_t* c = s->runq[s->head];
+            s->head = (s->head + 1) % s->count;
+            s->queued--;
+            coro_resume(s, c);
+        }
+        if (s->live == 0) {
+            break;
+        }
+        // Block only when every live session is parked
+        long wait_start = coro_now_ns();
+        int n = epoll_wait(s->epfd, events, CORO_MAX_EVENTS, s->queued > 0 ? 0 : -1);
+        if (s->queued == 0) {
+            s->idle_ns += coro_now_ns() - wait_start;
+        }
+        s->waits++;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Coro: epoll_wait failed");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            coro_ready(s, (coro_t*)events[i].data.ptr);
+        }
+    }
+    s->total_ns = coro_now_ns() - start;
+    t_coro_sched = NULL;
+    return NULL;
+}
+
+static inline int coro_start(coro_sched_t* scheds, int threads, const pthread_attr_t* attr) {
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&scheds[i].thread, attr, coro_sched_thread, &scheds[i]) != 0) {
+            perror("Coro: failed to start scheduler thread");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline void coro_join(coro_sched_t* scheds, int threads) {
+    for (int i = 0; i < threads; i++) {
+        pthread_join(scheds[i].thread, NULL);
+    }
+}
+
+static inline void coro_report(const coro_sched_t* scheds, int threads) {
+    int sessions = 0;
+    uint64_t resumes = 0, parks = 0, yields = 0, waits = 0;
+    long overhead_ns = 0, busy_ns = 0;
+    for (int i = 0; i < threads; i++) {
+        const coro_sched_t* s = &scheds[i];
+        sessions += s->count;
+        resumes += s->resumes;
+        parks += s->parks;
+        yields += s->yields;
+        waits += s->waits;
+        overhead_ns += s->total_ns - s->run_ns - s->idle_ns;
+        busy_ns += s->total_ns - s->idle_ns;
+    }
+    printf("Coroutines: %d sessions on %d scheduler threads, %zu KB stacks\n", sessions, threads,
+           scheds[0].stack_size / 1024);
+    printf("Scheduler Overhead: %.1f ns per resume (%llu resumes, %llu epoll waits, %.2f%% of busy time)\n",
+           resumes > 0 ? (double)overhead_ns / resumes : 0.0, (unsigned long long)resumes,
+           (unsigned long long)waits, busy_ns > 0 ? 100.0 * overhead_ns / busy_ns : 0.0);
+    printf("Scheduler Switches: %llu I/O parks, %llu slice yields (every %d receives or %d us)\n",
+           (unsigned long long)parks, (unsigned long long)yields, CORO_SLICE_RECVS, CORO_SLICE_NS / 1000);
+}
+
+static inline void coro_destroy(coro_sched_t* scheds, int threads) {
+    for (int i = 0; i < threads; i++) {
+        coro_sched_t* s = &scheds[i];
+        for (int j = 0; j < s->count; j++) {
+            if (s->coros[j]->stack) {
+                munmap(s->coros[j]->stack, s->coros[j]->stack_size);
+            }
+            free(s->coros[j]);
+        }
+        free(s->coros);
+        free(s->runq);
+        if (s->epfd >= 0) {
+            close(s->epfd);
+        }
+    }
+    free(scheds);
+}
+
+// Thousands of sessions need as many descriptors: raise the soft limit
+// toward the hard one when it is too low.
+static inline void coro_reserve_fds(int sessions) {
+    struct rlimit rl;
+    rlim_t need = (rlim_t)sessions + 64;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < need) {
+        rl.rlim_cur = rl.rlim_max < need ? rl.rlim_max : need;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+#endif // MT25043_CORO_H
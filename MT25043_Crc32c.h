@@ -0,0 +1,132 @@
+// MT25043
+//
+// File: MT25043_Crc32c.h
+//
+// Description: CRC32C (Castagnoli) checksums for end-to-end verification.
+// Servers append a 4-byte little-endian CRC32C of all fields after every
+// message; a verifying client checksums every received byte and compares.
+// Uses the SSE4.2 crc32 instruction when available, a table otherwise.
+// ============================================================================
+
+#ifndef MT25043_CRC32C_H
+#define MT25043_CRC32C_H
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "MT25043_Message.h"
+
+#define CRC32C_TRAILER_SIZE 4 // Bytes appended after each message
+
+static inline uint32_t crc32c_sw(uint32_t crc, const char* data, size_t len) {
+    static uint32_t table[256];
+    static int table_ready = 0;
+    if (!table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78U : c >> 1;
+            }
+            table[i] = c;
+        }
+        table_ready = 1;
+    }
+    while (len--) {
+        crc = table[(crc ^ (uint8_t)*data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static inline __attribute__((target("sse4.2")))
+uint32_t crc32c_hw(uint32_t crc, const char* data, size_t len) {
+    uint64_t c = crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        c = _mm_crc32_u64(c, word);
+        data += 8; len -= 8;
+    }
+    uint32_t c32 = (uint32_t)c;
+    while (len--) {
+        c32 = _mm_crc32_u8(c32, (uint8_t)*data++);
+    }
+    return c32;
+}
+
+// Continues a running CRC32C. Start with crc = 0xFFFFFFFF and finish with
+// crc32c_final(); crc32c() does both for a single buffer.
+static inline uint32_t crc32c_update(uint32_t crc, const char* data, size_t len) {
+    static int have_sse42 = -1;
+    if (have_sse42 < 0) {
+        __builtin_cpu_init();
+        have_sse42 = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+    }
+    return have_sse42 ? crc32c_hw(crc, data, len) : crc32c_sw(crc, data, len);
+}
+
+static inline uint32_t crc32c_final(uint32_t crc) {
+    return crc ^ 0xFFFFFFFFU;
+}
+
+static inline uint32_t crc32c_message(const message_t* msg) {
+    uint32_t crc = 0xFFFFFFFFU;
+    for (int i = 0; i < msg->schema->num_fields; i++) {
+        crc = crc32c_update(crc, msg->field[i], msg->schema->size[i]);
+    }
+    return crc32c_final(crc);
+}
+
+// Streaming verifier for a byte stream of [message][crc32c] frames. Bytes
+// may be fed in arbitrary chunks, as they come out of recv().
+typedef struct {
+    size_t msg_size;
+    size_t offset;           // Position inside the current frame
+    uint32_t crc;
+    char trailer[CRC32C_TRAILER_SIZE];
+    long verified;
+    long errors;
+} crc_verifier_t;
+
+static inline void crc_verifier_init(crc_verifier_t* v, size_t msg_size) {
+    memset(v, 0, sizeof(*v));
+    v->msg_size = msg_size;
+    v->crc = 0xFFFFFFFFU;
+}
+
+static inline void crc_verifier_feed(crc_verifier_t* v, const char* data, size_t len) {
+    while (len > 0) {
+        if (v->offset < v->msg_size) {
+            size_t n = v->msg_size - v->offset;
+            if (n > len) n = len;
+            v->crc = crc32c_update(v->crc, data, n);
+            v->offset += n; data += n; len -= n;
+            continue;
+        }
+
+        size_t pos = v->offset - v->msg_size;
+        size_t n = CRC32C_TRAILER_SIZE - pos;
+        if (n > len) n = len;
+        memcpy(v->trailer + pos, data, n);
+        v->offset += n; data += n; len -= n;
+
+        if (v->offset == v->msg_size + CRC32C_TRAILER_SIZE) {
+            uint32_t expected;
+            memcpy(&expected, v->trailer, sizeof(expected));
+            if (crc32c_final(v->crc) == expected) {
+                v->verified++;
+            } else {
+                v->errors++;
+            }
+            v->offset = 0;
+            v->crc = 0xFFFFFFFFU;
+        }
+    }
+}
+
+// Adapter for receiver_for_each_span() and similar span callbacks.
+static inline void crc_verifier_span(void* ctx, const char* data, size_t len) {
+    crc_verifier_feed((crc_verifier_t*)ctx, data, len);
+}
+
+#endif // MT25043_CRC32C_H
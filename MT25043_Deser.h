@@ -0,0 +1,253 @@
+// MT25043
+//
+// File: MT25043_Deser.h
+//
+// Description: Receive-side deserialization of framed messages (schema
+// "framed:SPEC", see MT25043_Message.h). The deserializer finds frames in
+// the received byte stream using only their headers, then hands each one
+// to the consumer as a message_t.
+//
+// Modes (--deserialize):
+// - view  : the message_t's field pointers point straight into the receive
+//           buffer; nothing is allocated or copied. Only a frame split
+//           across recv() calls is first gathered into a staging buffer.
+// - naive : every message allocates a message_t and one buffer per field
+//           and copies the field into it, like a typical decoder.
+//
+// Both modes run the same consumer, which reads the first and last byte of
+// every field, so the difference between them is the allocation and copy
+// cost of the receive side.
+//
+// Stamped frames (replayed traces) also record their latency from the
+// sender's timestamp to decode into the latency histogram.
+// ============================================================================
+
+#ifndef MT25043_DESER_H
+#define MT25043_DESER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "MT25043_Message.h"
+#include "MT25043_Hist.h"
+
+typedef enum {
+    DESER_NONE = 0,
+    DESER_VIEW,
+    DESER_NAIVE
+} deser_mode_t;
+
+static const char* const deser_mode_names[] = { "none", "view", "naive" };
+
+typedef struct {
+    deser_mode_t mode;
+    size_t trailer_size;    // Bytes after the data fields (CRC32C trailer)
+    size_t max_frame;
+    char* stage;            // Frame split across receives, gathered here
+    size_t staged;
+    size_t stage_need;      // Frame length once its header is staged, else 0
+    char header[FRAME_STAMPED_HEADER_SIZE(MAX_FIELDS)];
+    size_t header_size;     // Bytes of the last header decoded into wire
+    size_t layout_size;     // The part of it that describes the layout
+    schema_t wire;          // Data field layout announced by the header
+    message_t view;
+    uint64_t sink;          // Consumer result, keeps the reads alive
+    long messages;
+    long split;
+    long errors;
+    int broken;             // Lost frame sync: stop decoding
+    long now_ns;            // Decode time of the current span (0 = not read yet)
+    hist_t latency;         // Stamped frames: send time to decode
+} deser_t;
+
+static inline int parse_deser_mode(const char* name, deser_mode_t* mode) {
+    for (int i = 1; i < (int)(sizeof(deser_mode_names) / sizeof(deser_mode_names[0])); i++) {
+        if (strcasecmp(name, deser_mode_names[i]) == 0) {
+            *mode = (deser_mode_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline const char* deser_mode_name(deser_mode_t mode) {
+    return deser_mode_names[mode];
+}
+
+// max_frame bounds the frames the stream may announce (staging buffer size).
+static inline int deser_init(deser_t* d, deser_mode_t mode, size_t trailer_size, size_t max_frame) {
+    memset(d, 0, sizeof(*d));
+    d->mode = mode;
+    d->trailer_size = trailer_size;
+    d->max_frame = max_frame;
+    d->view.schema = &d->wire;
+    hist_init(&d->latency);
+    if (mode == DESER_NONE) {
+        return 0;
+    }
+    d->stage = (char*)malloc(max_frame);
+    if (!d->stage) {
+        perror("Failed to allocate deserializer staging buffer");
+        return -1;
+    }
+    return 0;
+}
+
+// Frame length announced by the header at p, or 0 if the header is invalid.
+// Only the fixed part of the header has to be present.
+static inline size_t deser_frame_length(const deser_t* d, const char* p) {
+    frame_header_t h;
+    memcpy(&h, p, sizeof(h)); // Frames start at any offset in the buffer
+    if ((h.magic != FRAME_MAGIC && h.magic != FRAME_MAGIC_STAMPED) || h.num_fields == 0 ||
+        h.num_fields >= MAX_FIELDS ||
+        h.header_size != (h.magic == FRAME_MAGIC ? FRAME_HEADER_SIZE(h.num_fields)
+                                                 : FRAME_STAMPED_HEADER_SIZE(h.num_fields))) {
+        return 0;
+    }
+    size_t len = (size_t)h.header_size + h.data_size + d->trailer_size;
+    return len <= d->max_frame ? len : 0;
+}
+
+// Rebuilds the wire layout when a header differs from the previous one.
+static inline int deser_load_header(deser_t* d, const char* p) {
+    frame_header_t h;
+    memcpy(&h, p, sizeof(h));
+    // The send time of a stamped frame changes every message: skip it
+    size_t layout_size = h.header_size - (h.magic == FRAME_MAGIC_STAMPED ? FRAME_STAMP_SIZE : 0);
+    if (h.header_size == d->header_size && memcmp(p, d->header, layout_size) == 0) {
+        return 0;
+    }
+    d->wire.num_fields = h.num_fields;
+    for (int i = 0; i < h.num_fields; i++) {
+        uint32_t start, end = h.data_size;
+        memcpy(&start, p + sizeof(h) + i * sizeof(uint32_t), sizeof(start));
+        if (i + 1 < h.num_fields) {
+            memcpy(&end, p + sizeof(h) + (i + 1) * sizeof(uint32_t), sizeof(end));
+        }
+        if (start > end || end > h.data_size) {
+            return -1;
+        }
+        d->wire.offset[i] = start;
+        d->wire.size[i] = end - start;
+    }
+    d->wire.total = h.data_size;
+    memcpy(d->header, p, layout_size);
+    d->header_size = h.header_size;
+    d->layout_size = layout_size;
+    return 0;
+}
+
+static inline uint64_t deser_consume(const message_t* msg) {
+    uint64_t sum = 0;
+    for (int i = 0; i < msg->schema->num_fields; i++) {
+        size_t size = msg->schema->size[i];
+        if (size > 0) {
+            sum += (unsigned char)msg->field[i][0] ^ (unsigned char)msg->field[i][size - 1];
+        }
+    }
+    return sum;
+}
+
+// Decodes one complete frame at p.
+static inline void deser_frame(deser_t* d, const char* p) {
+    if (deser_load_header(d, p) < 0) {
+        d->errors++;
+        d->broken = 1;
+        return;
+    }
+    if (d->layout_size < d->header_size) {
+        uint64_t sent_ns;
+        memcpy(&sent_ns, p + d->layout_size, sizeof(sent_ns));
+        if (d->now_ns == 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            d->now_ns = ts.tv_sec * 1000000000L + ts.tv_nsec;
+        }
+        if ((uint64_t)d->now_ns > sent_ns) {
+            hist_record(&d->latency, (uint64_t)d->now_ns - sent_ns);
+        }
+    }
+    const char* data = p + d->header_size;
+    if (d->mode == DESER_VIEW) {
+        for (int i = 0; i < d->wire.num_fields; i++) {
+            d->view.field[i] = (char*)data + d->wire.offset[i];
+        }
+        d->sink += deser_consume(&d->view);
+    } else {
+        message_t* msg = (message_t*)calloc(1, sizeof(message_t));
+        if (!msg) {
+            d->errors++;
+            return;
+        }
+        msg->schema = &d->wire;
+        for (int i = 0; i < d->wire.num_fields; i++) {
+            msg->field[i] = (char*)malloc(d->wire.size[i] > 0 ? d->wire.size[i] : 1);
+            if (!msg->field[i]) {
+                free_message(msg); // Frees the fields allocated so far
+                d->errors++;
+                return;
+            }
+            memcpy(msg->field[i], data + d->wire.offset[i], d->wire.size[i]);
+        }
+        d->sink += deser_consume(msg);
+        free_message(msg);
+    }
+    d->messages++;
+}
+
+// Feeds len received bytes in stream order (a recv_span_fn, see
+// MT25043_Recv.h). Whole frames are decoded in place; the rest is staged.
+static inline void deser_span(void* ctx, const char* data, size_t len) {
+    deser_t* d = (deser_t*)ctx;
+    d->now_ns = 0; // All frames completed by this span arrived together
+    while (len > 0 && !d->broken) {
+        if (d->staged == 0 && len >= sizeof(frame_header_t)) {
+            size_t frame = deser_frame_length(d, data);
+            if (frame == 0) {
+                d->errors++;
+                d->broken = 1;
+                return;
+            }
+            if (len >= frame) {
+                deser_frame(d, data);
+                data += frame;
+                len -= frame;
+                continue;
+            }
+        }
+        // Split frame: gather the header first, then the announced length
+        size_t need = d->stage_need > 0 ? d->stage_need : sizeof(frame_header_t);
+        size_t take = need - d->staged < len ? need - d->staged : len;
+        memcpy(d->stage + d->staged, data, take);
+        d->staged += take;
+        data += take;
+        len -= take;
+        if (d->staged < need) {
+            return;
+        }
+        if (d->stage_need == 0) {
+            d->stage_need = deser_frame_length(d, d->stage);
+            if (d->stage_need == 0) {
+                d->errors++;
+                d->broken = 1;
+                return;
+            }
+            continue;
+        }
+        deser_frame(d, d->stage);
+        d->split++;
+        d->staged = 0;
+        d->stage_need = 0;
+    }
+}
+
+static inline void deser_destroy(deser_t* d) {
+    free(d->stage);
+    d->stage = NULL;
+}
+
+#endif // MT25043_DESER_H
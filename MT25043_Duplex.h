@@ -0,0 +1,304 @@
+// MT25043
+//
+// File: MT25043_Duplex.h
+//
+// Description: Full-duplex streaming. A client that sends 'D' instead of
+// 'R' in the handshake asks for traffic in both directions: the server
+// keeps streaming to the client and additionally receives on a second
+// thread, while the client adds a sender thread next to its receive loop.
+//
+// - duplex_tx_t : client-to-server sender using one of the three copy
+//                 strategies (copy + send, sendmsg, MSG_ZEROCOPY)
+// - duplex_rx_t : server-side receive thread that drains (and with -c
+//                 verifies) the client's messages
+//
+// Both ends report throughput and average syscall latency per direction,
+// so TX/RX contention on the same cores and socket shows up as a drop in
+// one direction relative to a simplex run.
+// ============================================================================
+
+#ifndef MT25043_DUPLEX_H
+#define MT25043_DUPLEX_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/errqueue.h>
+#include <linux/tcp.h>
+
+#include "MT25043_Message.h"
+#include "MT25043_Copy.h"
+#include "MT25043_Crc32c.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#define DUPLEX_READY_SIGNAL 'D'
+#define DUPLEX_RX_BUFFER_SIZE 65536
+
+typedef enum {
+    TX_STRATEGY_COPY = 0,
+    TX_STRATEGY_SENDMSG,
+    TX_STRATEGY_ZEROCOPY
+} tx_strategy_t;
+
+static const char* const tx_strategy_names[] = { "copy", "sendmsg", "zerocopy" };
+
+static inline int parse_tx_strategy(const char* name, tx_strategy_t* strategy) {
+    for (int i = 0; i < (int)(sizeof(tx_strategy_names) / sizeof(tx_strategy_names[0])); i++) {
+        if (strcasecmp(name, tx_strategy_names[i]) == 0) {
+            *strategy = (tx_strategy_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline const char* tx_strategy_name(tx_strategy_t strategy) {
+    return tx_strategy_names[strategy];
+}
+
+static inline long duplex_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// --- Client-to-server sender ---
+
+typedef struct {
+    int sock;
+    tx_strategy_t strategy;
+    const schema_t* schema;
+    message_t* msg;
+    uint32_t crc;
+    int checksum;
+    size_t frame_size;
+    char* buffer;                   // Gathered frame for the copy strategy
+    struct iovec iov[MAX_FIELDS + 1];
+    struct msghdr hdr;
+    int duration;
+    pthread_t thread;
+    int running;
+    long bytes;
+    long sends;
+    long send_ns;
+} duplex_tx_t;
+
+static inline int duplex_tx_init(duplex_tx_t* tx, int sock, tx_strategy_t strategy,
+                                 const schema_t* schema, int checksum) {
+    memset(tx, 0, sizeof(*tx));
+    tx->sock = sock;
+    tx->strategy = strategy;
+    tx->schema = schema;
+    tx->checksum = checksum;
+    tx->frame_size = schema->total + (checksum ? CRC32C_TRAILER_SIZE : 0);
+    tx->msg = create_message(schema);
+    if (!tx->msg) {
+        return -1;
+    }
+    tx->crc = crc32c_message(tx->msg);
+
+    if (strategy == TX_STRATEGY_COPY) {
+        tx->buffer = (char*)malloc(tx->frame_size);
+        if (!tx->buffer) {
+            perror("Failed to allocate duplex send buffer");
+            free_message(tx->msg);
+            return -1;
+        }
+        return 0;
+    }
+    int n = schema->num_fields;
+    for (int i = 0; i < n; i++) {
+        tx->iov[i].iov_base = tx->msg->field[i];
+        tx->iov[i].iov_len = schema->size[i];
+    }
+    if (checksum) {
+        tx->iov[n].iov_base = &tx->crc;
+        tx->iov[n++].iov_len = CRC32C_TRAILER_SIZE;
+    }
+    tx->hdr.msg_iov = tx->iov;
+    tx->hdr.msg_iovlen = (size_t)n;
+
+    int one = 1;
+    if (strategy == TX_STRATEGY_ZEROCOPY &&
+        setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+        perror("setsockopt SO_ZEROCOPY (duplex TX falls back to copying)");
+    }
+    return 0;
+}
+
+// Sends one message with the configured strategy. Returns bytes or <= 0.
+static inline ssize_t duplex_tx_send(duplex_tx_t* tx) {
+    long start = duplex_now_ns();
+    ssize_t sent;
+    if (tx->strategy == TX_STRATEGY_COPY) {
+        // Serialize on every send, like the two-copy server with -g per-send
+        gather_message(tx->buffer, tx->msg, COPY_KERNEL_MEMCPY);
+        memcpy(tx->buffer + tx->schema->total, &tx->crc, tx->frame_size - tx->schema->total);
+        sent = send(tx->sock, tx->buffer, tx->frame_size, MSG_NOSIGNAL);
+    } else if (tx->strategy == TX_STRATEGY_SENDMSG) {
+        sent = sendmsg(tx->sock, &tx->hdr, MSG_NOSIGNAL);
+    } else {
+        sent = sendmsg(tx->sock, &tx->hdr, MSG_ZEROCOPY | MSG_NOSIGNAL);
+        if (sent < 0 && errno == EOPNOTSUPP) {
+            // Software kTLS rejects MSG_ZEROCOPY: stay on plain sendmsg()
+            tx->strategy = TX_STRATEGY_SENDMSG;
+            sent = sendmsg(tx->sock, &tx->hdr, MSG_NOSIGNAL);
+        }
+        // Drain completions so the error queue does not hit optmem_max
+        char cmsg_buf[CMSG_SPACE(sizeof(struct sock_extended_err))];
+        struct msghdr err_hdr;
+        memset(&err_hdr, 0, sizeof(err_hdr));
+        err_hdr.msg_control = cmsg_buf;
+        err_hdr.msg_controllen = sizeof(cmsg_buf);
+        while (recvmsg(tx->sock, &err_hdr, MSG_ERRQUEUE | MSG_DONTWAIT) >= 0) {
+            err_hdr.msg_controllen = sizeof(cmsg_buf);
+        }
+    }
+    if (sent > 0) {
+        tx->send_ns += duplex_now_ns() - start;
+        tx->bytes += sent;
+        tx->sends++;
+    }
+    return sent;
+}
+
+static inline void* duplex_tx_thread(void* arg) {
+    duplex_tx_t* tx = (duplex_tx_t*)arg;
+    long deadline = duplex_now_ns() + tx->duration * 1000000000L;
+    while (duplex_now_ns() < deadline) {
+        ssize_t sent = duplex_tx_send(tx);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            // EPIPE/ECONNRESET: the server finished its run and closed first
+            if (sent < 0 && errno != EPIPE && errno != ECONNRESET) {
+                perror("Duplex send failed");
+            }
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Sends on a thread of its own for duration seconds.
+static inline int duplex_tx_start(duplex_tx_t* tx, int duration) {
+    tx->duration = duration;
+    if (pthread_create(&tx->thread, NULL, duplex_tx_thread, tx) != 0) {
+        perror("Failed to start duplex send thread");
+        return -1;
+    }
+    tx->running = 1;
+    return 0;
+}
+
+static inline void duplex_tx_join(duplex_tx_t* tx) {
+    if (tx->running) {
+        pthread_join(tx->thread, NULL);
+        tx->running = 0;
+    }
+}
+
+static inline void duplex_tx_destroy(duplex_tx_t* tx) {
+    free(tx->buffer);
+    free_message(tx->msg);
+    tx->buffer = NULL;
+    tx->msg = NULL;
+}
+
+// --- Server-side receive thread ---
+
+typedef struct {
+    int sock;
+    int verify;
+    pthread_t thread;
+    int running;
+    crc_verifier_t verifier;
+    long bytes;
+    long recvs;
+    long recv_ns;
+    long start_ns;
+    long end_ns;
+} duplex_rx_t;
+
+static inline void* duplex_rx_thread(void* arg) {
+    duplex_rx_t* rx = (duplex_rx_t*)arg;
+    char* buffer = (char*)malloc(DUPLEX_RX_BUFFER_SIZE);
+    if (!buffer) {
+        perror("Failed to allocate duplex receive buffer");
+        return NULL;
+    }
+    rx->start_ns = duplex_now_ns();
+    while (1) {
+        long start = duplex_now_ns();
+        ssize_t n = recv(rx->sock, buffer, DUPLEX_RX_BUFFER_SIZE, 0);
+        if (n <= 0) {
+            break; // Client closed, or duplex_rx_stop() shut the read side
+        }
+        rx->recv_ns += duplex_now_ns() - start;
+        rx->bytes += n;
+        rx->recvs++;
+        if (rx->verify) {
+            crc_verifier_feed(&rx->verifier, buffer, (size_t)n);
+        }
+    }
+    rx->end_ns = duplex_now_ns();
+    free(buffer);
+    return NULL;
+}
+
+// Starts receiving on sock; with verify, every frame's CRC32C is checked.
+static inline int duplex_rx_start(duplex_rx_t* rx, int sock, size_t msg_size, int verify) {
+    memset(rx, 0, sizeof(*rx));
+    rx->sock = sock;
+    rx->verify = verify;
+    crc_verifier_init(&rx->verifier, msg_size);
+    if (pthread_create(&rx->thread, NULL, duplex_rx_thread, rx) != 0) {
+        perror("Failed to start duplex receive thread");
+        return -1;
+    }
+    rx->running = 1;
+    return 0;
+}
+
+// Stops the receive thread (after the send loop is done) and reports.
+static inline void duplex_rx_stop(duplex_rx_t* rx, int client_socket) {
+    if (!rx->running) {
+        return;
+    }
+    shutdown(rx->sock, SHUT_RD);
+    pthread_join(rx->thread, NULL);
+    rx->running = 0;
+
+    // The send loop does not count bytes, so TX comes from the kernel
+    double elapsed = (rx->end_ns - rx->start_ns) / 1e9;
+    struct tcp_info info;
+    memset(&info, 0, sizeof(info));
+    socklen_t len = sizeof(info);
+    if (getsockopt(rx->sock, IPPROTO_TCP, TCP_INFO, &info, &len) == 0 && elapsed > 0) {
+        printf("Server: Socket %d duplex TX: %llu bytes acked, %.3f Gbps\n", client_socket,
+               (unsigned long long)info.tcpi_bytes_acked, info.tcpi_bytes_acked * 8.0 / elapsed / 1e9);
+    }
+    printf("Server: Socket %d duplex RX: %ld bytes, %.3f Gbps, avg recv %.3f us, %.1f bytes per recv\n",
+           client_socket, rx->bytes, elapsed > 0 ? rx->bytes * 8.0 / elapsed / 1e9 : 0.0,
+           rx->recvs > 0 ? rx->recv_ns / 1000.0 / rx->recvs : 0.0,
+           rx->recvs > 0 ? (double)rx->bytes / rx->recvs : 0.0);
+    if (rx->verify) {
+        printf("Server: Socket %d duplex RX checksum: %ld messages verified, %ld errors\n",
+               client_socket, rx->verifier.verified, rx->verifier.errors);
+    }
+}
+
+#endif // MT25043_DUPLEX_H
@@ -0,0 +1,144 @@
+// MT25043
+//
+// File: MT25043_Hist.h
+//
+// Description: Fixed-size log-linear latency histogram. Values (in ns) are
+// bucketed by their highest set bit and the next HIST_SUB_BITS bits, which
+// keeps the relative error of any percentile under 1/16 (6.25%) over the
+// full 64-bit range with 4 KB of counters and no allocation. Each thread
+// records into its own histogram; histograms are merged after join.
+//
+// arrival_t tracks when whole messages complete on the receiver: the gaps
+// between completions and their jitter, the mean absolute difference of
+// consecutive gaps (the interarrival jitter of RFC 3550 without smoothing).
+// A paced sender shows up as regular gaps and low jitter; a bursty one as
+// runs of zero gaps followed by long stalls.
+// ============================================================================
+
+#ifndef MT25043_HIST_H
+#define MT25043_HIST_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint32_t buckets[HIST_BUCKETS];
+} hist_t;
+
+static inline void hist_init(hist_t* h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+static inline int hist_bucket(uint64_t v) {
+    if (v < HIST_SUB_BUCKETS) {
+        return (int)v; // Exact for small values
+    }
+    int msb = 63 - __builtin_clzll(v);
+    int sub = (int)((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1));
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS + sub;
+}
+
+// Smallest value that falls into bucket b.
+static inline uint64_t hist_bucket_low(int b) {
+    if (b < HIST_SUB_BUCKETS) {
+        return (uint64_t)b;
+    }
+    int msb = b / HIST_SUB_BUCKETS + HIST_SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(b % HIST_SUB_BUCKETS);
+    return (1ULL << msb) | (sub << (msb - HIST_SUB_BITS));
+}
+
+static inline void hist_record(hist_t* h, uint64_t v) {
+    h->buckets[hist_bucket(v)]++;
+    h->count++;
+    h->sum += v;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+static inline void hist_merge(hist_t* dst, const hist_t* src) {
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        dst->buckets[b] += src->buckets[b];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+// Value at quantile q (0..1): the middle of the bucket that holds it.
+static inline uint64_t hist_percentile(const hist_t* h, double q) {
+    if (h->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (h->count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            uint64_t low = hist_bucket_low(b);
+            uint64_t high = b + 1 < HIST_BUCKETS ? hist_bucket_low(b + 1) : h->max;
+            uint64_t mid = low + (high - low) / 2;
+            return mid < h->min ? h->min : (mid > h->max ? h->max : mid);
+        }
+    }
+    return h->max;
+}
+
+static inline double hist_mean(const hist_t* h) {
+    return h->count > 0 ? (double)h->sum / h->count : 0.0;
+}
+
+typedef struct {
+    hist_t gaps;
+    long last_ns;           // Completion time of the previous message
+    long prev_gap;          // -1 until two messages have completed
+    uint64_t jitter_sum;
+    uint64_t jitter_samples;
+} arrival_t;
+
+static inline void arrival_init(arrival_t* a) {
+    hist_init(&a->gaps);
+    a->last_ns = 0;
+    a->prev_gap = -1;
+    a->jitter_sum = 0;
+    a->jitter_samples = 0;
+}
+
+// Records that completed messages finished by now_ns (several messages
+// completing in one recv arrived together: gap 0).
+static inline void arrival_record(arrival_t* a, long now_ns, size_t completed) {
+    for (size_t i = 0; i < completed; i++) {
+        if (a->last_ns != 0) {
+            long gap = now_ns - a->last_ns;
+            hist_record(&a->gaps, (uint64_t)gap);
+            if (a->prev_gap >= 0) {
+                a->jitter_sum += (uint64_t)(gap > a->prev_gap ? gap - a->prev_gap : a->prev_gap - gap);
+                a->jitter_samples++;
+            }
+            a->prev_gap = gap;
+        }
+        a->last_ns = now_ns;
+    }
+}
+
+static inline void arrival_merge(arrival_t* dst, const arrival_t* src) {
+    hist_merge(&dst->gaps, &src->gaps);
+    dst->jitter_sum += src->jitter_sum;
+    dst->jitter_samples += src->jitter_samples;
+}
+
+static inline double arrival_jitter(const arrival_t* a) {
+    return a->jitter_samples > 0 ? (double)a->jitter_sum / a->jitter_samples : 0.0;
+}
+
+#endif // MT25043_HIST_H
@@ -0,0 +1,273 @@
+// MT25043
+//
+// File: MT25043_Memory.h
+//
+// Description: Per-connection memory accounting. At high connection counts
+// memory, not bandwidth, limits a server: every connection has a thread
+// stack, its messages and buffers on the heap, and kernel socket memory,
+// plus the user pages a zero-copy send keeps pinned. mem_start() records a
+// baseline; a side thread then samples every MEM_SAMPLE_MS:
+//   - user: resident set size above the baseline (heap, buffers and the
+//     touched part of every stack), and the heap in use (mallinfo2)
+//   - kernel: SO_MEMINFO of every registered socket, i.e. receive queue,
+//     queued send data, forward-allocated quota and option memory
+//   - pinned: VmPin, the pages MSG_ZEROCOPY holds until completion
+// and keeps the sample with the most connections (the largest total on a
+// tie). Dividing by its connection count gives the cost of one connection
+// and the connections that fit in a GB.
+//
+// Connection threads call mem_register() next to tcpinfo_register() and
+// mem_unregister() before close(); the hot path is untouched. Servers
+// report when the last connection closes, clients after the join. Past
+// MEM_MAX_SOCKETS connections still count, but their kernel memory is not
+// sampled (a warning says so).
+//
+// Lean mode (--lean) starts connection threads with MEM_LEAN_STACK instead
+// of the default stack (RLIMIT_STACK, usually 8 MB of address space each).
+// ============================================================================
+
+#ifndef MT25043_MEMORY_H
+#define MT25043_MEMORY_H
+
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/sock_diag.h>
+
+#ifndef SO_MEMINFO
+#define SO_MEMINFO 55
+#endif
+
+#define MEM_MAX_SOCKETS 16384
+#define MEM_SAMPLE_MS 100
+#define MEM_LEAN_STACK (256 * 1024)     // Deepest connection thread frame is ~40 KB
+
+typedef struct {
+    int connections;
+    long rss;               // Bytes above the baseline
+    long heap;
+    long kernel;            // Sum of SO_MEMINFO over the registered sockets
+    long pinned;            // VmPin above the baseline
+} mem_sample_t;
+
+typedef struct {
+    char prefix[16];        // "Server " for servers, "" for clients
+    int auto_report;        // Report when the last connection closes
+    size_t stack_size;      // Reserved per connection thread
+    long base_rss;
+    long base_heap;
+    long base_pinned;
+    long sock_kernel[MEM_MAX_SOCKETS];
+    int socks[MEM_MAX_SOCKETS];
+    int active;
+    int unslotted;          // Connections past MEM_MAX_SOCKETS: counted, kernel memory not sampled
+    mem_sample_t peak;
+    pthread_mutex_t lock;   // Guards everything above; never taken on the hot path
+} mem_account_t;
+
+static mem_account_t* g_mem = NULL;
+
+static inline long mem_rss(void) {
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static inline long mem_heap(void) {
+    struct mallinfo2 mi = mallinfo2();
+    return (long)(mi.uordblks + mi.hblkhd); // Arena chunks plus mmap()ed blocks
+}
+
+static inline long mem_pinned(void) {
+    char line[128];
+    long kb = 0;
+    FILE* f = fopen("/proc/self/status", "r");
+    if (!f) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmPin: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+    return kb * 1024;
+}
+
+// Kernel memory charged to sock: queues, forward allocation and options
+static inline long mem_socket(int sock) {
+    uint32_t info[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(info);
+    memset(info, 0, sizeof(info));
+    if (getsockopt(sock, SOL_SOCKET, SO_MEMINFO, info, &len) < 0) {
+        return 0;
+    }
+    return (long)info[SK_MEMINFO_RMEM_ALLOC] + info[SK_MEMINFO_WMEM_QUEUED] + info[SK_MEMINFO_FWD_ALLOC] +
+           info[SK_MEMINFO_OPTMEM] + info[SK_MEMINFO_BACKLOG];
+}
+
+static inline long mem_sample_total(const mem_sample_t* s) {
+    return s->rss + s->kernel + s->pinned;
+}
+
+// Caller holds the lock.
+static inline void mem_sample(mem_account_t* m) {
+    if (m->active == 0) {
+        return;
+    }
+    mem_sample_t s;
+    s.connections = m->active;
+    s.kernel = 0;
+    for (int i = 0; i < MEM_MAX_SOCKETS; i++) {
+        if (m->socks[i] >= 0) {
+            m->sock_kernel[i] = mem_socket(m->socks[i]);
+            s.kernel += m->sock_kernel[i];
+        }
+    }
+    s.rss = mem_rss() - m->base_rss;
+    s.heap = mem_heap() - m->base_heap;
+    s.pinned = mem_pinned() - m->base_pinned;
+    if (s.connections > m->peak.connections ||
+        (s.connections == m->peak.connections && mem_sample_total(&s) > mem_sample_total(&m->peak))) {
+        m->peak = s;
+    }
+}
+
+static inline void mem_report(void) {
+    mem_account_t* m = g_mem;
+    if (!m) {
+        return;
+    }
+    pthread_mutex_lock(&m->lock);
+    mem_sample_t p = m->peak;
+    memset(&m->peak, 0, sizeof(m->peak)); // The next burst of connections starts over
+    pthread_mutex_unlock(&m->lock);
+    if (p.connections == 0) {
+        return;
+    }
+    double n = p.connections;
+    double per_conn = mem_sample_total(&p) / n;
+    printf("%sMemory per Connection: %.1f KB (user %.1f KB RSS, heap %.1f KB, kernel %.1f KB, pinned %.1f KB; "
+           "%d connections, stack %zu KB reserved each)\n", m->prefix, per_conn / 1024.0, p.rss / n / 1024.0,
+           p.heap / n / 1024.0, p.kernel / n / 1024.0, p.pinned / n / 1024.0, p.connections, m->stack_size / 1024);
+    printf("%sConnection Density: %.1f per GB\n", m->prefix, per_conn > 0 ? (1024.0 * 1024 * 1024) / per_conn : 0.0);
+}
+
+static inline void* mem_thread(void* arg) {
+    mem_account_t* m = (mem_account_t*)arg;
+    struct timespec interval = { MEM_SAMPLE_MS / 1000, (long)(MEM_SAMPLE_MS % 1000) * 1000000L };
+    while (1) {
+        nanosleep(&interval, NULL);
+        pthread_mutex_lock(&m->lock);
+        mem_sample(m);
+        pthread_mutex_unlock(&m->lock);
+    }
+    return NULL;
+}
+
+// Records the baseline and starts sampling. Call once the process is set up
+// (pools built, listener open) and before the first connection.
+static inline int mem_start(const char* prefix, int auto_report, size_t stack_size) {
+    mem_account_t* m = (mem_account_t*)calloc(1, sizeof(mem_account_t));
+    if (!m) {
+        perror("Memory: failed to allocate accounting");
+        return -1;
+    }
+    snprintf(m->prefix, sizeof(m->prefix), "%s", prefix);
+    m->auto_report = auto_report;
+    m->stack_size = stack_size;
+    for (int i = 0; i < MEM_MAX_SOCKETS; i++) {
+        m->socks[i] = -1;
+    }
+    pthread_mutex_init(&m->lock, NULL);
+    m->base_rss = mem_rss();
+    m->base_heap = mem_heap();
+    m->base_pinned = mem_pinned();
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, mem_thread, m) != 0) {
+        perror("Memory: failed to start sampler");
+        free(m);
+        return -1;
+    }
+    pthread_detach(thread);
+    g_mem = m;
+    return 0;
+}
+
+static inline void mem_register(int sock) {
+    mem_account_t* m = g_mem;
+    if (!m) {
+        return;
+    }
+    pthread_mutex_lock(&m->lock);
+    int slot = -1;
+    for (int i = 0; i < MEM_MAX_SOCKETS; i++) {
+        if (m->socks[i] < 0) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot >= 0) {
+        m->socks[slot] = sock;
+    } else if (m->unslotted++ == 0) {
+        fprintf(stderr, "Memory: more than %d connections, kernel memory of the rest is not sampled\n",
+                MEM_MAX_SOCKETS);
+    }
+    m->active++;
+    pthread_mutex_unlock(&m->lock);
+}
+
+// The first connection to close takes a last sample with every socket still
+// open (queues may have grown since the previous one). Call before close(sock).
+static inline void mem_unregister(int sock) {
+    mem_account_t* m = g_mem;
+    if (!m) {
+        return;
+    }
+    pthread_mutex_lock(&m->lock);
+    if (m->active >= m->peak.connections) {
+        mem_sample(m); // Only the first close after the peak can raise it
+    }
+    int last = 0;
+    int found = 0;
+    for (int i = 0; i < MEM_MAX_SOCKETS; i++) {
+        if (m->socks[i] == sock) {
+            m->socks[i] = -1;
+            found = 1;
+            break;
+        }
+    }
+    if (found || m->unslotted > 0) {
+        m->unslotted -= !found;
+        last = --m->active == 0;
+    }
+    pthread_mutex_unlock(&m->lock);
+    if (last && m->auto_report) {
+        mem_report();
+    }
+}
+
+// Thread attributes for connection threads: MEM_LEAN_STACK in lean mode,
+// the default otherwise. Returns the stack size the threads will reserve.
+static inline size_t mem_thread_attr(pthread_attr_t* attr, int lean) {
+    pthread_attr_init(attr);
+    if (lean) {
+        pthread_attr_setstacksize(attr, MEM_LEAN_STACK);
+    }
+    size_t stack_size = 0;
+    pthread_attr_getstacksize(attr, &stack_size);
+    return stack_size;
+}
+
+#endif // MT25043_MEMORY_H
@@ -0,0 +1,295 @@
+// MT25043
+//
+// File: MT25043_Message.h
+//
+// Description: The structured message shared by all servers and clients.
+// A message is a set of dynamically allocated fields whose count and sizes
+// come from a runtime schema; senders build it with create_message() and
+// receivers can rebuild the same layout to read straight into its fields.
+//
+// Schema specs (-f / --schema):
+// - uniform:N   N equal fields (default uniform:8, the original layout)
+// - skewed:N    N fields: a few large blobs and many tiny 8-64 byte headers
+// - file:PATH   explicit layout, one field size per line; a single '*'
+//               line takes whatever is left of the message size
+// - framed:SPEC any of the above behind a frame header (field 0) that
+//               carries the field count and an offset table, so receivers
+//               can find the fields without knowing the schema
+// ============================================================================
+
+#ifndef MT25043_MESSAGE_H
+#define MT25043_MESSAGE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_FIELDS 8      // Default field count (uniform:8)
+#define MAX_FIELDS 64     // Upper bound for any schema
+
+// Field layout of every message on a connection.
+typedef struct {
+    int num_fields;
+    size_t size[MAX_FIELDS];
+    size_t offset[MAX_FIELDS];  // Position of each field in the byte stream
+    size_t total;
+    int framed;                 // 1 if field 0 is a frame_header_t
+} schema_t;
+
+// Wire header of a framed message, sent as field 0 ahead of the data fields
+// it describes. Host byte order: both ends run on the same architecture.
+#define FRAME_MAGIC 0x3146544DU // "MTF1"
+
+typedef struct {
+    uint32_t magic;
+    uint16_t num_fields;        // Data fields after the header
+    uint16_t header_size;       // Bytes of this header, offset table included
+    uint32_t data_size;         // Bytes of all data fields
+    uint32_t offset[];          // Start of each data field, after the header
+} frame_header_t;
+
+#define FRAME_HEADER_SIZE(n) ((sizeof(frame_header_t) + (size_t)(n) * sizeof(uint32_t) + 7) & ~(size_t)7)
+
+// Stamped frames (trace replay, see MT25043_Replay.h) end their header with
+// the CLOCK_MONOTONIC send time in ns, so receivers on the same host can
+// measure per-message latency. Everything else is as above.
+#define FRAME_MAGIC_STAMPED 0x3246544DU // "MTF2"
+#define FRAME_STAMP_SIZE sizeof(uint64_t)
+#define FRAME_STAMPED_HEADER_SIZE(n) (FRAME_HEADER_SIZE(n) + FRAME_STAMP_SIZE)
+
+// The message structure with dynamically allocated string fields.
+typedef struct {
+    const schema_t* schema;
+    char* field[MAX_FIELDS];
+} message_t;
+
+static inline void schema_finish(schema_t* schema) {
+    size_t offset = 0;
+    for (int i = 0; i < schema->num_fields; i++) {
+        schema->offset[i] = offset;
+        offset += schema->size[i];
+    }
+    schema->total = offset;
+}
+
+static inline int schema_uniform(schema_t* schema, int num_fields, size_t msg_size) {
+    if (num_fields < 1 || num_fields > MAX_FIELDS || msg_size < (size_t)num_fields) {
+        fprintf(stderr, "Schema: cannot split %zu bytes into %d fields (1-%d fields, 1 byte each at least)\n",
+                msg_size, num_fields, MAX_FIELDS);
+        return -1;
+    }
+    schema->num_fields = num_fields;
+    for (int i = 0; i < num_fields; i++) {
+        // Spread the remainder over the first fields
+        schema->size[i] = msg_size / num_fields + ((size_t)i < msg_size % num_fields ? 1 : 0);
+    }
+    schema_finish(schema);
+    return 0;
+}
+
+// Roughly one field in eight is a blob; the rest are 8-64 byte headers.
+// Headers never take more than half the message, blobs share the rest.
+static inline int schema_skewed(schema_t* schema, int num_fields, size_t msg_size) {
+    if (schema_uniform(schema, num_fields, msg_size) < 0) {
+        return -1;
+    }
+    int blobs = num_fields / 8 > 0 ? num_fields / 8 : 1;
+    int headers = num_fields - blobs;
+    if (headers == 0) {
+        return 0;
+    }
+    int stride = num_fields / blobs;
+
+    size_t header_bytes = 0;
+    for (int i = 0; i < headers; i++) {
+        header_bytes += (size_t)8 << (i % 4);
+    }
+    size_t scale_limit = msg_size / 2;
+    int h = 0;
+    size_t used = 0;
+    for (int i = 0; i < num_fields; i++) {
+        if (i % stride == stride - 1 && blobs > 0 && (i / stride) < blobs) {
+            schema->size[i] = 0; // Blob, sized below
+            continue;
+        }
+        size_t size = (size_t)8 << (h++ % 4);
+        if (header_bytes > scale_limit) {
+            size = size * scale_limit / header_bytes;
+        }
+        schema->size[i] = size > 0 ? size : 1;
+        used += schema->size[i];
+    }
+
+    size_t remaining = msg_size - used;
+    int b = 0;
+    for (int i = 0; i < num_fields; i++) {
+        if (schema->size[i] == 0) {
+            schema->size[i] = remaining / blobs + ((size_t)b < remaining % blobs ? 1 : 0);
+            b++;
+        }
+    }
+    schema_finish(schema);
+    return 0;
+}
+
+static inline int schema_from_file(schema_t* schema, const char* path, size_t msg_size) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        perror("Schema: cannot open layout file");
+        return -1;
+    }
+    char line[128];
+    int wildcard = -1;
+    size_t used = 0;
+    schema->num_fields = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+        if (schema->num_fields == MAX_FIELDS) {
+            fprintf(stderr, "Schema: %s has more than %d fields\n", path, MAX_FIELDS);
+            fclose(fp);
+            return -1;
+        }
+        if (*p == '*') {
+            wildcard = schema->num_fields;
+            schema->size[schema->num_fields++] = 0;
+            continue;
+        }
+        long size = atol(p);
+        if (size <= 0) {
+            fprintf(stderr, "Schema: invalid field size '%s' in %s\n", p, path);
+            fclose(fp);
+            return -1;
+        }
+        schema->size[schema->num_fields++] = (size_t)size;
+        used += (size_t)size;
+    }
+    fclose(fp);
+
+    if (wildcard >= 0) {
+        if (used >= msg_size) {
+            fprintf(stderr, "Schema: fixed fields of %s already use %zu of %zu bytes\n", path, used, msg_size);
+            return -1;
+        }
+        schema->size[wildcard] = msg_size - used;
+    } else if (used != msg_size) {
+        fprintf(stderr, "Schema: %s describes %zu bytes but the message size is %zu\n", path, used, msg_size);
+        return -1;
+    }
+    if (schema->num_fields == 0) {
+        fprintf(stderr, "Schema: %s has no fields\n", path);
+        return -1;
+    }
+    schema_finish(schema);
+    return 0;
+}
+
+// Puts a frame header field in front of the data fields.
+static inline int schema_frame(schema_t* schema) {
+    if (schema->num_fields + 1 > MAX_FIELDS) {
+        fprintf(stderr, "Schema: no room for the frame header (%d fields at most)\n", MAX_FIELDS - 1);
+        return -1;
+    }
+    for (int i = schema->num_fields; i > 0; i--) {
+        schema->size[i] = schema->size[i - 1];
+    }
+    schema->size[0] = FRAME_HEADER_SIZE(schema->num_fields);
+    schema->num_fields++;
+    schema->framed = 1;
+    schema_finish(schema);
+    return 0;
+}
+
+// Builds a schema for msg_size bytes from a spec string (see top of file).
+// A framed schema sends its header on top of the msg_size data bytes.
+static inline int schema_parse(schema_t* schema, const char* spec, size_t msg_size) {
+    memset(schema, 0, sizeof(*schema));
+    if (strncmp(spec, "framed:", 7) == 0) {
+        if (strncmp(spec + 7, "framed:", 7) == 0 || schema_parse(schema, spec + 7, msg_size) < 0) {
+            return -1;
+        }
+        return schema_frame(schema);
+    }
+    if (strncmp(spec, "uniform:", 8) == 0) {
+        return schema_uniform(schema, atoi(spec + 8), msg_size);
+    }
+    if (strncmp(spec, "skewed:", 7) == 0) {
+        return schema_skewed(schema, atoi(spec + 7), msg_size);
+    }
+    if (strncmp(spec, "file:", 5) == 0) {
+        return schema_from_file(schema, spec + 5, msg_size);
+    }
+    fprintf(stderr, "Unknown schema '%s' (expected uniform:N, skewed:N or file:PATH, optionally framed:)\n", spec);
+    return -1;
+}
+
+// Index of the field that holds stream offset pos (pos < schema->total).
+static inline int schema_field_at(const schema_t* schema, size_t pos) {
+    int i = schema->num_fields - 1;
+    while (i > 0 && schema->offset[i] > pos) i--;
+    return i;
+}
+
+static inline void schema_print(const schema_t* schema, const char* prefix) {
+    int first = schema->framed;
+    size_t smallest = schema->size[first], largest = schema->size[first];
+    for (int i = first + 1; i < schema->num_fields; i++) {
+        if (schema->size[i] < smallest) smallest = schema->size[i];
+        if (schema->size[i] > largest) largest = schema->size[i];
+    }
+    printf("%s: %d fields, %zu bytes (smallest %zu, largest %zu)", prefix, schema->num_fields - first,
+           schema->total - (first ? schema->size[0] : 0), smallest, largest);
+    if (schema->framed) {
+        printf(" behind a %zu-byte frame header", schema->size[0]);
+    }
+    printf("\n");
+}
+
+// Writes the frame header of a framed schema into dst (schema->size[0] bytes).
+static inline void frame_header_write(char* dst, const schema_t* schema) {
+    frame_header_t* header = (frame_header_t*)dst;
+    memset(dst, 0, schema->size[0]);
+    header->magic = FRAME_MAGIC;
+    header->num_fields = (uint16_t)(schema->num_fields - 1);
+    header->header_size = (uint16_t)schema->size[0];
+    header->data_size = (uint32_t)(schema->total - schema->size[0]);
+    for (int i = 1; i < schema->num_fields; i++) {
+        header->offset[i - 1] = (uint32_t)(schema->offset[i] - schema->size[0]);
+    }
+}
+
+static inline message_t* create_message(const schema_t* schema) {
+    message_t* msg = (message_t*)calloc(1, sizeof(message_t));
+    if (!msg) {
+        perror("Failed to allocate message struct");
+        return NULL;
+    }
+    msg->schema = schema;
+    for (int i = 0; i < schema->num_fields; i++) {
+        msg->field[i] = (char*)malloc(schema->size[i]);
+        if (!msg->field[i]) {
+            perror("Failed to allocate message field");
+            for (int j = 0; j < i; j++) free(msg->field[j]);
+            free(msg);
+            return NULL;
+        }
+        memset(msg->field[i], 'A' + i % 26, schema->size[i]);
+    }
+    if (schema->framed) {
+        frame_header_write(msg->field[0], schema);
+    }
+    return msg;
+}
+
+static inline void free_message(message_t* msg) {
+    if (msg) {
+        for (int i = 0; i < msg->schema->num_fields; i++) {
+            if (msg->field[i]) free(msg->field[i]);
+        }
+        free(msg);
+    }
+}
+
+#endif // MT25043_MESSAGE_H
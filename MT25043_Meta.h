@@ -0,0 +1,190 @@
+// MT25043
+//
+// File: MT25043_Meta.h
+//
+// Description: Run metadata. Every server and client prints one
+// "Run Metadata: {...}" line at startup: a flat JSON object with the git
+// revision the binary was built from, kernel, CPU model and count,
+// frequency governor, SMT state, transparent huge pages, and the socket
+// memory sysctls (optmem_max, rmem/wmem_max, tcp_rmem/tcp_wmem) as seen
+// from the binary's network namespace. The experiment script stores the
+// client's line with each results row, keyed by its RunId.
+//
+// meta_report() also warns on stderr about settings known to distort
+// results: a powersave governor, and an optmem_max too small for the
+// MSG_ZEROCOPY completion notifications (sends then fail with ENOBUFS or
+// quietly fall back to copying, depending on the kernel).
+// ============================================================================
+
+#ifndef MT25043_META_H
+#define MT25043_META_H
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+// Set by the Makefile from `git describe`; manual builds report "unknown"
+#ifndef MT25043_GIT_REV
+#define MT25043_GIT_REV "unknown"
+#endif
+
+#define META_OPTMEM_MIN 131072      // Default since Linux 6.9; older 20 KB is too small for MSG_ZEROCOPY
+#define META_FIELD_LEN 128
+
+typedef struct {
+    char kernel[META_FIELD_LEN];
+    char arch[META_FIELD_LEN];
+    char cpu_model[META_FIELD_LEN];
+    char governor[META_FIELD_LEN];
+    char smt[META_FIELD_LEN];
+    char thp[META_FIELD_LEN];
+    char tcp_rmem[META_FIELD_LEN];
+    char tcp_wmem[META_FIELD_LEN];
+    char congestion[META_FIELD_LEN];
+    long cpus;
+    long optmem_max;
+    long rmem_max;
+    long wmem_max;
+} run_meta_t;
+
+// Reads the first line of a sysfs/procfs file; "n/a" when it is missing
+static inline void meta_read_line(const char* path, char* out, size_t len) {
+    FILE* f = fopen(path, "r");
+    snprintf(out, len, "n/a");
+    if (!f) {
+        return;
+    }
+    if (fgets(out, (int)len, f)) {
+        out[strcspn(out, "\n")] = '\0';
+    }
+    fclose(f);
+    // Tabs (tcp_rmem) do not belong in a JSON string
+    for (char* p = out; *p; p++) {
+        if (*p == '\t') {
+            *p = ' ';
+        }
+    }
+}
+
+static inline long meta_read_long(const char* path) {
+    char buf[META_FIELD_LEN];
+    meta_read_line(path, buf, sizeof(buf));
+    long v = -1;
+    sscanf(buf, "%ld", &v);
+    return v;
+}
+
+static inline void meta_collect(run_meta_t* m) {
+    memset(m, 0, sizeof(*m));
+    struct utsname u;
+    if (uname(&u) == 0) {
+        snprintf(m->kernel, sizeof(m->kernel), "%s", u.release);
+        snprintf(m->arch, sizeof(m->arch), "%s", u.machine);
+    }
+    m->cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    snprintf(m->cpu_model, sizeof(m->cpu_model), "n/a");
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    if (f) {
+        char line[256];
+        while (fgets(line, sizeof(line), f)) {
+            char* colon = strchr(line, ':');
+            if (colon && strncmp(line, "model name", 10) == 0) {
+                colon += strspn(colon + 1, " ") + 1;
+                colon[strcspn(colon, "\n")] = '\0';
+                snprintf(m->cpu_model, sizeof(m->cpu_model), "%s", colon);
+                break;
+            }
+        }
+        fclose(f);
+    }
+
+    meta_read_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", m->governor, sizeof(m->governor));
+    meta_read_line("/sys/devices/system/cpu/smt/control", m->smt, sizeof(m->smt));
+
+    // "always [madvise] never": keep only the selected value
+    char thp[META_FIELD_LEN];
+    meta_read_line("/sys/kernel/mm/transparent_hugepage/enabled", thp, sizeof(thp));
+    char* selected = strchr(thp, '[');
+    char* end = selected ? strchr(selected, ']') : NULL;
+    if (selected && end) {
+        *end = '\0';
+        snprintf(m->thp, sizeof(m->thp), "%s", selected + 1);
+    } else {
+        snprintf(m->thp, sizeof(m->thp), "%s", thp);
+    }
+
+    m->optmem_max = meta_read_long("/proc/sys/net/core/optmem_max");
+    m->rmem_max = meta_read_long("/proc/sys/net/core/rmem_max");
+    m->wmem_max = meta_read_long("/proc/sys/net/core/wmem_max");
+    meta_read_line("/proc/sys/net/ipv4/tcp_rmem", m->tcp_rmem, sizeof(m->tcp_rmem));
+    meta_read_line("/proc/sys/net/ipv4/tcp_wmem", m->tcp_wmem, sizeof(m->tcp_wmem));
+    meta_read_line("/proc/sys/net/ipv4/tcp_congestion_control", m->congestion, sizeof(m->congestion));
+}
+
+// Prints a JSON string value, escaping quotes and backslashes
+static inline void meta_json_string(FILE* out, const char* key, const char* value) {
+    fprintf(out, "\"%s\":\"", key);
+    for (const char* p = value; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*p, out);
+    }
+    fputs("\",", out);
+}
+
+static inline void meta_print(FILE* out, const run_meta_t* m, const char* binary) {
+    char started[32];
+    time_t now = time(NULL);
+    struct tm tm;
+    strftime(started, sizeof(started), "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&now, &tm));
+
+    fputs("Run Metadata: {", out);
+    const char* base = strrchr(binary, '/');
+    meta_json_string(out, "binary", base ? base + 1 : binary);
+    meta_json_string(out, "started", started);
+    meta_json_string(out, "git", MT25043_GIT_REV);
+    meta_json_string(out, "kernel", m->kernel);
+    meta_json_string(out, "arch", m->arch);
+    meta_json_string(out, "cpu_model", m->cpu_model);
+    fprintf(out, "\"cpus\":%ld,", m->cpus);
+    meta_json_string(out, "governor", m->governor);
+    meta_json_string(out, "smt", m->smt);
+    meta_json_string(out, "thp", m->thp);
+    fprintf(out, "\"optmem_max\":%ld,\"rmem_max\":%ld,\"wmem_max\":%ld,", m->optmem_max, m->rmem_max, m->wmem_max);
+    meta_json_string(out, "tcp_rmem", m->tcp_rmem);
+    meta_json_string(out, "tcp_wmem", m->tcp_wmem);
+    meta_json_string(out, "congestion", m->congestion);
+    fprintf(out, "\"pid\":%d}\n", (int)getpid());
+}
+
+// Returns the number of warnings printed
+static inline int meta_warn(const run_meta_t* m, int zerocopy) {
+    int warnings = 0;
+    if (strcmp(m->governor, "powersave") == 0 || strcmp(m->governor, "conservative") == 0) {
+        fprintf(stderr, "Warning: CPU frequency governor is '%s'; results will vary with clock ramp-up "
+                        "(set 'performance' for stable numbers)\n", m->governor);
+        warnings++;
+    }
+    if (zerocopy && m->optmem_max >= 0 && m->optmem_max < META_OPTMEM_MIN) {
+        fprintf(stderr, "Warning: net.core.optmem_max is %ld bytes; MSG_ZEROCOPY notifications are charged to it "
+                        "and sends fail or fall back to copying when it runs out (use >= %d)\n",
+                m->optmem_max, META_OPTMEM_MIN);
+        warnings++;
+    }
+    return warnings;
+}
+
+// Collects, prints and checks the metadata of this run in one call
+static inline void meta_report(const char* binary, int zerocopy) {
+    run_meta_t m;
+    meta_collect(&m);
+    meta_print(stdout, &m, binary);
+    meta_warn(&m, zerocopy);
+    fflush(stdout);
+}
+
+#endif // MT25043_META_H
@@ -0,0 +1,407 @@
+// MT25043
+//
+// File: MT25043_Metrics.h
+//
+// Description: Live metrics endpoint for long (soak) runs. metrics_start()
+// listens on a Unix socket and serves the current counters on every
+// connection: bytes and syscalls in each direction, throughput over the
+// last one to two seconds, active and total connections, zero-copy
+// completions (and how many the kernel copied after all), and the
+// send()/recv() call latency distribution. The format is Prometheus text,
+// or JSON when the request asks for it:
+//
+//   curl -s --unix-socket /tmp/server.metrics http://localhost/metrics
+//   curl -s --unix-socket /tmp/server.metrics http://localhost/metrics.json
+//   echo json | socat - UNIX-CONNECT:/tmp/server.metrics
+//
+// Every connection thread owns a slot (metrics_thread_start()) and is its
+// only writer: updates are plain adds published with relaxed atomic
+// stores, no locks and no read-modify-write instructions. The endpoint
+// thread sums the slots with relaxed loads, so a snapshot never stops the
+// hot path; each counter is exact, the counters are not taken at the same
+// instant. Slots are reused by later connections and never reset, so the
+// totals only grow. Without --metrics the hooks are a thread-local NULL
+// check.
+// ============================================================================
+
+#ifndef MT25043_METRICS_H
+#define MT25043_METRICS_H
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "MT25043_Hist.h"
+
+#define METRICS_MAX_SLOTS 16384     // Concurrent connections or sessions tracked
+#define METRICS_WINDOW_MS 1000      // Throughput window: the last 1-2 of these
+#define METRICS_REQUEST_MS 100      // Wait this long for a request line
+#define METRICS_RESPONSE_SIZE 8192
+
+typedef struct {
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint64_t sends;
+    uint64_t recvs;
+    uint64_t zc_completions;
+    uint64_t zc_copied;
+    hist_t latency;         // send()/recv() call time, ns
+    int owned;              // A connection thread is writing to this slot
+} metrics_slot_t;
+
+typedef struct {
+    double time;
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint64_t sends;
+    uint64_t recvs;
+    uint64_t zc_completions;
+    uint64_t zc_copied;
+    int active;
+    hist_t latency;
+} metrics_snapshot_t;
+
+static metrics_slot_t* g_metrics_slots[METRICS_MAX_SLOTS];
+static uint32_t g_metrics_reserved = 0;
+static uint64_t g_metrics_connections = 0;
+static int g_metrics_fd = -1;
+static char g_metrics_role[32];
+static double g_metrics_start_time;
+static __thread metrics_slot_t* t_metrics_slot = NULL;
+
+static inline int metrics_enabled(void) {
+    return g_metrics_fd >= 0;
+}
+
+static inline double metrics_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Single writer: a load and a relaxed store, published to the reader
+static inline void metrics_add(uint64_t* counter, uint64_t v) {
+    __atomic_store_n(counter, *counter + v, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_hist_record(hist_t* h, uint64_t v) {
+    int b = hist_bucket(v);
+    __atomic_store_n(&h->buckets[b], h->buckets[b] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->count, h->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->sum, h->sum + v, __ATOMIC_RELAXED);
+    if (v < h->min) __atomic_store_n(&h->min, v, __ATOMIC_RELAXED);
+    if (v > h->max) __atomic_store_n(&h->max, v, __ATOMIC_RELAXED);
+}
+
+// Claims a slot for this connection thread; a no-op without --metrics.
+static inline void metrics_thread_start(void) {
+    if (!metrics_enabled() || t_metrics_slot) {
+        return;
+    }
+    __atomic_fetch_add(&g_metrics_connections, 1, __ATOMIC_RELAXED);
+    uint32_t reserved = __atomic_load_n(&g_metrics_reserved, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < reserved && i < METRICS_MAX_SLOTS; i++) {
+        metrics_slot_t* slot = __atomic_load_n(&g_metrics_slots[i], __ATOMIC_ACQUIRE);
+        int expected = 0;
+        if (slot && __atomic_compare_exchange_n(&slot->owned, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            t_metrics_slot = slot;
+            return;
+        }
+    }
+    metrics_slot_t* slot = (metrics_slot_t*)calloc(1, sizeof(metrics_slot_t));
+    if (!slot) {
+        return;
+    }
+    hist_init(&slot->latency);
+    slot->owned = 1;
+    uint32_t index = __atomic_fetch_add(&g_metrics_reserved, 1, __ATOMIC_ACQ_REL);
+    if (index >= METRICS_MAX_SLOTS) {
+        if (index == METRICS_MAX_SLOTS) {
+            fprintf(stderr, "Metrics: more than %d concurrent connections, the rest are not counted\n",
+                    METRICS_MAX_SLOTS);
+        }
+        free(slot);
+        return;
+    }
+    __atomic_store_n(&g_metrics_slots[index], slot, __ATOMIC_RELEASE);
+    t_metrics_slot = slot;
+}
+
+// Hands the slot (and its totals) on to a later connection.
+static inline void metrics_thread_stop(void) {
+    if (t_metrics_slot) {
+        __atomic_store_n(&t_metrics_slot->owned, 0, __ATOMIC_RELEASE);
+        t_metrics_slot = NULL;
+    }
+}
+
+// Start time of a send()/recv() to time, or 0 if this thread has no slot.
+static inline uint64_t metrics_clock(void) {
+    if (__builtin_expect(t_metrics_slot == NULL, 1)) {
+        return 0;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline void metrics_tx(size_t bytes, uint64_t start_ns) {
+    metrics_slot_t* slot = t_metrics_slot;
+    if (__builtin_expect(slot == NULL, 1)) {
+        return;
+    }
+    metrics_add(&slot->tx_bytes, bytes);
+    metrics_add(&slot->sends, 1);
+    if (start_ns > 0) {
+        metrics_hist_record(&slot->latency, metrics_clock() - start_ns);
+    }
+}
+
+static inline void metrics_rx(size_t bytes, uint64_t latency_ns) {
+    metrics_slot_t* slot = t_metrics_slot;
+    if (__builtin_expect(slot == NULL, 1)) {
+        return;
+    }
+    metrics_add(&slot->rx_bytes, bytes);
+    metrics_add(&slot->recvs, 1);
+    metrics_hist_record(&slot->latency, latency_ns);
+}
+
+static inline void metrics_completions(uint64_t count, uint64_t copied) {
+    metrics_slot_t* slot = t_metrics_slot;
+    if (__builtin_expect(slot == NULL, 1)) {
+        return;
+    }
+    metrics_add(&slot->zc_completions, count);
+    metrics_add(&slot->zc_copied, copied);
+}
+
+static inline void metrics_snapshot(metrics_snapshot_t* s) {
+    memset(s, 0, sizeof(*s));
+    hist_init(&s->latency);
+    s->time = metrics_now();
+    uint32_t reserved = __atomic_load_n(&g_metrics_reserved, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < reserved && i < METRICS_MAX_SLOTS; i++) {
+        metrics_slot_t* slot = __atomic_load_n(&g_metrics_slots[i], __ATOMIC_ACQUIRE);
+        if (!slot) {
+            continue;
+        }
+        s->tx_bytes += __atomic_load_n(&slot->tx_bytes, __ATOMIC_RELAXED);
+        s->rx_bytes += __atomic_load_n(&slot->rx_bytes, __ATOMIC_RELAXED);
+        s->sends += __atomic_load_n(&slot->sends, __ATOMIC_RELAXED);
+        s->recvs += __atomic_load_n(&slot->recvs, __ATOMIC_RELAXED);
+        s->zc_completions += __atomic_load_n(&slot->zc_completions, __ATOMIC_RELAXED);
+        s->zc_copied += __atomic_load_n(&slot->zc_copied, __ATOMIC_RELAXED);
+        s->active += __atomic_load_n(&slot->owned, __ATOMIC_RELAXED);
+
+        hist_t* h = &slot->latency;
+        for (int b = 0; b < HIST_BUCKETS; b++) {
+            s->latency.buckets[b] += __atomic_load_n(&h->buckets[b], __ATOMIC_RELAXED);
+        }
+        s->latency.count += __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+        s->latency.sum += __atomic_load_n(&h->sum, __ATOMIC_RELAXED);
+        uint64_t min = __atomic_load_n(&h->min, __ATOMIC_RELAXED);
+        uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+        if (min < s->latency.min) s->latency.min = min;
+        if (max > s->latency.max) s->latency.max = max;
+    }
+}
+
+static inline void metrics_append(char* out, size_t* len, const char* fmt, ...) {
+    if (*len >= METRICS_RESPONSE_SIZE - 1) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(out + *len, METRICS_RESPONSE_SIZE - *len, fmt, args);
+    va_end(args);
+    if (n > 0) {
+        *len += (size_t)n;
+    }
+    if (*len > METRICS_RESPONSE_SIZE - 1) {
+        *len = METRICS_RESPONSE_SIZE - 1; // Truncated: only what vsnprintf() stored, without the NUL
+    }
+}
+
+static inline double metrics_gbps(uint64_t now, uint64_t then, double seconds) {
+    return seconds > 0 ? (now - then) * 8.0 / seconds / 1e9 : 0.0;
+}
+
+static const double g_metrics_quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+static inline size_t metrics_prometheus(char* out, const metrics_snapshot_t* s, const metrics_snapshot_t* prev) {
+    size_t len = 0;
+    double window = s->time - prev->time;
+    const char* role = g_metrics_role;
+    metrics_append(out, &len, "# TYPE mt25043_uptime_seconds gauge\nmt25043_uptime_seconds{role=\"%s\"} %.3f\n",
+                   role, s->time - g_metrics_start_time);
+    metrics_append(out, &len, "# TYPE mt25043_connections_active gauge\nmt25043_connections_active{role=\"%s\"} %d\n",
+                   role, s->active);
+    metrics_append(out, &len, "# TYPE mt25043_connections_total counter\nmt25043_connections_total{role=\"%s\"} %llu\n",
+                   role, (unsigned long long)__atomic_load_n(&g_metrics_connections, __ATOMIC_RELAXED));
+    metrics_append(out, &len, "# TYPE mt25043_bytes_total counter\n"
+                              "mt25043_bytes_total{role=\"%s\",direction=\"tx\"} %llu\n"
+                              "mt25043_bytes_total{role=\"%s\",direction=\"rx\"} %llu\n",
+                   role, (unsigned long long)s->tx_bytes, role, (unsigned long long)s->rx_bytes);
+    metrics_append(out, &len, "# TYPE mt25043_syscalls_total counter\n"
+                              "mt25043_syscalls_total{role=\"%s\",op=\"send\"} %llu\n"
+                              "mt25043_syscalls_total{role=\"%s\",op=\"recv\"} %llu\n",
+                   role, (unsigned long long)s->sends, role, (unsigned long long)s->recvs);
+    metrics_append(out, &len, "# TYPE mt25043_throughput_gbps gauge\n"
+                              "mt25043_throughput_gbps{role=\"%s\",direction=\"tx\"} %.6f\n"
+                              "mt25043_throughput_gbps{role=\"%s\",direction=\"rx\"} %.6f\n",
+                   role, metrics_gbps(s->tx_bytes, prev->tx_bytes, window),
+                   role, metrics_gbps(s->rx_bytes, prev->rx_bytes, window));
+    metrics_append(out, &len, "# TYPE mt25043_zerocopy_completions_total counter\n"
+                              "mt25043_zerocopy_completions_total{role=\"%s\"} %llu\n"
+                              "# TYPE mt25043_zerocopy_copied_total counter\n"
+                              "mt25043_zerocopy_copied_total{role=\"%s\"} %llu\n",
+                   role, (unsigned long long)s->zc_completions, role, (unsigned long long)s->zc_copied);
+    metrics_append(out, &len, "# TYPE mt25043_call_latency_seconds summary\n");
+    for (size_t i = 0; i < sizeof(g_metrics_quantiles) / sizeof(g_metrics_quantiles[0]); i++) {
+        metrics_append(out, &len, "mt25043_call_latency_seconds{role=\"%s\",quantile=\"%g\"} %.9f\n", role,
+                       g_metrics_quantiles[i], hist_percentile(&s->latency, g_metrics_quantiles[i]) / 1e9);
+    }
+    metrics_append(out, &len, "mt25043_call_latency_seconds_sum{role=\"%s\"} %.9f\n"
+                              "mt25043_call_latency_seconds_count{role=\"%s\"} %llu\n",
+                   role, s->latency.sum / 1e9, role, (unsigned long long)s->latency.count);
+    return len;
+}
+
+static inline size_t metrics_json(char* out, const metrics_snapshot_t* s, const metrics_snapshot_t* prev) {
+    size_t len = 0;
+    double window = s->time - prev->time;
+    metrics_append(out, &len, "{\"role\":\"%s\",\"uptime_s\":%.3f,\"connections_active\":%d,\"connections_total\":%llu,",
+                   g_metrics_role, s->time - g_metrics_start_time, s->active,
+                   (unsigned long long)__atomic_load_n(&g_metrics_connections, __ATOMIC_RELAXED));
+    metrics_append(out, &len, "\"tx_bytes\":%llu,\"rx_bytes\":%llu,\"sends\":%llu,\"recvs\":%llu,"
+                              "\"tx_gbps\":%.6f,\"rx_gbps\":%.6f,\"window_s\":%.3f,",
+                   (unsigned long long)s->tx_bytes, (unsigned long long)s->rx_bytes, (unsigned long long)s->sends,
+                   (unsigned long long)s->recvs, metrics_gbps(s->tx_bytes, prev->tx_bytes, window),
+                   metrics_gbps(s->rx_bytes, prev->rx_bytes, window), window);
+    metrics_append(out, &len, "\"zerocopy_completions\":%llu,\"zerocopy_copied\":%llu,",
+                   (unsigned long long)s->zc_completions, (unsigned long long)s->zc_copied);
+    metrics_append(out, &len, "\"latency_us\":{\"count\":%llu,\"avg\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,"
+                              "\"p999\":%.3f,\"max\":%.3f}}\n",
+                   (unsigned long long)s->latency.count, hist_mean(&s->latency) / 1000.0,
+                   hist_percentile(&s->latency, 0.5) / 1000.0, hist_percentile(&s->latency, 0.9) / 1000.0,
+                   hist_percentile(&s->latency, 0.99) / 1000.0, hist_percentile(&s->latency, 0.999) / 1000.0,
+                   s->latency.max / 1000.0);
+    return len;
+}
+
+static inline void metrics_write_all(int fd, const char* p, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        p += n;
+        len -= (size_t)n;
+    }
+}
+
+// Answers one scrape: "GET /metrics[.json]" over HTTP, or a bare line
+// ("json" or anything else) from socat/nc, or nothing at all.
+static inline void metrics_serve(int fd, const metrics_snapshot_t* prev) {
+    char request[1024];
+    ssize_t n = 0;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+    if (poll(&pfd, 1, METRICS_REQUEST_MS) > 0) {
+        n = recv(fd, request, sizeof(request) - 1, 0);
+    }
+    request[n > 0 ? n : 0] = '\0';
+    int http = strncmp(request, "GET ", 4) == 0;
+    char* target = http ? request + 4 : request; // HTTP: only the path counts
+    if (http) {
+        target[strcspn(target, " \r\n")] = '\0';
+    }
+    int json = strstr(target, "json") != NULL;
+
+    static char body[METRICS_RESPONSE_SIZE];
+    metrics_snapshot_t s;
+    metrics_snapshot(&s);
+    size_t len = json ? metrics_json(body, &s, prev) : metrics_prometheus(body, &s, prev);
+    if (http) {
+        char header[160];
+        int h = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: %s\r\nContent-Length: %zu\r\n\r\n",
+                         json ? "application/json" : "text/plain; version=0.0.4", len);
+        metrics_write_all(fd, header, (size_t)h);
+    }
+    metrics_write_all(fd, body, len);
+}
+
+static inline void* metrics_thread(void* arg) {
+    (void)arg;
+    // Throughput is measured from the second-to-last tick: 1-2 s of data
+    static metrics_snapshot_t prev, last;
+    metrics_snapshot(&prev);
+    last = prev;
+    while (1) {
+        struct pollfd pfd = { .fd = g_metrics_fd, .events = POLLIN, .revents = 0 };
+        int ready = poll(&pfd, 1, METRICS_WINDOW_MS);
+        if (metrics_now() - last.time >= METRICS_WINDOW_MS / 1000.0) {
+            prev = last;
+            metrics_snapshot(&last);
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        int fd = accept(g_metrics_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        metrics_serve(fd, &prev);
+        close(fd);
+    }
+    return NULL;
+}
+
+// Listens on the Unix socket path (replacing a stale socket there) and
+// starts the endpoint thread. Call before any connection thread starts.
+static inline int metrics_start(const char* path, const char* role) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Metrics: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        perror("Metrics: cannot listen on the Unix socket");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    const char* base = strrchr(role, '/');
+    snprintf(g_metrics_role, sizeof(g_metrics_role), "%s", base ? base + 1 : role);
+    g_metrics_start_time = metrics_now();
+    g_metrics_fd = fd;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, metrics_thread, NULL) != 0) {
+        perror("Metrics: failed to start the endpoint thread");
+        g_metrics_fd = -1;
+        close(fd);
+        return -1;
+    }
+    pthread_detach(thread);
+    printf("Metrics: serving Prometheus text and JSON on unix:%s\n", path);
+    return 0;
+}
+
+#endif // MT25043_METRICS_H
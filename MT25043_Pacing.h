@@ -0,0 +1,153 @@
+// MT25043
+//
+// File: MT25043_Pacing.h
+//
+// Description: Per-connection send pacing, so a sender spreads its data
+// over time instead of writing bursts as fast as the socket accepts them.
+//
+// Modes (--pacing, with -r/--rate RATE):
+// - maxrate : SO_MAX_PACING_RATE; the kernel paces the flow (fq qdisc, or
+//             TCP internal pacing where fq is not installed)
+// - txtime  : earliest-departure-time pacing in the sender: every send is
+//             given a departure time from the rate and the thread sleeps
+//             until it (clock_nanosleep, TIMER_ABSTIME). TCP ignores the
+//             SCM_TXTIME control message, so the schedule is kept here.
+//
+// Rates are bits per second with an optional k/m/g suffix ("500m",
+// "2gbit"), per connection.
+// ============================================================================
+
+#ifndef MT25043_PACING_H
+#define MT25043_PACING_H
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#ifndef SO_MAX_PACING_RATE
+#define SO_MAX_PACING_RATE 47
+#endif
+
+// A sender that falls this far behind its schedule restarts it instead of
+// bursting to catch up
+#define PACING_MAX_LAG_NS 1000000L
+
+typedef enum {
+    PACING_NONE = 0,
+    PACING_MAXRATE,
+    PACING_TXTIME
+} pacing_mode_t;
+
+static const char* const pacing_mode_names[] = { "none", "maxrate", "txtime" };
+
+typedef struct {
+    pacing_mode_t mode;
+    uint64_t rate_bps;
+    long next_ns;           // txtime: departure time of the next send
+    long sleeps;
+    long sleep_ns;
+} pacing_t;
+
+static inline int parse_pacing_mode(const char* name, pacing_mode_t* mode) {
+    for (int i = 1; i < (int)(sizeof(pacing_mode_names) / sizeof(pacing_mode_names[0])); i++) {
+        if (strcasecmp(name, pacing_mode_names[i]) == 0) {
+            *mode = (pacing_mode_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline const char* pacing_mode_name(pacing_mode_t mode) {
+    return pacing_mode_names[mode];
+}
+
+// Parses "750m", "2g", "2gbit" or a plain number into bits per second.
+static inline int parse_rate(const char* text, uint64_t* rate_bps) {
+    char* end;
+    double value = strtod(text, &end);
+    if (end == text || value <= 0) {
+        return -1;
+    }
+    switch (tolower((unsigned char)*end)) {
+    case 'k': value *= 1e3; end++; break;
+    case 'm': value *= 1e6; end++; break;
+    case 'g': value *= 1e9; end++; break;
+    default: break;
+    }
+    if (*end != '\0' && strcasecmp(end, "bit") != 0 && strcasecmp(end, "bps") != 0) {
+        return -1;
+    }
+    *rate_bps = (uint64_t)value;
+    return 0;
+}
+
+static inline long pacing_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Configures pacing for sock. A rate of 0 or mode NONE disables pacing.
+static inline int pacing_init(pacing_t* p, int sock, pacing_mode_t mode, uint64_t rate_bps) {
+    memset(p, 0, sizeof(*p));
+    p->mode = rate_bps > 0 ? mode : PACING_NONE;
+    p->rate_bps = rate_bps;
+    if (p->mode == PACING_MAXRATE) {
+        // 64-bit since Linux 4.20; older kernels take 32-bit bytes/s
+        uint64_t bytes_per_sec = rate_bps / 8;
+        if (setsockopt(sock, SOL_SOCKET, SO_MAX_PACING_RATE, &bytes_per_sec, sizeof(bytes_per_sec)) < 0) {
+            uint32_t rate32 = bytes_per_sec > UINT32_MAX ? UINT32_MAX : (uint32_t)bytes_per_sec;
+            if (setsockopt(sock, SOL_SOCKET, SO_MAX_PACING_RATE, &rate32, sizeof(rate32)) < 0) {
+                perror("setsockopt SO_MAX_PACING_RATE");
+                return -1;
+            }
+        }
+    } else if (p->mode == PACING_TXTIME) {
+        p->next_ns = pacing_now_ns();
+    }
+    return 0;
+}
+
+// Blocks until the next send may depart (txtime mode only).
+static inline void pacing_wait(pacing_t* p) {
+    if (p->mode != PACING_TXTIME) {
+        return;
+    }
+    long now = pacing_now_ns();
+    if (now >= p->next_ns) {
+        if (now - p->next_ns > PACING_MAX_LAG_NS) {
+            p->next_ns = now;
+        }
+        return;
+    }
+    struct timespec until = { p->next_ns / 1000000000L, p->next_ns % 1000000000L };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL);
+    p->sleeps++;
+    p->sleep_ns += p->next_ns - now;
+}
+
+// Advances the departure schedule by the serialization time of bytes.
+static inline void pacing_sent(pacing_t* p, size_t bytes) {
+    if (p->mode == PACING_TXTIME) {
+        p->next_ns += (long)(bytes * 8.0 * 1e9 / p->rate_bps);
+    }
+}
+
+static inline void pacing_report(const pacing_t* p, int client_socket) {
+    if (p->mode == PACING_NONE) {
+        return;
+    }
+    printf("Server: Socket %d paced at %.3f Mbit/s (%s)", client_socket, p->rate_bps / 1e6, pacing_mode_name(p->mode));
+    if (p->mode == PACING_TXTIME && p->sleeps > 0) {
+        printf(", %ld sleeps, avg %.3f us", p->sleeps, p->sleep_ns / 1000.0 / p->sleeps);
+    }
+    printf("\n");
+}
+
+#endif // MT25043_PACING_H
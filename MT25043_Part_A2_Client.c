@@ -29,21 +29,58 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <signal.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "MT25043_Recv.h"
+#include "MT25043_Deser.h"
+#include "MT25043_Crc32c.h"
+#include "MT25043_Trace.h"
+#include "MT25043_TcpInfo.h"
+#include "MT25043_Duplex.h"
+#include "MT25043_Hist.h"
+#include "MT25043_Tls.h"
+#include "MT25043_Pipeline.h"
+#include "MT25043_Meta.h"
+#include "MT25043_Metrics.h"
+#include "MT25043_Memory.h"
+#include "MT25043_Coro.h"
 
 #define PORT 8080
-#define RECV_BUFFER_SIZE 65536 // 64KB buffer for receiving data
-#define NUM_FIELDS 8
 
 typedef struct {
     int thread_id;
     int msg_size;
     int duration;
     const char* server_ip;
+    recv_mode_t recv_mode;
+    int recv_buf_size;
+    int verify;
+    const schema_t* schema;
     long* total_bytes_received;
     long* total_latency_us;
     long* total_recvs;
+    long* total_verified;
+    long* total_verify_errors;
+    long* total_verify_ns;
+    deser_mode_t deser_mode;
+    long* total_deser_msgs;
+    long* total_deser_split;
+    long* total_deser_errors;
+    long* total_deser_ns;
+    int duplex;
+    int tls;
+    tx_strategy_t tx_strategy;
+    long* total_tx_bytes;
+    long* total_tx_sends;
+    long* total_tx_ns;
+    pipeline_t* pipeline;       // NULL unless --workers
+    hist_t latency_hist;        // Per-thread, merged after join
+    hist_t message_latency;     // Stamped frames: send to decode, merged after join
+    arrival_t arrivals;
 } client_thread_args_t;
 
 void* run_client(void* args) {
@@ -56,7 +93,7 @@ void* run_client(void* args) {
 
     if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         printf("\n Socket creation error \n");
-        pthread_exit(NULL);
+        return NULL;
     }
 
     serv_addr.sin_family = AF_INET;
@@ -65,99 +102,431 @@ void* run_client(void* args) {
     if (inet_pton(AF_INET, thread_args->server_ip, &serv_addr.sin_addr) <= 0) {
         printf("\nInvalid address/ Address not supported \n");
         close(sock);
-        pthread_exit(NULL);
+        return NULL;
     }
 
-    if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+    if (coro_connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
         printf("\nConnection Failed \n");
         close(sock);
-        pthread_exit(NULL);
+        return NULL;
     }
     
-    char ready_signal = 'R';
-    if (send(sock, &ready_signal, 1, 0) <= 0) {
+    char ready_signal = thread_args->duplex ? DUPLEX_READY_SIGNAL : 'R';
+    if (coro_send(sock, &ready_signal, 1, 0) <= 0) {
         perror("Handshake send failed");
         close(sock);
-        pthread_exit(NULL);
+        return NULL;
     }
 
     char go_signal;
-    if (recv(sock, &go_signal, 1, 0) <= 0) {
+    if (coro_recv(sock, &go_signal, 1, 0) <= 0) {
         perror("Handshake recv failed");
         close(sock);
-        pthread_exit(NULL);
+        return NULL;
     }
 
-    // Allocate buffer for receiving data
-    char* recv_buffer = (char*)malloc(RECV_BUFFER_SIZE);
-    if (!recv_buffer) {
-        perror("Failed to allocate receive buffer");
-        close(sock);
-        pthread_exit(NULL);
+    trace_thread_start(sock);
+    tcpinfo_register(sock);
+    mem_register(sock);
+
+    // kTLS mode: the stream (and duplex traffic) is encrypted after the handshake
+    if (thread_args->tls && ktls_client_start(sock, thread_args->duplex) < 0) {
+        goto unregister;
+    }
+
+    // Allocate the destination for the selected receive strategy
+    receiver_t receiver;
+    if (receiver_init(&receiver, thread_args->recv_mode, sock, thread_args->schema,
+                      thread_args->verify ? CRC32C_TRAILER_SIZE : 0, thread_args->recv_buf_size) < 0) {
+        goto unregister;
+    }
+
+    // Framed schemas: decode every message as a view or by copying its fields
+    deser_t deser;
+    if (deser_init(&deser, thread_args->deser_mode, thread_args->verify ? CRC32C_TRAILER_SIZE : 0, receiver.frame_size) < 0) {
+        receiver_destroy(&receiver);
+        goto unregister;
+    }
+    long deser_ns_this_thread = 0;
+    struct timespec deser_start, deser_end;
+
+    // Full-duplex mode: stream messages to the server from a second thread
+    duplex_tx_t duplex_tx;
+    memset(&duplex_tx, 0, sizeof(duplex_tx));
+    if (thread_args->duplex) {
+        if (duplex_tx_init(&duplex_tx, sock, thread_args->tx_strategy, thread_args->schema, thread_args->verify) < 0 ||
+            duplex_tx_start(&duplex_tx, duration) < 0) {
+            duplex_tx_destroy(&duplex_tx);
+            deser_destroy(&deser);
+            receiver_destroy(&receiver);
+            goto unregister;
+        }
     }
 
-    struct timeval start_time, current_time, recv_start, recv_end;
+    metrics_thread_start();
+
+    struct timeval start_time, current_time;
+    struct timespec recv_start, recv_end;
     gettimeofday(&start_time, NULL);
 
     long bytes_this_thread = 0;
-    long latency_this_thread = 0;
+    long latency_this_thread = 0;     // ns
     long recvs_this_thread = 0;
 
+    // Checksum mode: touch every received byte and compare per-message CRCs
+    crc_verifier_t verifier;
+    crc_verifier_init(&verifier, thread_args->schema->total);
+    long verify_ns_this_thread = 0;
+    struct timespec verify_start, verify_end;
+
     while (1) {
+        trace_event(TRACE_CLOCK_BEGIN, 0);
         gettimeofday(&current_time, NULL);
+        trace_event(TRACE_CLOCK_END, 0);
         if (current_time.tv_sec - start_time.tv_sec >= duration) {
             break;
         }
 
-        gettimeofday(&recv_start, NULL);
-        ssize_t bytes_received = recv(sock, recv_buffer, RECV_BUFFER_SIZE, 0);
-        gettimeofday(&recv_end, NULL);
+        size_t prev_offset = receiver.msg_offset;
+        clock_gettime(CLOCK_MONOTONIC, &recv_start);
+        trace_event(TRACE_RECV_BEGIN, 0);
+        ssize_t bytes_received;
+        while ((bytes_received = receiver_recv(&receiver)) < 0 && coro_wait_io(sock, EPOLLIN)) {
+            // Coroutine sessions park here until the socket is readable
+        }
+        trace_event(TRACE_RECV_END, bytes_received > 0 ? (uint64_t)bytes_received : 0);
+        clock_gettime(CLOCK_MONOTONIC, &recv_end);
 
         if (bytes_received <= 0) {
             break;
         }
         bytes_this_thread += bytes_received;
-        latency_this_thread += (recv_end.tv_sec - recv_start.tv_sec) * 1000000 + (recv_end.tv_usec - recv_start.tv_usec);
+        long recv_ns = (recv_end.tv_sec - recv_start.tv_sec) * 1000000000L + (recv_end.tv_nsec - recv_start.tv_nsec);
+        latency_this_thread += recv_ns;
+        hist_record(&thread_args->latency_hist, (uint64_t)recv_ns);
+        metrics_rx((size_t)bytes_received, (uint64_t)recv_ns);
+        if (thread_args->deser_mode == DESER_NONE) {
+            arrival_record(&thread_args->arrivals, recv_end.tv_sec * 1000000000L + recv_end.tv_nsec,
+                           (prev_offset + (size_t)bytes_received) / receiver.frame_size);
+        }
         recvs_this_thread++;
+
+        if (thread_args->verify) {
+            clock_gettime(CLOCK_MONOTONIC, &verify_start);
+            trace_event(TRACE_VERIFY_BEGIN, 0);
+            receiver_for_each_span(&receiver, prev_offset, bytes_received, crc_verifier_span, &verifier);
+            trace_event(TRACE_VERIFY_END, (uint64_t)bytes_received);
+            clock_gettime(CLOCK_MONOTONIC, &verify_end);
+            verify_ns_this_thread += (verify_end.tv_sec - verify_start.tv_sec) * 1000000000L + (verify_end.tv_nsec - verify_start.tv_nsec);
+        }
+
+        if (thread_args->deser_mode != DESER_NONE) {
+            long decoded = deser.messages;
+            clock_gettime(CLOCK_MONOTONIC, &deser_start);
+            receiver_for_each_span(&receiver, prev_offset, bytes_received, deser_span, &deser);
+            clock_gettime(CLOCK_MONOTONIC, &deser_end);
+            deser_ns_this_thread += (deser_end.tv_sec - deser_start.tv_sec) * 1000000000L + (deser_end.tv_nsec - deser_start.tv_nsec);
+            // Frames vary in size (replayed traces): count the decoded ones
+            arrival_record(&thread_args->arrivals, recv_end.tv_sec * 1000000000L + recv_end.tv_nsec,
+                           (size_t)(deser.messages - decoded));
+        }
+
+        if (thread_args->pipeline) {
+            receiver_for_each_span(&receiver, prev_offset, bytes_received, pipeline_span,
+                                   pipeline_producer(thread_args->pipeline, thread_args->thread_id));
+        }
+
+        coro_tick(); // A session that never has to park still lets the others run
     }
 
     __sync_fetch_and_add(total_bytes_received, bytes_this_thread);
-    __sync_fetch_and_add(thread_args->total_latency_us, latency_this_thread);
+    __sync_fetch_and_add(thread_args->total_latency_us, latency_this_thread / 1000);
     __sync_fetch_and_add(thread_args->total_recvs, recvs_this_thread);
+    __sync_fetch_and_add(thread_args->total_verified, verifier.verified);
+    __sync_fetch_and_add(thread_args->total_verify_errors, verifier.errors);
+    __sync_fetch_and_add(thread_args->total_verify_ns, verify_ns_this_thread);
+    __sync_fetch_and_add(thread_args->total_deser_msgs, deser.messages);
+    __sync_fetch_and_add(thread_args->total_deser_split, deser.split);
+    __sync_fetch_and_add(thread_args->total_deser_errors, deser.errors);
+    __sync_fetch_and_add(thread_args->total_deser_ns, deser_ns_this_thread);
+    thread_args->message_latency = deser.latency;
+    deser_destroy(&deser);
+
+    if (thread_args->duplex) {
+        duplex_tx_join(&duplex_tx);
+        __sync_fetch_and_add(thread_args->total_tx_bytes, duplex_tx.bytes);
+        __sync_fetch_and_add(thread_args->total_tx_sends, duplex_tx.sends);
+        __sync_fetch_and_add(thread_args->total_tx_ns, duplex_tx.send_ns);
+        duplex_tx_destroy(&duplex_tx);
+    }
     
-    free(recv_buffer);
+    metrics_thread_stop();
+    receiver_destroy(&receiver);
+
+unregister:
+    // Every path after tcpinfo_register() leaves through here
+    tcpinfo_unregister(sock);
+    mem_unregister(sock);
     close(sock);
     return NULL;
 }
 
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options] <server_ip> <thread_count> <message_size> <duration_in_seconds>\n", prog);
+    fprintf(stderr, "  -r, --recv-mode MODE      recv (default), waitall, readv or trunc\n");
+    fprintf(stderr, "  -b, --recv-buffer BYTES   Buffer size for recv/trunc (default %d)\n", RECV_BUFFER_SIZE);
+    fprintf(stderr, "  -f, --schema SPEC         Field layout for readv, same as the server's (default uniform:8)\n");
+    fprintf(stderr, "      --deserialize MODE    Decode framed messages (-f framed:SPEC): view or naive\n");
+    fprintf(stderr, "  -W, --workers N           Hand messages to N worker threads over lock-free queues\n");
+    fprintf(stderr, "      --queue KIND          Worker handoff: mpmc (one shared queue) or spsc (per pair)\n");
+    fprintf(stderr, "      --work-ns NS          Synthetic work per message in a worker (default %d)\n", PIPELINE_DEFAULT_WORK_NS);
+    fprintf(stderr, "      --queue-depth N       Queue and arena slots per receive thread (default %d)\n", PIPELINE_DEFAULT_DEPTH);
+    fprintf(stderr, "  -c, --verify              Verify the CRC32C trailer of every message (server -c)\n");
+    fprintf(stderr, "  -D, --duplex              Also stream messages to the server (full duplex)\n");
+    fprintf(stderr, "      --tx-strategy S       Duplex send strategy: copy, sendmsg or zerocopy (default %s)\n",
+            tx_strategy_name(TX_STRATEGY_SENDMSG));
+    fprintf(stderr, "      --tls                 Decrypt with kernel TLS, AES-GCM-128 test keys (server --tls)\n");
+    fprintf(stderr, "  -I, --tcp-info FILE       Sample TCP_INFO of every connection into a CSV time series\n");
+    fprintf(stderr, "      --tcp-info-ms MS      TCP_INFO sampling interval (default %d)\n", TCPINFO_DEFAULT_INTERVAL_MS);
+    fprintf(stderr, "      --metrics PATH        Serve live counters on a Unix socket (Prometheus text or JSON)\n");
+    fprintf(stderr, "      --lean                Small receive thread stacks\n");
+    fprintf(stderr, "      --coro THREADS        Run the sessions as coroutines on THREADS threads (epoll)\n");
+    fprintf(stderr, "      --coro-stack KB       Stack per coroutine session (default %d)\n", CORO_DEFAULT_STACK / 1024);
+    fprintf(stderr, "  -T, --trace FILE          Record hot-path events to FILE (see MT25043_Part_D_Trace.py)\n");
+}
 
 int main(int argc, char const *argv[]) {
-    if (argc != 5) {
-        fprintf(stderr, "Usage: %s <server_ip> <thread_count> <message_size> <duration_in_seconds>\n", argv[0]);
+    recv_mode_t recv_mode = RECV_MODE_RECV;
+    int recv_buf_size = RECV_BUFFER_SIZE;
+    int verify = 0;
+    int duplex = 0;
+    int tls = 0;
+    deser_mode_t deser_mode = DESER_NONE;
+    int workers = 0;
+    pipeline_queue_t queue_kind = PIPELINE_MPMC;
+    long work_ns = PIPELINE_DEFAULT_WORK_NS;
+    int queue_depth = PIPELINE_DEFAULT_DEPTH;
+    tx_strategy_t tx_strategy = TX_STRATEGY_SENDMSG;
+    const char* schema_spec = "uniform:8";
+    const char* trace_path = NULL;
+    const char* tcp_info_path = NULL;
+    int tcp_info_ms = TCPINFO_DEFAULT_INTERVAL_MS;
+    const char* metrics_path = NULL;
+    int lean = 0;
+    int coro_threads = 0;
+    int coro_stack = CORO_DEFAULT_STACK;
+    schema_t schema;
+
+    static const struct option long_options[] = {
+        { "recv-mode",   required_argument, NULL, 'r' },
+        { "recv-buffer", required_argument, NULL, 'b' },
+        { "verify",      no_argument,       NULL, 'c' },
+        { "schema",      required_argument, NULL, 'f' },
+        { "deserialize", required_argument, NULL, 'Z' },
+        { "workers",     required_argument, NULL, 'W' },
+        { "queue",       required_argument, NULL, 'Q' },
+        { "work-ns",     required_argument, NULL, 'K' },
+        { "queue-depth", required_argument, NULL, 'H' },
+        { "duplex",      no_argument,       NULL, 'D' },
+        { "tx-strategy", required_argument, NULL, 'S' },
+        { "metrics",     required_argument, NULL, 'X' },
+        { "tls",         no_argument,       NULL, 'L' },
+        { "tcp-info",    required_argument, NULL, 'I' },
+        { "tcp-info-ms", required_argument, NULL, 'M' },
+        { "trace",       required_argument, NULL, 'T' },
+        { "lean",        no_argument,       NULL, 'G' },
+        { "coro",        required_argument, NULL, 'O' },
+        { "coro-stack",  required_argument, NULL, 'J' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, (char* const*)argv, "r:b:cf:T:I:DW:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'r':
+            if (parse_recv_mode(optarg, &recv_mode) < 0) {
+                fprintf(stderr, "Unknown receive strategy '%s' (expected recv, waitall, readv or trunc)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'b':
+            recv_buf_size = atoi(optarg);
+            break;
+        case 'c':
+            verify = 1;
+            break;
+        case 'f':
+            schema_spec = optarg;
+            break;
+        case 'Z':
+            if (parse_deser_mode(optarg, &deser_mode) < 0) {
+                fprintf(stderr, "Unknown deserializer '%s' (expected view or naive)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'W':
+            workers = atoi(optarg);
+            break;
+        case 'Q':
+            if (parse_pipeline_queue(optarg, &queue_kind) < 0) {
+                fprintf(stderr, "Unknown queue '%s' (expected mpmc or spsc)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'K':
+            work_ns = atol(optarg);
+            break;
+        case 'H':
+            queue_depth = atoi(optarg);
+            break;
+        case 'T':
+            trace_path = optarg;
+            break;
+        case 'D':
+            duplex = 1;
+            break;
+        case 'L':
+            tls = 1;
+            break;
+        case 'S':
+            if (parse_tx_strategy(optarg, &tx_strategy) < 0) {
+                fprintf(stderr, "Unknown send strategy '%s' (expected copy, sendmsg or zerocopy)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'I':
+            tcp_info_path = optarg;
+            break;
+        case 'M':
+            tcp_info_ms = atoi(optarg);
+            break;
+        case 'X':
+            metrics_path = optarg;
+            break;
+        case 'G':
+            lean = 1;
+            break;
+        case 'O':
+            coro_threads = atoi(optarg);
+            break;
+        case 'J':
+            coro_stack = atoi(optarg) * 1024;
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind != 4) {
+        print_usage(argv[0]);
         return 1;
     }
 
-    const char* server_ip = argv[1];
-    int thread_count = atoi(argv[2]);
-    int msg_size = atoi(argv[3]);
-    int duration = atoi(argv[4]);
+    const char* server_ip = argv[optind];
+    int thread_count = atoi(argv[optind + 1]);
+    int msg_size = atoi(argv[optind + 2]);
+    int duration = atoi(argv[optind + 3]);
 
     if (thread_count <= 0 || msg_size <= 0 || duration <= 0) {
         fprintf(stderr, "Invalid arguments. All values must be positive integers.\n");
         return 1;
     }
-    if (msg_size % NUM_FIELDS != 0) {
-        fprintf(stderr, "Message size (%d) must be divisible by NUM_FIELDS (%d) for this implementation.\n", msg_size, NUM_FIELDS);
+    if (recv_mode_check(recv_buf_size) < 0) {
+        return 1;
+    }
+    if (schema_parse(&schema, schema_spec, (size_t)msg_size) < 0) {
+        return 1;
+    }
+    if (verify && recv_mode == RECV_MODE_TRUNC) {
+        fprintf(stderr, "--verify needs the data: use recv, waitall or readv\n");
+        return 1;
+    }
+    if (deser_mode != DESER_NONE && (!schema.framed || recv_mode == RECV_MODE_READV || recv_mode == RECV_MODE_TRUNC)) {
+        fprintf(stderr, "--deserialize needs a framed schema (-f framed:SPEC) and recv or waitall\n");
+        return 1;
+    }
+    if (workers < 0 || work_ns < 0 || queue_depth <= 0) {
+        fprintf(stderr, "--workers, --work-ns and --queue-depth must not be negative\n");
+        return 1;
+    }
+    if (workers > 0 && recv_mode == RECV_MODE_TRUNC) {
+        fprintf(stderr, "--workers needs the data: use recv, waitall or readv\n");
+        return 1;
+    }
+    if (coro_threads < 0 || coro_stack < 16 * 1024) {
+        fprintf(stderr, "--coro must not be negative and --coro-stack at least 16 KB\n");
+        return 1;
+    }
+    if (coro_threads > 0 && duplex) {
+        fprintf(stderr, "--coro sessions cannot --duplex: its sender thread would block the scheduler\n");
+        return 1;
+    }
+    if (coro_threads > thread_count) {
+        coro_threads = thread_count;
+    }
+    // Every coroutine session has its own ring: keep their total bounded
+    if (trace_path && trace_init(trace_path, argv[0], coro_threads > 0 ? trace_session_events(thread_count) : 0) < 0) {
+        return 1;
+    }
+    if (tcp_info_path && tcpinfo_start(tcp_info_path, argv[0], tcp_info_ms) < 0) {
+        return 1;
+    }
+    if (metrics_path && metrics_start(metrics_path, argv[0]) < 0) {
         return 1;
     }
 
-    printf("Starting %d client receiver threads...\n", thread_count);
+    // A server that closes first ends the duplex TX direction, not the client
+    signal(SIGPIPE, SIG_IGN);
+    meta_report(argv[0], duplex && tx_strategy == TX_STRATEGY_ZEROCOPY);
+    if (coro_threads > 0) {
+        coro_reserve_fds(thread_count);
+        printf("Starting %d client sessions as coroutines on %d threads...\n", thread_count, coro_threads);
+    } else {
+        printf("Starting %d client receiver threads...\n", thread_count);
+    }
     
     pthread_t* threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
     client_thread_args_t* thread_args = (client_thread_args_t*)malloc(thread_count * sizeof(client_thread_args_t));
     long total_bytes_received = 0;
     long total_latency_us = 0;
     long total_recvs = 0;
+    long total_verified = 0;
+    long total_verify_errors = 0;
+    long total_verify_ns = 0;
+    long total_deser_msgs = 0;
+    long total_deser_split = 0;
+    long total_deser_errors = 0;
+    long total_deser_ns = 0;
+    long total_tx_bytes = 0;
+    long total_tx_sends = 0;
+    long total_tx_ns = 0;
+
+    // Pipeline mode: every receive thread feeds the worker pool
+    pipeline_t* pipeline = NULL;
+    if (workers > 0) {
+        pipeline = pipeline_create(queue_kind, thread_count, workers, (size_t)queue_depth,
+                                   schema.total + (verify ? CRC32C_TRAILER_SIZE : 0), work_ns);
+        if (!pipeline) {
+            return 1;
+        }
+    }
+
+    // Receive (or scheduler) threads, with small stacks in lean mode; memory
+    // is accounted from here
+    pthread_attr_t thread_attr;
+    size_t stack_size = mem_thread_attr(&thread_attr, lean);
+    coro_sched_t* scheds = NULL;
+    if (coro_threads > 0) {
+        scheds = coro_create(coro_threads, thread_count, (size_t)coro_stack);
+        if (!scheds) {
+            return 1;
+        }
+        stack_size = (size_t)coro_stack;
+    }
+    if (mem_start("", 0, stack_size) < 0) {
+        return 1;
+    }
 
     struct timeval start_test, end_test;
     gettimeofday(&start_test, NULL);
@@ -167,20 +536,67 @@ int main(int argc, char const *argv[]) {
         thread_args[i].server_ip = server_ip;
         thread_args[i].msg_size = msg_size;
         thread_args[i].duration = duration;
+        thread_args[i].recv_mode = recv_mode;
+        thread_args[i].recv_buf_size = recv_buf_size;
+        thread_args[i].verify = verify;
+        thread_args[i].schema = &schema;
         thread_args[i].total_bytes_received = &total_bytes_received;
         thread_args[i].total_latency_us = &total_latency_us;
         thread_args[i].total_recvs = &total_recvs;
+        thread_args[i].total_verified = &total_verified;
+        thread_args[i].total_verify_errors = &total_verify_errors;
+        thread_args[i].total_verify_ns = &total_verify_ns;
+        thread_args[i].deser_mode = deser_mode;
+        thread_args[i].total_deser_msgs = &total_deser_msgs;
+        thread_args[i].total_deser_split = &total_deser_split;
+        thread_args[i].total_deser_errors = &total_deser_errors;
+        thread_args[i].total_deser_ns = &total_deser_ns;
+        thread_args[i].duplex = duplex;
+        thread_args[i].tls = tls;
+        thread_args[i].tx_strategy = tx_strategy;
+        thread_args[i].total_tx_bytes = &total_tx_bytes;
+        thread_args[i].total_tx_sends = &total_tx_sends;
+        thread_args[i].total_tx_ns = &total_tx_ns;
+        thread_args[i].pipeline = pipeline;
+        hist_init(&thread_args[i].latency_hist);
+        hist_init(&thread_args[i].message_latency);
+        arrival_init(&thread_args[i].arrivals);
 
-        if (pthread_create(&threads[i], NULL, run_client, &thread_args[i]) != 0) {
+        if (scheds) {
+            if (coro_spawn(&scheds[i % coro_threads], run_client, &thread_args[i]) < 0) {
+                return 1;
+            }
+        } else if (pthread_create(&threads[i], &thread_attr, run_client, &thread_args[i]) != 0) {
             perror("Failed to create thread");
         }
     }
+    if (scheds && coro_start(scheds, coro_threads, &thread_attr) < 0) {
+        return 1;
+    }
 
+    // Latency and arrival histograms were recorded per thread
+    hist_t latency_hist;
+    hist_t message_latency;
+    arrival_t arrivals;
+    hist_init(&latency_hist);
+    hist_init(&message_latency);
+    arrival_init(&arrivals);
+    if (scheds) {
+        coro_join(scheds, coro_threads);
+    }
     for (int i = 0; i < thread_count; i++) {
-        pthread_join(threads[i], NULL);
+        if (!scheds) {
+            pthread_join(threads[i], NULL);
+        }
+        hist_merge(&latency_hist, &thread_args[i].latency_hist);
+        hist_merge(&message_latency, &thread_args[i].message_latency);
+        arrival_merge(&arrivals, &thread_args[i].arrivals);
     }
     
     gettimeofday(&end_test, NULL);
+    if (pipeline) {
+        pipeline_finish(pipeline);
+    }
 
     double elapsed_sec = (end_test.tv_sec - start_test.tv_sec) + 
                          (end_test.tv_usec - start_test.tv_usec) / 1000000.0;
@@ -195,12 +611,74 @@ int main(int argc, char const *argv[]) {
     if (total_recvs > 0) {
         avg_latency_us = (double)total_latency_us / total_recvs;
     }
+
+    // Receive-side syscall efficiency, independent of the sender's strategy
+    int frame_size = (int)schema.total + (verify ? CRC32C_TRAILER_SIZE : 0);
+    double messages_received = (double)total_bytes_received / frame_size;
+    double recvs_per_message = 0.0;
+    double bytes_per_syscall = 0.0;
+    if (messages_received > 0.0) {
+        recvs_per_message = total_recvs / messages_received;
+    }
+    if (total_recvs > 0) {
+        bytes_per_syscall = (double)total_bytes_received / total_recvs;
+    }
     
     printf("\nTest complete.\n");
     printf("Total bytes received: %ld\n", total_bytes_received);
     printf("Test Duration (Actual): %.6f seconds\n", elapsed_sec);
     printf("Throughput: %.6f Gbps\n", throughput_gbps);
     printf("Average Latency: %.6f us\n", avg_latency_us);
+    printf("P50 Latency: %.6f us\n", hist_percentile(&latency_hist, 0.50) / 1000.0);
+    printf("P99 Latency: %.6f us\n", hist_percentile(&latency_hist, 0.99) / 1000.0);
+    printf("P99.9 Latency: %.6f us\n", hist_percentile(&latency_hist, 0.999) / 1000.0);
+    printf("Max Latency: %.6f us\n", latency_hist.max / 1000.0);
+    printf("Message Interarrival: %.6f us (p99 %.6f us)\n", hist_mean(&arrivals.gaps) / 1000.0,
+           hist_percentile(&arrivals.gaps, 0.99) / 1000.0);
+    printf("Interarrival Jitter: %.6f us\n", arrival_jitter(&arrivals) / 1000.0);
+    if (tls) {
+        printf("Encryption: kTLS (TLS 1.2 AES-GCM-128)\n");
+    }
+    printf("Receive Strategy: %s (buffer %d bytes)\n", recv_mode_name(recv_mode),
+           (recv_mode == RECV_MODE_WAITALL || recv_mode == RECV_MODE_READV) ? (int)schema.total : recv_buf_size);
+    printf("Recvs per Message: %.6f\n", recvs_per_message);
+    printf("Bytes per Syscall: %.6f\n", bytes_per_syscall);
+    if (verify) {
+        // The cost of touching the data, reported on its own line
+        double verify_ns_per_msg = total_verified + total_verify_errors > 0
+            ? (double)total_verify_ns / (total_verified + total_verify_errors) : 0.0;
+        printf("Checksum: %ld messages verified, %ld errors\n", total_verified, total_verify_errors);
+        printf("Verify Cost: %.6f us per message (%.6f GB/s)\n", verify_ns_per_msg / 1000.0,
+               total_verify_ns > 0 ? (double)total_bytes_received / total_verify_ns : 0.0);
+    }
+    if (deser_mode != DESER_NONE) {
+        printf("Deserialize: %s, %ld messages, %ld split across recvs, %ld errors\n", deser_mode_name(deser_mode),
+               total_deser_msgs, total_deser_split, total_deser_errors);
+        printf("Deserialize Cost: %.6f us per message\n",
+               total_deser_msgs > 0 ? total_deser_ns / 1000.0 / total_deser_msgs : 0.0);
+    }
+    if (message_latency.count > 0) {
+        // Stamped frames (server --replay): one-way latency from send to decode
+        printf("Message Latency: avg %.6f us, p50 %.6f us, p99 %.6f us, p99.9 %.6f us, max %.6f us (%llu messages)\n",
+               hist_mean(&message_latency) / 1000.0, hist_percentile(&message_latency, 0.50) / 1000.0,
+               hist_percentile(&message_latency, 0.99) / 1000.0, hist_percentile(&message_latency, 0.999) / 1000.0,
+               message_latency.max / 1000.0, (unsigned long long)message_latency.count);
+    }
+    if (duplex) {
+        // The reverse direction, measured the same way as the lines above
+        printf("TX Strategy: %s\n", tx_strategy_name(tx_strategy));
+        printf("TX Throughput: %.6f Gbps\n", elapsed_sec > 0.000001 ? total_tx_bytes * 8.0 / elapsed_sec / 1e9 : 0.0);
+        printf("TX Average Latency: %.6f us\n", total_tx_sends > 0 ? total_tx_ns / 1000.0 / total_tx_sends : 0.0);
+    }
+    mem_report();
+    if (scheds) {
+        coro_report(scheds, coro_threads);
+        coro_destroy(scheds, coro_threads);
+    }
+    if (pipeline) {
+        pipeline_report(pipeline);
+        pipeline_destroy(pipeline);
+    }
     
     free(threads);
     free(thread_args);
@@ -32,48 +32,90 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <signal.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <getopt.h>
 #include <sys/uio.h> // For struct iovec
 
+#include "MT25043_Message.h"
+#include "MT25043_Payload.h"
+#include "MT25043_Batch.h"
+#include "MT25043_Trace.h"
+#include "MT25043_TcpInfo.h"
+#include "MT25043_Duplex.h"
+#include "MT25043_Pacing.h"
+#include "MT25043_Tls.h"
+#include "MT25043_Publish.h"
+#include "MT25043_Meta.h"
+#include "MT25043_Metrics.h"
+#include "MT25043_Memory.h"
+#include "MT25043_Replay.h"
+
 #define PORT 8080
-#define NUM_FIELDS 8
 
 // Global parameters set from command line
 static int g_msg_size = 8192;
 static int g_duration = 10;
 
-// The message structure with 8 dynamically allocated string fields.
-typedef struct {
-    char* field[NUM_FIELDS];
-} message_t;
+// Message layout: field count and sizes (see MT25043_Message.h)
+static const char* g_schema_spec = "uniform:8";
+static schema_t g_schema;
 
-message_t* create_message(int field_size) {
-    message_t* msg = (message_t*)malloc(sizeof(message_t));
-    if (!msg) {
-        perror("Failed to allocate message struct");
-        return NULL;
-    }
-    for (int i = 0; i < NUM_FIELDS; i++) {
-        msg->field[i] = (char*)malloc(field_size);
-        if (!msg->field[i]) {
-            perror("Failed to allocate message field");
-            for (int j = 0; j < i; j++) free(msg->field[j]);
-            free(msg);
-            return NULL;
-        }
-        memset(msg->field[i], 'A' + i, field_size);
-    }
-    return msg;
-}
+// Payload options: how message contents change between sends
+static payload_mode_t g_payload_mode = PAYLOAD_STATIC;
+static size_t g_pool_bytes = 0;
+static payload_pool_t g_payload_pool;
 
-void free_message(message_t* msg) {
-    if (msg) {
-        for (int i = 0; i < NUM_FIELDS; i++) {
-            if (msg->field[i]) free(msg->field[i]);
-        }
-        free(msg);
+// Checksum mode: append a CRC32C of the fields after every message
+static int g_checksum = 0;
+
+// Hot-path event trace output (see MT25043_Trace.h)
+static const char* g_trace_path = NULL;
+
+// TCP_INFO time series output and interval (see MT25043_TcpInfo.h)
+static const char* g_tcp_info_path = NULL;
+static int g_tcp_info_ms = TCPINFO_DEFAULT_INTERVAL_MS;
+
+// Live metrics endpoint on a Unix socket (see MT25043_Metrics.h)
+static const char* g_metrics_path = NULL;
+
+// Lean mode: small connection stacks, one shared static message (see MT25043_Memory.h)
+static int g_lean = 0;
+
+// Per-connection pacing rate in bits/s (0 = unpaced, see MT25043_Pacing.h)
+static uint64_t g_pacing_rate = 0;
+static pacing_mode_t g_pacing_mode = PACING_MAXRATE;
+
+// kTLS mode: encrypt the stream with fixed test keys (see MT25043_Tls.h)
+static int g_tls = 0;
+
+// Batching: messages per sendmsg() (0 = adapt to the send-queue depth)
+static int g_batch = 1;
+static size_t g_batch_bytes = 0;
+
+// Publish mode: producer threads build messages into a buffer pool and the
+// connection thread only sends them (0 = off, see MT25043_Publish.h)
+static int g_producers = 0;
+static int g_publish_buffers = PUBLISH_DEFAULT_BUFFERS;
+
+// Workload replay: a recorded trace replaces the fixed-size send loop (see MT25043_Replay.h)
+static const char* g_replay_path = NULL;
+static replay_trace_t g_replay;
+
+// Sends the trace's messages at their recorded gaps until the duration ends
+static void replay_connection(int client_socket) {
+    replayer_t replayer;
+    if (replayer_init(&replayer, &g_replay, client_socket, TX_STRATEGY_SENDMSG) < 0) {
+        return;
+    }
+    long start_ns = replay_now_ns();
+    long deadline_ns = start_ns + g_duration * 1000000000L;
+    while (replayer_send_next(&replayer, deadline_ns) > 0) {
+        // Each call waits for its message's send time
     }
+    replayer_report(&replayer, client_socket, (replay_now_ns() - start_ns) / 1e9);
+    replayer_destroy(&replayer);
 }
 
 void* handle_client(void* args) {
@@ -96,63 +138,319 @@ void* handle_client(void* args) {
         return NULL;
     }
 
+    trace_thread_start(client_socket);
+    tcpinfo_register(client_socket);
+    mem_register(client_socket);
+
+    pacing_t pacing;
+    if (pacing_init(&pacing, client_socket, g_pacing_mode, g_pacing_rate) < 0) {
+        goto unregister;
+    }
+
+    // The handshake stays plaintext; with --tls everything after it is encrypted
+    ktls_session_t tls;
+    if (ktls_server_start(&tls, client_socket, g_tls, ready_signal == DUPLEX_READY_SIGNAL) < 0) {
+        goto unregister;
+    }
+
     // Prepare message for sending (One-Copy method with sendmsg)
-    int field_size = g_msg_size / NUM_FIELDS;
-    message_t* msg = create_message(field_size);
-    if (!msg) {
-        close(client_socket);
-        return NULL;
+    payload_t payload;
+    if (payload_init(&payload, g_payload_mode, &g_schema, &g_payload_pool, (uint64_t)client_socket, g_checksum) < 0) {
+        goto unregister;
     }
 
-    struct iovec iov[NUM_FIELDS];
-    for (int i = 0; i < NUM_FIELDS; i++) {
-        iov[i].iov_base = msg->field[i];
-        iov[i].iov_len = field_size;
+    // One iovec per schema field (plus the checksum trailer) for each of the
+    // K messages batched into a single sendmsg()
+    batcher_t batcher;
+    if (batcher_init(&batcher, client_socket, g_batch, g_batch_bytes, &payload) < 0) {
+        payload_destroy(&payload);
+        goto unregister;
     }
 
     struct msghdr msg_hdr;
     memset(&msg_hdr, 0, sizeof(msg_hdr));
-    msg_hdr.msg_iov = iov;
-    msg_hdr.msg_iovlen = NUM_FIELDS;
 
-    // Send messages repeatedly for the specified duration
-    struct timeval start_time, current_time;
-    gettimeofday(&start_time, NULL);
+    // Publish mode: producers fill the buffer pool, this thread drains it
+    publisher_t publisher;
+    int publishing = g_producers > 0;
+    if (publishing && publisher_start(&publisher, client_socket, &g_schema, g_payload_mode, &g_payload_pool, g_checksum,
+                                      g_producers, g_publish_buffers, g_batch, g_batch_bytes, 0) < 0) {
+        publisher_stop(&publisher);
+        publisher_destroy(&publisher);
+        batcher_destroy(&batcher);
+        payload_destroy(&payload);
+        goto unregister;
+    }
 
-    while (1) {
-        gettimeofday(&current_time, NULL);
-        if (current_time.tv_sec - start_time.tv_sec >= g_duration) {
-            break;
-        }
+    // Full-duplex mode: receive the client's stream on a second thread
+    duplex_rx_t duplex_rx;
+    memset(&duplex_rx, 0, sizeof(duplex_rx));
+    if (ready_signal == DUPLEX_READY_SIGNAL) {
+        duplex_rx_start(&duplex_rx, client_socket, g_schema.total, g_checksum);
+    }
 
-        ssize_t bytes_sent = sendmsg(client_socket, &msg_hdr, 0);
-        if (bytes_sent <= 0) {
-            // Client disconnected or send failed
-            break;
+    metrics_thread_start();
+    if (g_replay_path) {
+        replay_connection(client_socket);
+    } else {
+        // Send messages repeatedly for the specified duration
+        struct timeval start_time, current_time;
+        gettimeofday(&start_time, NULL);
+
+        while (1) {
+            trace_event(TRACE_CLOCK_BEGIN, 0);
+            gettimeofday(&current_time, NULL);
+            trace_event(TRACE_CLOCK_END, 0);
+            if (current_time.tv_sec - start_time.tv_sec >= g_duration) {
+                break;
+            }
+
+            trace_event(TRACE_FILL_BEGIN, 0);
+            int batch_msgs = publishing ? publisher_collect(&publisher, &msg_hdr)
+                                        : batcher_fill(&batcher, &payload, &msg_hdr);
+            trace_event(TRACE_FILL_END, (uint64_t)batch_msgs);
+            pacing_wait(&pacing);
+            uint64_t send_start = metrics_clock();
+            trace_event(TRACE_SEND_BEGIN, 0);
+            ssize_t bytes_sent = publishing ? publisher_send(&publisher, &msg_hdr) : sendmsg(client_socket, &msg_hdr, 0);
+            trace_event(TRACE_SEND_END, bytes_sent > 0 ? (uint64_t)bytes_sent : 0);
+            if (bytes_sent <= 0) {
+                // Client disconnected or send failed
+                break;
+            }
+            pacing_sent(&pacing, (size_t)bytes_sent);
+            metrics_tx((size_t)bytes_sent, send_start);
+            if (!publishing) {
+                batcher_sent(&batcher, batch_msgs);
+            }
         }
     }
 
-    free_message(msg);
+    if (publishing) {
+        publisher_stop(&publisher);
+        publisher_report(&publisher, client_socket);
+        publisher_destroy(&publisher);
+    }
+    batcher_report(&batcher, client_socket);
+    payload_report(&payload, client_socket);
+    batcher_destroy(&batcher);
+    payload_destroy(&payload);
+    ktls_session_report(&tls, client_socket);
+    pacing_report(&pacing, client_socket);
+    duplex_rx_stop(&duplex_rx, client_socket);
+    metrics_thread_stop();
     printf("Server: Client disconnected. Closing socket %d.\n", client_socket);
+
+unregister:
+    // Every path after tcpinfo_register() leaves through here
+    tcpinfo_unregister(client_socket);
+    mem_unregister(client_socket);
     close(client_socket);
     return NULL;
 }
 
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options] [message_size] [duration_in_seconds]\n", prog);
+    fprintf(stderr, "  -p, --payload MODE          static (default), counter, random or pool\n");
+    fprintf(stderr, "  -c, --checksum              Append a CRC32C trailer to every message (client -c)\n");
+    fprintf(stderr, "  -f, --schema SPEC           uniform:N (default uniform:8), skewed:N or file:PATH\n");
+    fprintf(stderr, "  -B, --batch K|auto          Messages per sendmsg(), up to IOV_MAX iovecs (default 1)\n");
+    fprintf(stderr, "      --batch-bytes BYTES     Byte budget per batch (default: IOV_MAX only)\n");
+    fprintf(stderr, "      --producers N           Publish mode: N threads build messages, this one only sends\n");
+    fprintf(stderr, "      --publish-buffers N     Message buffers per connection in publish mode (default %d)\n", PUBLISH_DEFAULT_BUFFERS);
+    fprintf(stderr, "  -I, --tcp-info FILE         Sample TCP_INFO of every connection into a CSV time series\n");
+    fprintf(stderr, "      --tcp-info-ms MS        TCP_INFO sampling interval (default %d)\n", TCPINFO_DEFAULT_INTERVAL_MS);
+    fprintf(stderr, "      --metrics PATH          Serve live counters on a Unix socket (Prometheus text or JSON)\n");
+    fprintf(stderr, "      --lean                  Small connection stacks and one shared static message\n");
+    fprintf(stderr, "  -T, --trace FILE            Record hot-path events to FILE (see MT25043_Part_D_Trace.py)\n");
+    fprintf(stderr, "  -r, --rate RATE             Pace every connection at RATE bits/s (k/m/g suffix)\n");
+    fprintf(stderr, "      --pacing MODE           maxrate (SO_MAX_PACING_RATE, default) or txtime (timed sends)\n");
+    fprintf(stderr, "      --replay FILE           Send a recorded workload trace (see MT25043_Part_D_Workload.py)\n");
+    fprintf(stderr, "      --tls                   Encrypt with kernel TLS, AES-GCM-128 test keys (client --tls)\n");
+    fprintf(stderr, "      --pool-mb MB            Pool size for -p pool (default %d x LLC, at least 64)\n", PAYLOAD_POOL_LLC_FACTOR);
+}
+
 int main(int argc, char const *argv[]) {
-    // Parse command-line arguments
-    if (argc >= 2) {
-        g_msg_size = atoi(argv[1]);
+    // Line-buffer stdout so per-connection reports survive the harness kill
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    // A client that hangs up mid-send ends its connection, not the server
+    signal(SIGPIPE, SIG_IGN);
+
+    static const struct option long_options[] = {
+        { "payload",         required_argument, NULL, 'p' },
+        { "checksum",        no_argument,       NULL, 'c' },
+        { "schema",          required_argument, NULL, 'f' },
+        { "pool-mb",         required_argument, NULL, 'P' },
+        { "batch",           required_argument, NULL, 'B' },
+        { "batch-bytes",     required_argument, NULL, 'Y' },
+        { "producers",       required_argument, NULL, 'U' },
+        { "publish-buffers", required_argument, NULL, 'H' },
+        { "tcp-info",        required_argument, NULL, 'I' },
+        { "tcp-info-ms",     required_argument, NULL, 'M' },
+        { "trace",           required_argument, NULL, 'T' },
+        { "rate",            required_argument, NULL, 'r' },
+        { "pacing",          required_argument, NULL, 'E' },
+        { "replay",          required_argument, NULL, 'W' },
+        { "metrics",         required_argument, NULL, 'X' },
+        { "tls",             no_argument,       NULL, 'L' },
+        { "lean",            no_argument,       NULL, 'G' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    // Parse command-line options, then the positional arguments
+    int option;
+    int batch_given = 0;
+    while ((option = getopt_long(argc, (char* const*)argv, "p:cf:B:T:I:r:", long_options, NULL)) != -1) {
+        switch (option) {
+        case 'p':
+            if (parse_payload_mode(optarg, &g_payload_mode) < 0) {
+                fprintf(stderr, "Unknown payload mode '%s' (expected static, counter, random or pool)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'c':
+            g_checksum = 1;
+            break;
+        case 'f':
+            g_schema_spec = optarg;
+            break;
+        case 'B':
+            g_batch = strcmp(optarg, "auto") == 0 ? 0 : atoi(optarg);
+            batch_given = 1;
+            if (g_batch < 0) {
+                fprintf(stderr, "Batch size must be a positive count or 'auto'\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'Y':
+            g_batch_bytes = (size_t)atol(optarg);
+            break;
+        case 'U':
+            g_producers = atoi(optarg);
+            if (g_producers < 0) {
+                fprintf(stderr, "Producer count must not be negative\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'H':
+            g_publish_buffers = atoi(optarg);
+            if (g_publish_buffers <= 0) {
+                fprintf(stderr, "Publish buffer count must be positive\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'P':
+            g_pool_bytes = (size_t)atol(optarg) * 1024 * 1024;
+            break;
+        case 'T':
+            g_trace_path = optarg;
+            break;
+        case 'I':
+            g_tcp_info_path = optarg;
+            break;
+        case 'M':
+            g_tcp_info_ms = atoi(optarg);
+            break;
+        case 'X':
+            g_metrics_path = optarg;
+            break;
+        case 'G':
+            g_lean = 1;
+            break;
+        case 'r':
+            if (parse_rate(optarg, &g_pacing_rate) < 0) {
+                fprintf(stderr, "Invalid pacing rate '%s' (e.g. 500m or 2g bits/s)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'E':
+            if (parse_pacing_mode(optarg, &g_pacing_mode) < 0) {
+                fprintf(stderr, "Unknown pacing mode '%s' (expected maxrate or txtime)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'L':
+            g_tls = 1;
+            break;
+        case 'W':
+            g_replay_path = optarg;
+            break;
+        default:
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc - optind >= 1) {
+        g_msg_size = atoi(argv[optind]);
     }
-    if (argc >= 3) {
-        g_duration = atoi(argv[2]);
+    if (argc - optind >= 2) {
+        g_duration = atoi(argv[optind + 1]);
     }
 
-    if (g_msg_size % NUM_FIELDS != 0) {
-        fprintf(stderr, "Message size (%d) must be divisible by NUM_FIELDS (%d)\n", g_msg_size, NUM_FIELDS);
+    if (g_msg_size <= 0 || schema_parse(&g_schema, g_schema_spec, (size_t)g_msg_size) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_replay_path && (g_pacing_rate > 0 || g_checksum || g_payload_mode != PAYLOAD_STATIC || g_batch != 1 || g_producers > 0)) {
+        fprintf(stderr, "--replay sends the trace's own sizes and gaps; drop -r, -c, -p, -B or --producers\n");
         exit(EXIT_FAILURE);
     }
 
     printf("Server configured: msg_size=%d bytes, duration=%d seconds\n", g_msg_size, g_duration);
+    meta_report(argv[0], 0);
+    if (g_replay_path) {
+        if (replay_load(&g_replay, g_replay_path) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        replay_print(&g_replay, g_replay_path);
+        printf("Server replay: decode with client -f framed:uniform:1 --deserialize view and message_size >= %zu\n",
+               g_replay.largest);
+    }
+    schema_print(&g_schema, "Server schema");
+
+    if (g_payload_mode == PAYLOAD_POOL) {
+        if (g_pool_bytes == 0) {
+            g_pool_bytes = payload_default_pool_bytes();
+        }
+        if (payload_pool_build(&g_payload_pool, &g_schema, g_pool_bytes) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        printf("Server payload: pool of %d messages (%zu MB)\n", g_payload_pool.count,
+               (size_t)g_payload_pool.count * g_msg_size / (1024 * 1024));
+    } else {
+        printf("Server payload: %s\n", payload_mode_name(g_payload_mode));
+    }
+    if (g_lean && g_payload_mode == PAYLOAD_STATIC) {
+        // Every connection sends the same bytes: build them once, read-only
+        if (payload_shared_build(&g_payload_pool, &g_schema) < 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (g_checksum) {
+        printf("Server checksum: CRC32C trailer of %d bytes after every message\n", CRC32C_TRAILER_SIZE);
+    }
+    if (g_trace_path && trace_init(g_trace_path, argv[0], 0) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_tcp_info_path && tcpinfo_start(g_tcp_info_path, argv[0], g_tcp_info_ms) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_metrics_path && metrics_start(g_metrics_path, argv[0]) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_tls) {
+        printf("Server kTLS: TLS 1.2 AES-GCM-128 with fixed test keys\n");
+    }
+    if (g_producers > 0) {
+        // A writer drains whatever is queued unless -B caps the batch
+        if (!batch_given) {
+            g_batch = 0;
+        }
+        printf("Server publish: producers=%d, buffers=%d per connection\n", g_producers, g_publish_buffers);
+    }
+    if (g_pacing_rate > 0) {
+        printf("Server pacing: %.3f Mbit/s per connection (%s)\n", g_pacing_rate / 1e6, pacing_mode_name(g_pacing_mode));
+    }
 
     int server_fd;
     struct sockaddr_in address;
@@ -176,11 +474,22 @@ int main(int argc, char const *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    if (listen(server_fd, 10) < 0) {
+    if (listen(server_fd, SOMAXCONN) < 0) {
         perror("listen");
         exit(EXIT_FAILURE);
     }
 
+    // Connection threads, with small stacks in lean mode; memory is accounted from here
+    pthread_attr_t thread_attr;
+    size_t stack_size = mem_thread_attr(&thread_attr, g_lean);
+    if (mem_start("Server ", 1, stack_size) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_lean) {
+        printf("Server lean: %zu KB connection stacks, %s\n", stack_size / 1024,
+               g_payload_pool.count == 1 ? "one shared static message" : "per-connection messages");
+    }
+
     printf("Server (Receiver) listening on port %d...\n", PORT);
 
     while (1) {
@@ -194,7 +503,7 @@ int main(int argc, char const *argv[]) {
         printf("Server: New connection accepted. Socket fd is %d\n", *client_socket);
 
         pthread_t thread_id;
-        if (pthread_create(&thread_id, NULL, handle_client, (void*)client_socket) != 0) {
+        if (pthread_create(&thread_id, &thread_attr, handle_client, (void*)client_socket) != 0) {
             perror("pthread_create failed");
             close(*client_socket);
             free(client_socket);
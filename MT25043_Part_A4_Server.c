@@ -0,0 +1,627 @@
+// MT25043
+//
+// File: MT25043_Part_A4_Server.c (ROLE: SENDER)
+//
+// Description: Hybrid (Adaptive) TCP Server. For every connection and
+// message size class it measures the cost of the three send strategies
+// online and sends with whichever is currently cheapest:
+// - copy     : gather the fields into one buffer, then send()   (A1)
+// - sendmsg  : sendmsg() with one iovec per field              (A2)
+// - zerocopy : sendmsg() with MSG_ZEROCOPY                     (A3)
+//
+// Cost is wall time per byte of the send call; zero-copy sends are also
+// charged for draining their completion notifications. Completion latency
+// (send to notification) and the share of zero-copy sends the kernel fell
+// back to copying are tracked and reported. Every strategy is probed for
+// a short window at start and periodically afterwards, and the server
+// switches only when another strategy is clearly cheaper (hysteresis).
+// ============================================================================
+
+#define _GNU_SOURCE // Required for MSG_ZEROCOPY and SO_ZEROCOPY
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <time.h>
+#include <getopt.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+#include "MT25043_Message.h"
+#include "MT25043_Copy.h"
+#include "MT25043_Payload.h"
+#include "MT25043_Crc32c.h"
+#include "MT25043_Trace.h"
+#include "MT25043_TcpInfo.h"
+#include "MT25043_Duplex.h"
+#include "MT25043_Pacing.h"
+#include "MT25043_Tls.h"
+#include "MT25043_Meta.h"
+#include "MT25043_Metrics.h"
+#include "MT25043_Memory.h"
+
+#define PORT 8080
+
+#define PROBE_SENDS 64          // Sends per strategy in each probe window
+#define REPROBE_INTERVAL 8192   // Sends between probe windows
+#define COST_EWMA_SHIFT 4       // EWMA weight 1/16 for new samples
+#define SWITCH_HYSTERESIS 0.05  // Switch only if at least 5% cheaper
+#define SIZE_CLASSES 32         // log2 size buckets
+#define ZC_RING 4096            // Outstanding zero-copy send timestamps (optmem caps far fewer)
+
+typedef enum {
+    STRATEGY_COPY = 0,
+    STRATEGY_SENDMSG,
+    STRATEGY_ZEROCOPY,
+    NUM_STRATEGIES
+} strategy_t;
+
+static const char* const strategy_names[] = { "copy", "sendmsg", "zerocopy" };
+
+// Global parameters set from command line
+static int g_msg_size = 8192;
+static int g_duration = 10;
+
+// Message layout: field count and sizes (see MT25043_Message.h)
+static const char* g_schema_spec = "uniform:8";
+static schema_t g_schema;
+
+// Payload options: how message contents change between sends
+static payload_mode_t g_payload_mode = PAYLOAD_STATIC;
+static size_t g_pool_bytes = 0;
+static payload_pool_t g_payload_pool;
+
+// Checksum mode: append a CRC32C of the fields after every message
+static int g_checksum = 0;
+
+// Hot-path event trace output (see MT25043_Trace.h)
+static const char* g_trace_path = NULL;
+
+// TCP_INFO time series output and interval (see MT25043_TcpInfo.h)
+static const char* g_tcp_info_path = NULL;
+static int g_tcp_info_ms = TCPINFO_DEFAULT_INTERVAL_MS;
+
+// Live metrics endpoint on a Unix socket (see MT25043_Metrics.h)
+static const char* g_metrics_path = NULL;
+
+// Lean mode: small connection stacks, one shared static message (see MT25043_Memory.h)
+static int g_lean = 0;
+
+// Per-connection pacing rate in bits/s (0 = unpaced, see MT25043_Pacing.h)
+static uint64_t g_pacing_rate = 0;
+static pacing_mode_t g_pacing_mode = PACING_MAXRATE;
+
+// kTLS mode: encrypt the stream with fixed test keys (see MT25043_Tls.h)
+static int g_tls = 0;
+
+// Print every strategy switch as it happens
+static int g_verbose = 1;
+
+// Online cost model for one message size class of one connection.
+typedef struct {
+    double cost[NUM_STRATEGIES];    // EWMA nanoseconds per byte
+    long sends[NUM_STRATEGIES];
+    long total_sends;
+    strategy_t current;
+    int switches;
+} size_class_t;
+
+typedef struct {
+    int sock;
+    int zerocopy_ok;
+    size_class_t classes[SIZE_CLASSES];
+
+    // Zero-copy completion tracking
+    uint32_t zc_next_id;            // Kernel numbers MSG_ZEROCOPY sends from 0
+    long zc_send_ns[ZC_RING];
+    long zc_completed;
+    long zc_copied;
+    long zc_latency_ns;
+    long zc_timed;                  // Completions whose send time was still in the ring
+    long zc_drain_ns;               // Completion draining not yet charged to zero-copy
+} selector_t;
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static int size_class_of(size_t bytes) {
+    int c = 0;
+    while ((bytes >>= 1) != 0 && c < SIZE_CLASSES - 1) c++;
+    return c;
+}
+
+// Picks the strategy for the next send of a class: round-robin probe
+// windows at the start of every REPROBE_INTERVAL, the cheapest otherwise.
+static strategy_t selector_choose(selector_t* sel, size_class_t* cls) {
+    long phase = cls->total_sends % REPROBE_INTERVAL;
+    int strategies = sel->zerocopy_ok ? NUM_STRATEGIES : STRATEGY_ZEROCOPY;
+    if (phase < (long)strategies * PROBE_SENDS) {
+        return (strategy_t)(phase / PROBE_SENDS);
+    }
+    return cls->current;
+}
+
+static void selector_record(selector_t* sel, size_class_t* cls, int class_index,
+                            strategy_t s, long ns, size_t bytes) {
+    double sample = (double)ns / bytes;
+    if (cls->sends[s] == 0) {
+        cls->cost[s] = sample;
+    } else {
+        cls->cost[s] += (sample - cls->cost[s]) / (1 << COST_EWMA_SHIFT);
+    }
+    cls->sends[s]++;
+    cls->total_sends++;
+
+    // Re-decide once the probe window has produced fresh samples
+    int strategies = sel->zerocopy_ok ? NUM_STRATEGIES : STRATEGY_ZEROCOPY;
+    if (cls->total_sends % REPROBE_INTERVAL != (long)strategies * PROBE_SENDS) {
+        return;
+    }
+    strategy_t best = cls->current;
+    for (int i = 0; i < strategies; i++) {
+        if (cls->sends[i] > 0 && cls->cost[i] < cls->cost[best] * (1.0 - SWITCH_HYSTERESIS)) {
+            best = (strategy_t)i;
+        }
+    }
+    if (best != cls->current) {
+        if (g_verbose) {
+            printf("Server: Socket %d size ~%d bytes: %s -> %s (copy %.4f, sendmsg %.4f, zerocopy %.4f ns/B)\n",
+                   sel->sock, 1 << class_index, strategy_names[cls->current], strategy_names[best],
+                   cls->cost[STRATEGY_COPY], cls->cost[STRATEGY_SENDMSG],
+                   sel->zerocopy_ok ? cls->cost[STRATEGY_ZEROCOPY] : 0.0);
+        }
+        cls->current = best;
+        cls->switches++;
+    }
+}
+
+// Reads every pending zero-copy notification without blocking and records
+// completion latency and whether the kernel had to copy after all.
+static void selector_drain_completions(selector_t* sel) {
+    while (1) {
+        char cmsg_buf[CMSG_SPACE(sizeof(struct sock_extended_err))];
+        struct msghdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_control = cmsg_buf;
+        hdr.msg_controllen = sizeof(cmsg_buf);
+
+        if (recvmsg(sel->sock, &hdr, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return; // EAGAIN: queue empty
+        }
+        long now = now_ns();
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&hdr); cm; cm = CMSG_NXTHDR(&hdr, cm)) {
+            struct sock_extended_err* serr = (struct sock_extended_err*)CMSG_DATA(cm);
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            // [ee_info, ee_data] is an inclusive range of completed send ids
+            uint32_t count = serr->ee_data - serr->ee_info + 1;
+            for (uint32_t id = serr->ee_info; id != serr->ee_data + 1; id++) {
+                if (sel->zc_next_id - id <= ZC_RING) { // Older slots were reused
+                    sel->zc_latency_ns += now - sel->zc_send_ns[id % ZC_RING];
+                    sel->zc_timed++;
+                }
+            }
+            sel->zc_completed += count;
+            trace_event(TRACE_COMPLETION, count);
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                sel->zc_copied += count;
+            }
+            metrics_completions(count, serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED ? count : 0);
+        }
+    }
+}
+
+static void selector_report(const selector_t* sel) {
+    for (int c = 0; c < SIZE_CLASSES; c++) {
+        const size_class_t* cls = &sel->classes[c];
+        if (cls->total_sends == 0) continue;
+        printf("Server: Socket %d size ~%d bytes: %ld sends, final %s, %d switches "
+               "(copy %.1f%% / sendmsg %.1f%% / zerocopy %.1f%%)\n",
+               sel->sock, 1 << c, cls->total_sends, strategy_names[cls->current], cls->switches,
+               100.0 * cls->sends[STRATEGY_COPY] / cls->total_sends,
+               100.0 * cls->sends[STRATEGY_SENDMSG] / cls->total_sends,
+               100.0 * cls->sends[STRATEGY_ZEROCOPY] / cls->total_sends);
+    }
+    if (sel->zc_completed > 0) {
+        printf("Server: Socket %d zero-copy completions: %ld, avg latency %.3f us, %.1f%% copied by the kernel\n",
+               sel->sock, sel->zc_completed, sel->zc_timed > 0 ? sel->zc_latency_ns / 1000.0 / sel->zc_timed : 0.0,
+               100.0 * sel->zc_copied / sel->zc_completed);
+    }
+}
+
+void* handle_client(void* args) {
+    int client_socket = *(int*)args;
+    free(args);
+
+    // *** HANDSHAKE: Wait for client "Ready" signal ***
+    char ready_signal;
+    if (recv(client_socket, &ready_signal, 1, 0) <= 0) {
+        perror("Server: Handshake recv failed");
+        close(client_socket);
+        return NULL;
+    }
+
+    // *** HANDSHAKE: Send "Go" signal to client ***
+    char go_signal = 'G';
+    if (send(client_socket, &go_signal, 1, 0) <= 0) {
+        perror("Server: Handshake send failed");
+        close(client_socket);
+        return NULL;
+    }
+
+    trace_thread_start(client_socket);
+    tcpinfo_register(client_socket);
+    mem_register(client_socket);
+
+    pacing_t pacing;
+    if (pacing_init(&pacing, client_socket, g_pacing_mode, g_pacing_rate) < 0) {
+        goto unregister;
+    }
+
+    // The handshake stays plaintext; with --tls everything after it is encrypted
+    ktls_session_t tls;
+    if (ktls_server_start(&tls, client_socket, g_tls, ready_signal == DUPLEX_READY_SIGNAL) < 0) {
+        goto unregister;
+    }
+
+    // Prepare message, gather buffer and iovecs for all three strategies
+    payload_t payload;
+    if (payload_init(&payload, g_payload_mode, &g_schema, &g_payload_pool, (uint64_t)client_socket, g_checksum) < 0) {
+        goto unregister;
+    }
+
+    size_t trailer_size = g_checksum ? CRC32C_TRAILER_SIZE : 0;
+    size_t frame_size = g_schema.total + trailer_size;
+    char* send_buffer = (char*)aligned_alloc(64, (frame_size + 63) & ~(size_t)63);
+    selector_t* sel = (selector_t*)calloc(1, sizeof(selector_t));
+    if (!send_buffer || !sel) {
+        perror("Failed to allocate hybrid sender state");
+        free(send_buffer);
+        free(sel);
+        payload_destroy(&payload);
+        goto unregister;
+    }
+    copy_kernel_t kernel = copy_kernel_select(COPY_KERNEL_AUTO, g_schema.total, COPY_NT_THRESHOLD);
+
+    sel->sock = client_socket;
+    int zero_copy_opt = 1;
+    // Software kTLS encrypts into its own buffers and rejects MSG_ZEROCOPY.
+    // Counter and random payloads rewrite one message in place, which would
+    // change pages a zero-copy send still has pinned.
+    sel->zerocopy_ok = !g_tls && (g_payload_mode == PAYLOAD_STATIC || g_payload_mode == PAYLOAD_POOL) &&
+                       setsockopt(client_socket, SOL_SOCKET, SO_ZEROCOPY, &zero_copy_opt, sizeof(zero_copy_opt)) == 0;
+    for (int c = 0; c < SIZE_CLASSES; c++) {
+        sel->classes[c].current = STRATEGY_SENDMSG;
+    }
+
+    int num_fields = g_schema.num_fields;
+    struct iovec iov[MAX_FIELDS + 1];
+    struct msghdr msg_hdr;
+    memset(&msg_hdr, 0, sizeof(msg_hdr));
+    msg_hdr.msg_iov = iov;
+    msg_hdr.msg_iovlen = num_fields + (g_checksum ? 1 : 0);
+
+    // Full-duplex mode: receive the client's stream on a second thread
+    duplex_rx_t duplex_rx;
+    memset(&duplex_rx, 0, sizeof(duplex_rx));
+    if (ready_signal == DUPLEX_READY_SIGNAL) {
+        duplex_rx_start(&duplex_rx, client_socket, g_schema.total, g_checksum);
+    }
+
+    metrics_thread_start();
+
+    // Send messages repeatedly for the specified duration
+    struct timeval start_time, current_time;
+    gettimeofday(&start_time, NULL);
+
+    while (1) {
+        trace_event(TRACE_CLOCK_BEGIN, 0);
+        gettimeofday(&current_time, NULL);
+        trace_event(TRACE_CLOCK_END, 0);
+        if (current_time.tv_sec - start_time.tv_sec >= g_duration) {
+            break;
+        }
+
+        trace_event(TRACE_FILL_BEGIN, 0);
+        message_t* msg = payload_next(&payload);
+        trace_event(TRACE_FILL_END, frame_size);
+        int class_index = size_class_of(frame_size);
+        size_class_t* cls = &sel->classes[class_index];
+        strategy_t strategy = selector_choose(sel, cls);
+
+        pacing_wait(&pacing);
+        ssize_t bytes_sent;
+        long start = now_ns();
+        trace_event(TRACE_SEND_BEGIN, (uint64_t)strategy);
+        if (strategy == STRATEGY_COPY) {
+            gather_message(send_buffer, msg, kernel);
+            memcpy(send_buffer + g_schema.total, payload_crc(&payload), trailer_size);
+            bytes_sent = send(client_socket, send_buffer, frame_size, 0);
+        } else {
+            for (int i = 0; i < num_fields; i++) {
+                iov[i].iov_base = msg->field[i];
+                iov[i].iov_len = g_schema.size[i];
+            }
+            if (g_checksum) {
+                iov[num_fields].iov_base = (void*)payload_crc(&payload);
+                iov[num_fields].iov_len = CRC32C_TRAILER_SIZE;
+            }
+            if (strategy == STRATEGY_ZEROCOPY) {
+                sel->zc_send_ns[sel->zc_next_id % ZC_RING] = start;
+                bytes_sent = sendmsg(client_socket, &msg_hdr, MSG_ZEROCOPY);
+                if (bytes_sent > 0) {
+                    sel->zc_next_id++;
+                }
+            } else {
+                bytes_sent = sendmsg(client_socket, &msg_hdr, 0);
+            }
+        }
+        long send_ns = now_ns() - start;
+        trace_event(TRACE_SEND_END, bytes_sent > 0 ? (uint64_t)bytes_sent : 0);
+        if (bytes_sent <= 0) {
+            // Client disconnected or send failed
+            break;
+        }
+        pacing_sent(&pacing, (size_t)bytes_sent);
+        metrics_tx((size_t)bytes_sent, (uint64_t)start);
+
+        // Completions of earlier zero-copy sends are charged to zero-copy,
+        // whichever strategy just sent: the drain is timed on its own and
+        // added to the next zero-copy sample
+        if (sel->zerocopy_ok && sel->zc_completed < (long)sel->zc_next_id) {
+            long drain_start = now_ns();
+            trace_event(TRACE_ERRQ_BEGIN, 0);
+            selector_drain_completions(sel);
+            trace_event(TRACE_ERRQ_END, 0);
+            sel->zc_drain_ns += now_ns() - drain_start;
+        }
+        if (strategy == STRATEGY_ZEROCOPY) {
+            send_ns += sel->zc_drain_ns;
+            sel->zc_drain_ns = 0;
+        }
+        selector_record(sel, cls, class_index, strategy, send_ns, (size_t)bytes_sent);
+    }
+
+    selector_report(sel);
+    payload_report(&payload, client_socket);
+
+    free(sel);
+    free(send_buffer);
+    payload_destroy(&payload);
+    ktls_session_report(&tls, client_socket);
+    pacing_report(&pacing, client_socket);
+    duplex_rx_stop(&duplex_rx, client_socket);
+    metrics_thread_stop();
+    printf("Server: Client disconnected. Closing socket %d.\n", client_socket);
+
+unregister:
+    // Every path after tcpinfo_register() leaves through here
+    tcpinfo_unregister(client_socket);
+    mem_unregister(client_socket);
+    close(client_socket);
+    return NULL;
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options] [message_size] [duration_in_seconds]\n", prog);
+    fprintf(stderr, "  -p, --payload MODE          static (default), counter, random or pool\n");
+    fprintf(stderr, "  -c, --checksum              Append a CRC32C trailer to every message (client -c)\n");
+    fprintf(stderr, "  -f, --schema SPEC           uniform:N (default uniform:8), skewed:N or file:PATH\n");
+    fprintf(stderr, "  -q, --quiet                 Do not log individual strategy switches\n");
+    fprintf(stderr, "  -I, --tcp-info FILE         Sample TCP_INFO of every connection into a CSV time series\n");
+    fprintf(stderr, "      --tcp-info-ms MS        TCP_INFO sampling interval (default %d)\n", TCPINFO_DEFAULT_INTERVAL_MS);
+    fprintf(stderr, "      --metrics PATH          Serve live counters on a Unix socket (Prometheus text or JSON)\n");
+    fprintf(stderr, "      --lean                  Small connection stacks and one shared static message\n");
+    fprintf(stderr, "  -T, --trace FILE            Record hot-path events to FILE (see MT25043_Part_D_Trace.py)\n");
+    fprintf(stderr, "  -r, --rate RATE             Pace every connection at RATE bits/s (k/m/g suffix)\n");
+    fprintf(stderr, "      --pacing MODE           maxrate (SO_MAX_PACING_RATE, default) or txtime (timed sends)\n");
+    fprintf(stderr, "      --tls                   Encrypt with kernel TLS, AES-GCM-128 test keys (client --tls)\n");
+    fprintf(stderr, "      --pool-mb MB            Pool size for -p pool (default %d x LLC, at least 64)\n", PAYLOAD_POOL_LLC_FACTOR);
+}
+
+int main(int argc, char const *argv[]) {
+    // Line-buffer stdout so per-connection reports survive the harness kill
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    // A client that hangs up mid-send ends its connection, not the server
+    signal(SIGPIPE, SIG_IGN);
+
+    static const struct option long_options[] = {
+        { "payload",     required_argument, NULL, 'p' },
+        { "checksum",    no_argument,       NULL, 'c' },
+        { "schema",      required_argument, NULL, 'f' },
+        { "quiet",       no_argument,       NULL, 'q' },
+        { "pool-mb",     required_argument, NULL, 'P' },
+        { "tcp-info",    required_argument, NULL, 'I' },
+        { "tcp-info-ms", required_argument, NULL, 'M' },
+        { "trace",       required_argument, NULL, 'T' },
+        { "rate",        required_argument, NULL, 'r' },
+        { "pacing",      required_argument, NULL, 'E' },
+        { "metrics",     required_argument, NULL, 'X' },
+        { "tls",         no_argument,       NULL, 'L' },
+        { "lean",        no_argument,       NULL, 'G' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    // Parse command-line options, then the positional arguments
+    int option;
+    while ((option = getopt_long(argc, (char* const*)argv, "p:cf:qT:I:r:", long_options, NULL)) != -1) {
+        switch (option) {
+        case 'p':
+            if (parse_payload_mode(optarg, &g_payload_mode) < 0) {
+                fprintf(stderr, "Unknown payload mode '%s' (expected static, counter, random or pool)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'c':
+            g_checksum = 1;
+            break;
+        case 'f':
+            g_schema_spec = optarg;
+            break;
+        case 'q':
+            g_verbose = 0;
+            break;
+        case 'P':
+            g_pool_bytes = (size_t)atol(optarg) * 1024 * 1024;
+            break;
+        case 'T':
+            g_trace_path = optarg;
+            break;
+        case 'I':
+            g_tcp_info_path = optarg;
+            break;
+        case 'M':
+            g_tcp_info_ms = atoi(optarg);
+            break;
+        case 'X':
+            g_metrics_path = optarg;
+            break;
+        case 'G':
+            g_lean = 1;
+            break;
+        case 'r':
+            if (parse_rate(optarg, &g_pacing_rate) < 0) {
+                fprintf(stderr, "Invalid pacing rate '%s' (e.g. 500m or 2g bits/s)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'E':
+            if (parse_pacing_mode(optarg, &g_pacing_mode) < 0) {
+                fprintf(stderr, "Unknown pacing mode '%s' (expected maxrate or txtime)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'L':
+            g_tls = 1;
+            break;
+        default:
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc - optind >= 1) {
+        g_msg_size = atoi(argv[optind]);
+    }
+    if (argc - optind >= 2) {
+        g_duration = atoi(argv[optind + 1]);
+    }
+
+    if (g_msg_size <= 0 || schema_parse(&g_schema, g_schema_spec, (size_t)g_msg_size) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Server configured: msg_size=%d bytes, duration=%d seconds\n", g_msg_size, g_duration);
+    meta_report(argv[0], 1);
+    schema_print(&g_schema, "Server schema");
+
+    if (g_payload_mode == PAYLOAD_POOL) {
+        if (g_pool_bytes == 0) {
+            g_pool_bytes = payload_default_pool_bytes();
+        }
+        if (payload_pool_build(&g_payload_pool, &g_schema, g_pool_bytes) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        printf("Server payload: pool of %d messages (%zu MB)\n", g_payload_pool.count,
+               (size_t)g_payload_pool.count * g_msg_size / (1024 * 1024));
+    } else {
+        printf("Server payload: %s\n", payload_mode_name(g_payload_mode));
+    }
+    if (g_lean && g_payload_mode == PAYLOAD_STATIC) {
+        // Every connection sends the same bytes: build them once, read-only
+        if (payload_shared_build(&g_payload_pool, &g_schema) < 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (g_checksum) {
+        printf("Server checksum: CRC32C trailer of %d bytes after every message\n", CRC32C_TRAILER_SIZE);
+    }
+    if (g_trace_path && trace_init(g_trace_path, argv[0], 0) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_tcp_info_path && tcpinfo_start(g_tcp_info_path, argv[0], g_tcp_info_ms) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_metrics_path && metrics_start(g_metrics_path, argv[0]) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_tls) {
+        printf("Server kTLS: TLS 1.2 AES-GCM-128 with fixed test keys\n");
+    }
+    if (g_pacing_rate > 0) {
+        printf("Server pacing: %.3f Mbit/s per connection (%s)\n", g_pacing_rate / 1e6, pacing_mode_name(g_pacing_mode));
+    }
+
+    int server_fd;
+    struct sockaddr_in address;
+    int opt = 1;
+
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+        perror("socket failed");
+        exit(EXIT_FAILURE);
+    }
+
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+        perror("setsockopt");
+        exit(EXIT_FAILURE);
+    }
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(PORT);
+
+    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("bind failed");
+        exit(EXIT_FAILURE);
+    }
+
+    if (listen(server_fd, SOMAXCONN) < 0) {
+        perror("listen");
+        exit(EXIT_FAILURE);
+    }
+
+    // Connection threads, with small stacks in lean mode; memory is accounted from here
+    pthread_attr_t thread_attr;
+    size_t stack_size = mem_thread_attr(&thread_attr, g_lean);
+    if (mem_start("Server ", 1, stack_size) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_lean) {
+        printf("Server lean: %zu KB connection stacks, %s\n", stack_size / 1024,
+               g_payload_pool.count == 1 ? "one shared static message" : "per-connection messages");
+    }
+
+    printf("Server (Receiver) listening on port %d...\n", PORT);
+
+    while (1) {
+        int* client_socket = malloc(sizeof(int));
+        if ((*client_socket = accept(server_fd, NULL, NULL)) < 0) {
+            perror("accept");
+            free(client_socket);
+            continue;
+        }
+
+        printf("Server: New connection accepted. Socket fd is %d\n", *client_socket);
+
+        pthread_t thread_id;
+        if (pthread_create(&thread_id, &thread_attr, handle_client, (void*)client_socket) != 0) {
+            perror("pthread_create failed");
+            close(*client_socket);
+            free(client_socket);
+        }
+        pthread_detach(thread_id);
+    }
+
+    close(server_fd);
+    return 0;
+}
@@ -0,0 +1,641 @@
+// MT25043
+//
+// File: MT25043_Part_A5_Server.c (ROLE: SENDER)
+//
+// Description: vmsplice Zero-Copy TCP Server. Message fields live in
+// page-aligned slots; every send vmsplice()s the field pages into a pipe
+// with SPLICE_F_GIFT and splice()s the pipe into the socket, so the data is
+// never copied by the sender.
+//
+// Once pages are handed to the kernel they must not be written until the
+// socket no longer references them. Slots form a ring and a slot is only
+// refilled after the bytes it last sent have left the send queue
+// (spliced bytes - SIOCOUTQ). On loopback the receiver's queue can still
+// reference acknowledged pages, so the ring defaults to 32 MB, beyond the
+// default socket buffers. Static and pool payloads are never rewritten,
+// so they need no gating at all.
+// ============================================================================
+
+#define _GNU_SOURCE // Required for vmsplice() and splice()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <time.h>
+#include <getopt.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <linux/sockios.h>
+
+#include "MT25043_Message.h"
+#include "MT25043_Payload.h"
+#include "MT25043_Crc32c.h"
+#include "MT25043_Trace.h"
+#include "MT25043_TcpInfo.h"
+#include "MT25043_Duplex.h"
+#include "MT25043_Pacing.h"
+#include "MT25043_Tls.h"
+#include "MT25043_Meta.h"
+#include "MT25043_Metrics.h"
+#include "MT25043_Memory.h"
+
+#define PORT 8080
+
+#define PIPE_BYTES (1024 * 1024)            // Requested pipe capacity
+#define RING_DEFAULT_BYTES (32L * 1024 * 1024)  // Covers default tcp_wmem/rmem
+#define RELEASE_POLL_US 20                  // Sleep while waiting for a slot
+
+// Global parameters set from command line
+static int g_msg_size = 8192;
+static int g_duration = 10;
+
+// Message layout: field count and sizes (see MT25043_Message.h)
+static const char* g_schema_spec = "uniform:8";
+static schema_t g_schema;
+
+// Payload options: how message contents change between sends
+static payload_mode_t g_payload_mode = PAYLOAD_STATIC;
+static size_t g_pool_bytes = 0;
+static payload_pool_t g_payload_pool;
+
+// Checksum mode: append a CRC32C of the fields after every message
+static int g_checksum = 0;
+
+// Hot-path event trace output (see MT25043_Trace.h)
+static const char* g_trace_path = NULL;
+
+// TCP_INFO time series output and interval (see MT25043_TcpInfo.h)
+static const char* g_tcp_info_path = NULL;
+static int g_tcp_info_ms = TCPINFO_DEFAULT_INTERVAL_MS;
+
+// Live metrics endpoint on a Unix socket (see MT25043_Metrics.h)
+static const char* g_metrics_path = NULL;
+
+// Lean mode: small connection stacks, one shared static message (see MT25043_Memory.h)
+static int g_lean = 0;
+
+// Per-connection pacing rate in bits/s (0 = unpaced, see MT25043_Pacing.h)
+static uint64_t g_pacing_rate = 0;
+static pacing_mode_t g_pacing_mode = PACING_MAXRATE;
+
+// kTLS mode: encrypt the stream with fixed test keys (see MT25043_Tls.h)
+static int g_tls = 0;
+
+// Bytes of page-aligned slots per connection for counter/random payloads
+static size_t g_ring_bytes = RING_DEFAULT_BYTES;
+
+static long g_page_size;
+
+// One page-aligned frame: the fields back to back, then the CRC trailer.
+typedef struct {
+    message_t msg;          // Field pointers into the slot memory
+    char* base;
+    uint64_t release_at;    // Stream offset after this slot's last byte
+} slot_t;
+
+typedef struct {
+    long vmsplices;
+    long splices;
+    long full_pages;        // Pipe buffers holding a whole page
+    long partial_pages;     // Pipe buffers holding part of a page
+    long partial_bytes;     // Bytes travelling in partial-page buffers
+    long release_waits;     // Slot refills that had to wait for the kernel
+    long release_wait_ns;
+} splice_stats_t;
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Classifies the pages covered by one iovec segment.
+static void count_pages(splice_stats_t* st, const char* base, size_t len) {
+    uintptr_t start = (uintptr_t)base, end = start + len;
+    uintptr_t first_full = (start + g_page_size - 1) & ~(uintptr_t)(g_page_size - 1);
+    uintptr_t last_full = end & ~(uintptr_t)(g_page_size - 1);
+    if (first_full >= last_full) {
+        // Segment does not cover any page completely
+        st->partial_pages += (long)((end - 1) / g_page_size - start / g_page_size + 1);
+        st->partial_bytes += (long)len;
+        return;
+    }
+    st->full_pages += (long)((last_full - first_full) / g_page_size);
+    if (start != first_full) {
+        st->partial_pages++;
+        st->partial_bytes += (long)(first_full - start);
+    }
+    if (end != last_full) {
+        st->partial_pages++;
+        st->partial_bytes += (long)(end - last_full);
+    }
+}
+
+// Pushes one frame through the pipe into the socket. Returns 0 or -1.
+static int splice_frame(int sock, int pipe_fd[2], struct iovec* iov, int iov_count,
+                        unsigned int vmsplice_flags, splice_stats_t* st) {
+    for (int i = 0; i < iov_count; i++) {
+        count_pages(st, (const char*)iov[i].iov_base, iov[i].iov_len);
+    }
+    while (iov_count > 0) {
+        ssize_t in = vmsplice(pipe_fd[1], iov, (unsigned long)iov_count, vmsplice_flags);
+        if (in <= 0) {
+            perror("Server: vmsplice failed");
+            return -1;
+        }
+        st->vmsplices++;
+
+        // Advance past what the pipe accepted
+        size_t left = (size_t)in;
+        while (iov_count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if (iov_count > 0) {
+            iov->iov_base = (char*)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+
+        // Drain the pipe completely so the next vmsplice has room
+        while (in > 0) {
+            ssize_t out = splice(pipe_fd[0], NULL, sock, NULL, (size_t)in, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (out <= 0) {
+                return -1; // Client disconnected or send failed
+            }
+            st->splices++;
+            in -= out;
+        }
+    }
+    return 0;
+}
+
+// Bytes the socket has released so far: spliced minus still queued.
+// Returns -1 if the queue cannot be read.
+static int released_bytes(int sock, uint64_t spliced, uint64_t* released) {
+    int queued = 0;
+    if (ioctl(sock, SIOCOUTQ, &queued) < 0) {
+        return -1;
+    }
+    *released = spliced - (uint64_t)queued;
+    return 0;
+}
+
+void* handle_client(void* args) {
+    int client_socket = *(int*)args;
+    free(args);
+
+    // *** HANDSHAKE: Wait for client "Ready" signal ***
+    char ready_signal;
+    if (recv(client_socket, &ready_signal, 1, 0) <= 0) {
+        perror("Server: Handshake recv failed");
+        close(client_socket);
+        return NULL;
+    }
+
+    // *** HANDSHAKE: Send "Go" signal to client ***
+    char go_signal = 'G';
+    if (send(client_socket, &go_signal, 1, 0) <= 0) {
+        perror("Server: Handshake send failed");
+        close(client_socket);
+        return NULL;
+    }
+
+    trace_thread_start(client_socket);
+    tcpinfo_register(client_socket);
+    mem_register(client_socket);
+
+    pacing_t pacing;
+    if (pacing_init(&pacing, client_socket, g_pacing_mode, g_pacing_rate) < 0) {
+        goto unregister;
+    }
+
+    // The handshake stays plaintext; with --tls everything after it is encrypted
+    ktls_session_t tls;
+    if (ktls_server_start(&tls, client_socket, g_tls, ready_signal == DUPLEX_READY_SIGNAL) < 0) {
+        goto unregister;
+    }
+
+    int pipe_fd[2];
+    if (pipe(pipe_fd) < 0) {
+        perror("Server: pipe failed");
+        goto unregister;
+    }
+    int pipe_bytes = fcntl(pipe_fd[1], F_SETPIPE_SZ, PIPE_BYTES);
+    if (pipe_bytes < 0) {
+        pipe_bytes = fcntl(pipe_fd[1], F_GETPIPE_SZ);
+    }
+
+    // Pool messages (and the lean shared static message) are shared and
+    // read-only, so they are spliced straight from the pool. Every other mode
+    // sends from the page-aligned slot ring; static fills it once,
+    // counter/random refill a slot before each send.
+    size_t trailer_size = g_checksum ? CRC32C_TRAILER_SIZE : 0;
+    size_t frame_size = g_schema.total + trailer_size;
+    size_t slot_size = (frame_size + g_page_size - 1) & ~(size_t)(g_page_size - 1);
+    int use_ring = g_payload_pool.count == 0;
+    int num_slots = 0;
+    char* ring = NULL;
+    slot_t* slots = NULL;
+    payload_t payload;
+    if (payload_init(&payload, g_payload_mode, &g_schema, &g_payload_pool, (uint64_t)client_socket, g_checksum) < 0) {
+        close(pipe_fd[0]);
+        close(pipe_fd[1]);
+        goto unregister;
+    }
+    if (use_ring) {
+        num_slots = g_payload_mode == PAYLOAD_STATIC ? 1 : (int)(g_ring_bytes / slot_size);
+        if (num_slots < 2 && g_payload_mode != PAYLOAD_STATIC) num_slots = 2;
+        ring = (char*)aligned_alloc((size_t)g_page_size, slot_size * num_slots);
+        slots = (slot_t*)calloc(num_slots, sizeof(slot_t));
+        if (!ring || !slots) {
+            perror("Failed to allocate slot ring");
+            free(ring);
+            free(slots);
+            payload_destroy(&payload);
+            close(pipe_fd[0]);
+            close(pipe_fd[1]);
+            goto unregister;
+        }
+        for (int s = 0; s < num_slots; s++) {
+            slots[s].base = ring + slot_size * s;
+            slots[s].msg.schema = &g_schema;
+            for (int i = 0; i < g_schema.num_fields; i++) {
+                slots[s].msg.field[i] = slots[s].base + g_schema.offset[i];
+            }
+            // Start from the same contents as create_message()
+            for (int i = 0; i < g_schema.num_fields; i++) {
+                memcpy(slots[s].msg.field[i], payload.msg->field[i], g_schema.size[i]);
+            }
+            if (g_checksum) {
+                memcpy(slots[s].base + g_schema.total, payload_crc(&payload), CRC32C_TRAILER_SIZE);
+            }
+        }
+    }
+
+    int num_fields = g_schema.num_fields;
+    struct iovec iov[MAX_FIELDS + 1];
+    splice_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    uint64_t spliced = 0;
+    uint64_t released = 0;
+    long frames = 0;
+    int slot_index = 0;
+
+    struct rusage usage_start, usage_end;
+    getrusage(RUSAGE_THREAD, &usage_start);
+
+    // Full-duplex mode: receive the client's stream on a second thread
+    duplex_rx_t duplex_rx;
+    memset(&duplex_rx, 0, sizeof(duplex_rx));
+    if (ready_signal == DUPLEX_READY_SIGNAL) {
+        duplex_rx_start(&duplex_rx, client_socket, g_schema.total, g_checksum);
+    }
+
+    metrics_thread_start();
+
+    // Send messages repeatedly for the specified duration
+    struct timeval start_time, current_time;
+    gettimeofday(&start_time, NULL);
+
+    while (1) {
+        trace_event(TRACE_CLOCK_BEGIN, 0);
+        gettimeofday(&current_time, NULL);
+        trace_event(TRACE_CLOCK_END, 0);
+        if (current_time.tv_sec - start_time.tv_sec >= g_duration) {
+            break;
+        }
+
+        const message_t* msg;
+        const char* trailer;
+        unsigned int flags = 0;
+        trace_event(TRACE_FILL_BEGIN, 0);
+        if (use_ring) {
+            slot_t* slot = &slots[slot_index];
+            if (g_payload_mode != PAYLOAD_STATIC) {
+                // Wait until the socket has let go of this slot's pages, at
+                // most until the run ends
+                int stop = 0;
+                if (released < slot->release_at) {
+                    stop = released_bytes(client_socket, spliced, &released) < 0;
+                    if (!stop && released < slot->release_at) {
+                        long wait_start = now_ns();
+                        long deadline = start_time.tv_sec + g_duration;
+                        while (!stop && released < slot->release_at) {
+                            usleep(RELEASE_POLL_US);
+                            gettimeofday(&current_time, NULL);
+                            stop = current_time.tv_sec >= deadline ||
+                                   released_bytes(client_socket, spliced, &released) < 0;
+                        }
+                        stats.release_waits++;
+                        stats.release_wait_ns += now_ns() - wait_start;
+                    }
+                }
+                if (stop) {
+                    break; // Run over, or the socket is gone: the slot cannot be reused
+                }
+                payload_fill(&slot->msg, g_payload_mode, &payload.counter, payload.rng);
+                if (g_checksum) {
+                    uint32_t crc = crc32c_message(&slot->msg);
+                    memcpy(slot->base + g_schema.total, &crc, CRC32C_TRAILER_SIZE);
+                }
+            }
+            msg = &slot->msg;
+            trailer = slot->base + g_schema.total;
+            flags = SPLICE_F_GIFT;
+            slot->release_at = spliced + frame_size;
+            slot_index = (slot_index + 1) % num_slots;
+        } else {
+            msg = payload_next(&payload);
+            trailer = (const char*)payload_crc(&payload);
+        }
+        trace_event(TRACE_FILL_END, frame_size);
+
+        for (int i = 0; i < num_fields; i++) {
+            iov[i].iov_base = msg->field[i];
+            iov[i].iov_len = g_schema.size[i];
+        }
+        if (g_checksum) {
+            iov[num_fields].iov_base = (void*)trailer;
+            iov[num_fields].iov_len = CRC32C_TRAILER_SIZE;
+        }
+        pacing_wait(&pacing);
+        uint64_t send_start = metrics_clock();
+        trace_event(TRACE_SEND_BEGIN, 0);
+        int rc = splice_frame(client_socket, pipe_fd, iov, num_fields + (g_checksum ? 1 : 0), flags, &stats);
+        trace_event(TRACE_SEND_END, rc == 0 ? frame_size : 0);
+        if (rc < 0) {
+            break;
+        }
+        pacing_sent(&pacing, frame_size);
+        metrics_tx(frame_size, send_start);
+        spliced += frame_size;
+        frames++;
+    }
+
+    getrusage(RUSAGE_THREAD, &usage_end);
+    gettimeofday(&current_time, NULL);
+    double elapsed = (current_time.tv_sec - start_time.tv_sec) + (current_time.tv_usec - start_time.tv_usec) / 1e6;
+    long cpu_ns = (usage_end.ru_utime.tv_sec - usage_start.ru_utime.tv_sec + usage_end.ru_stime.tv_sec - usage_start.ru_stime.tv_sec) * 1000000000L
+                + (usage_end.ru_utime.tv_usec - usage_start.ru_utime.tv_usec + usage_end.ru_stime.tv_usec - usage_start.ru_stime.tv_usec) * 1000L;
+
+    if (spliced > 0) {
+        printf("Server: Socket %d spliced %ld messages (%.3f Gbps, %.4f CPU ns per byte, pipe %d bytes)\n",
+               client_socket, frames, spliced * 8.0 / elapsed / 1e9, (double)cpu_ns / spliced, pipe_bytes);
+        printf("Server: Socket %d %ld vmsplice / %ld splice calls; pipe buffers: %ld whole-page, "
+               "%ld partial-page carrying %ld bytes (%.1f%% of data)\n",
+               client_socket, stats.vmsplices, stats.splices, stats.full_pages,
+               stats.partial_pages, stats.partial_bytes, 100.0 * stats.partial_bytes / spliced);
+    }
+    if (stats.release_waits > 0) {
+        printf("Server: Socket %d waited %ld times for a slot (%.3f us avg, ring of %d slots)\n",
+               client_socket, stats.release_waits, stats.release_wait_ns / 1000.0 / stats.release_waits, num_slots);
+    }
+    if (g_payload_mode == PAYLOAD_COUNTER || g_payload_mode == PAYLOAD_RANDOM) {
+        printf("Server: Socket %d refilled %ld slots in place (%s)\n", client_socket, frames, payload_mode_name(g_payload_mode));
+    }
+
+    free(slots);
+    free(ring);
+    payload_destroy(&payload);
+    close(pipe_fd[0]);
+    close(pipe_fd[1]);
+    if (tls.enabled) {
+        ktls_session_report(&tls, client_socket); // Plaintext CPU is reported above
+    }
+    pacing_report(&pacing, client_socket);
+    duplex_rx_stop(&duplex_rx, client_socket);
+    metrics_thread_stop();
+    printf("Server: Client disconnected. Closing socket %d.\n", client_socket);
+
+unregister:
+    // Every path after tcpinfo_register() leaves through here
+    tcpinfo_unregister(client_socket);
+    mem_unregister(client_socket);
+    close(client_socket);
+    return NULL;
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options] [message_size] [duration_in_seconds]\n", prog);
+    fprintf(stderr, "  -p, --payload MODE          static (default), counter, random or pool\n");
+    fprintf(stderr, "  -c, --checksum              Append a CRC32C trailer to every message (client -c)\n");
+    fprintf(stderr, "  -f, --schema SPEC           uniform:N (default uniform:8), skewed:N or file:PATH\n");
+    fprintf(stderr, "      --ring-mb MB            Slot ring per connection for counter/random (default %ld)\n",
+            RING_DEFAULT_BYTES / (1024 * 1024));
+    fprintf(stderr, "  -I, --tcp-info FILE         Sample TCP_INFO of every connection into a CSV time series\n");
+    fprintf(stderr, "      --tcp-info-ms MS        TCP_INFO sampling interval (default %d)\n", TCPINFO_DEFAULT_INTERVAL_MS);
+    fprintf(stderr, "      --metrics PATH          Serve live counters on a Unix socket (Prometheus text or JSON)\n");
+    fprintf(stderr, "      --lean                  Small connection stacks and one shared static message\n");
+    fprintf(stderr, "  -T, --trace FILE            Record hot-path events to FILE (see MT25043_Part_D_Trace.py)\n");
+    fprintf(stderr, "  -r, --rate RATE             Pace every connection at RATE bits/s (k/m/g suffix)\n");
+    fprintf(stderr, "      --pacing MODE           maxrate (SO_MAX_PACING_RATE, default) or txtime (timed sends)\n");
+    fprintf(stderr, "      --tls                   Encrypt with kernel TLS, AES-GCM-128 test keys (client --tls)\n");
+    fprintf(stderr, "      --pool-mb MB            Pool size for -p pool (default %d x LLC, at least 64)\n", PAYLOAD_POOL_LLC_FACTOR);
+}
+
+int main(int argc, char const *argv[]) {
+    // Line-buffer stdout so per-connection reports survive the harness kill
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    // A client that hangs up mid-send ends its connection, not the server
+    signal(SIGPIPE, SIG_IGN);
+
+    static const struct option long_options[] = {
+        { "payload",     required_argument, NULL, 'p' },
+        { "checksum",    no_argument,       NULL, 'c' },
+        { "schema",      required_argument, NULL, 'f' },
+        { "ring-mb",     required_argument, NULL, 'R' },
+        { "pool-mb",     required_argument, NULL, 'P' },
+        { "tcp-info",    required_argument, NULL, 'I' },
+        { "tcp-info-ms", required_argument, NULL, 'M' },
+        { "trace",       required_argument, NULL, 'T' },
+        { "rate",        required_argument, NULL, 'r' },
+        { "pacing",      required_argument, NULL, 'E' },
+        { "metrics",     required_argument, NULL, 'X' },
+        { "tls",         no_argument,       NULL, 'L' },
+        { "lean",        no_argument,       NULL, 'G' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    // Parse command-line options, then the positional arguments
+    int option;
+    while ((option = getopt_long(argc, (char* const*)argv, "p:cf:T:I:r:", long_options, NULL)) != -1) {
+        switch (option) {
+        case 'p':
+            if (parse_payload_mode(optarg, &g_payload_mode) < 0) {
+                fprintf(stderr, "Unknown payload mode '%s' (expected static, counter, random or pool)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'c':
+            g_checksum = 1;
+            break;
+        case 'f':
+            g_schema_spec = optarg;
+            break;
+        case 'R':
+            g_ring_bytes = (size_t)atol(optarg) * 1024 * 1024;
+            break;
+        case 'P':
+            g_pool_bytes = (size_t)atol(optarg) * 1024 * 1024;
+            break;
+        case 'T':
+            g_trace_path = optarg;
+            break;
+        case 'I':
+            g_tcp_info_path = optarg;
+            break;
+        case 'M':
+            g_tcp_info_ms = atoi(optarg);
+            break;
+        case 'X':
+            g_metrics_path = optarg;
+            break;
+        case 'G':
+            g_lean = 1;
+            break;
+        case 'r':
+            if (parse_rate(optarg, &g_pacing_rate) < 0) {
+                fprintf(stderr, "Invalid pacing rate '%s' (e.g. 500m or 2g bits/s)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'E':
+            if (parse_pacing_mode(optarg, &g_pacing_mode) < 0) {
+                fprintf(stderr, "Unknown pacing mode '%s' (expected maxrate or txtime)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'L':
+            g_tls = 1;
+            break;
+        default:
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc - optind >= 1) {
+        g_msg_size = atoi(argv[optind]);
+    }
+    if (argc - optind >= 2) {
+        g_duration = atoi(argv[optind + 1]);
+    }
+
+    if (g_msg_size <= 0 || schema_parse(&g_schema, g_schema_spec, (size_t)g_msg_size) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    g_page_size = sysconf(_SC_PAGESIZE);
+
+    printf("Server configured: msg_size=%d bytes, duration=%d seconds\n", g_msg_size, g_duration);
+    meta_report(argv[0], 0);
+    schema_print(&g_schema, "Server schema");
+
+    if (g_payload_mode == PAYLOAD_POOL) {
+        if (g_pool_bytes == 0) {
+            g_pool_bytes = payload_default_pool_bytes();
+        }
+        if (payload_pool_build(&g_payload_pool, &g_schema, g_pool_bytes) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        printf("Server payload: pool of %d messages (%zu MB)\n", g_payload_pool.count,
+               (size_t)g_payload_pool.count * g_msg_size / (1024 * 1024));
+    } else {
+        printf("Server payload: %s\n", payload_mode_name(g_payload_mode));
+    }
+    if (g_lean && g_payload_mode == PAYLOAD_STATIC) {
+        // Every connection sends the same bytes: build them once, read-only
+        if (payload_shared_build(&g_payload_pool, &g_schema) < 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (g_checksum) {
+        printf("Server checksum: CRC32C trailer of %d bytes after every message\n", CRC32C_TRAILER_SIZE);
+    }
+    if (g_trace_path && trace_init(g_trace_path, argv[0], 0) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_tcp_info_path && tcpinfo_start(g_tcp_info_path, argv[0], g_tcp_info_ms) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_metrics_path && metrics_start(g_metrics_path, argv[0]) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_tls) {
+        printf("Server kTLS: TLS 1.2 AES-GCM-128 with fixed test keys\n");
+    }
+    if (g_pacing_rate > 0) {
+        printf("Server pacing: %.3f Mbit/s per connection (%s)\n", g_pacing_rate / 1e6, pacing_mode_name(g_pacing_mode));
+    }
+
+    int server_fd;
+    struct sockaddr_in address;
+    int opt = 1;
+
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+        perror("socket failed");
+        exit(EXIT_FAILURE);
+    }
+
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+        perror("setsockopt");
+        exit(EXIT_FAILURE);
+    }
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(PORT);
+
+    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("bind failed");
+        exit(EXIT_FAILURE);
+    }
+
+    if (listen(server_fd, SOMAXCONN) < 0) {
+        perror("listen");
+        exit(EXIT_FAILURE);
+    }
+
+    // Connection threads, with small stacks in lean mode; memory is accounted from here
+    pthread_attr_t thread_attr;
+    size_t stack_size = mem_thread_attr(&thread_attr, g_lean);
+    if (mem_start("Server ", 1, stack_size) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (g_lean) {
+        printf("Server lean: %zu KB connection stacks, %s\n", stack_size / 1024,
+               g_payload_pool.count == 1 ? "one shared static message" : "per-connection messages");
+    }
+
+    printf("Server (Receiver) listening on port %d...\n", PORT);
+
+    while (1) {
+        int* client_socket = malloc(sizeof(int));
+        if ((*client_socket = accept(server_fd, NULL, NULL)) < 0) {
+            perror("accept");
+            free(client_socket);
+            continue;
+        }
+
+        printf("Server: New connection accepted. Socket fd is %d\n", *client_socket);
+
+        pthread_t thread_id;
+        if (pthread_create(&thread_id, &thread_attr, handle_client, (void*)client_socket) != 0) {
+            perror("pthread_create failed");
+            close(*client_socket);
+            free(client_socket);
+        }
+        pthread_detach(thread_id);
+    }
+
+    close(server_fd);
+    return 0;
+}
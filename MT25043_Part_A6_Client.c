@@ -0,0 +1,264 @@
+// MT25043
+//
+// File: MT25043_Part_A6_Client.c (ROLE: RECEIVER)
+//
+// Description: AF_XDP Kernel-Bypass Client. Binds an XDP socket to one
+// queue of its interface, attaches the redirect program (see
+// MT25043_Xdp.h), then connects to the server over TCP and sends 'X' plus
+// its MAC address. Frames with the benchmark ethertype land directly in
+// the UMEM; the client walks the RX ring, counts message bytes, completed
+// messages and lost frames, and hands the frames back on the fill ring.
+//
+// The output matches the socket clients, so the AF_XDP ceiling sits in the
+// same results table. "Latency" is the time one receive operation waits
+// for the next batch of frames on the RX ring, the analogue of a recv().
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <time.h>
+#include <getopt.h>
+#include <poll.h>
+
+#include "MT25043_Message.h"
+#include "MT25043_Hist.h"
+#include "MT25043_Xdp.h"
+#include "MT25043_Meta.h"
+
+#define PORT 8080
+#define RX_POLL_TIMEOUT_MS 100
+
+typedef struct {
+    long frames;
+    long lost;              // Gaps in the frame sequence numbers
+    long foreign;           // Frames that were not benchmark chunks
+    long bytes;
+    long messages;          // Messages whose chunks all arrived
+    long polls;
+    uint32_t next_seq;
+    int synced;
+    int intact;             // No chunk of the current message was lost
+} xdp_rx_stats_t;
+
+static inline long timespec_ns(const struct timespec* ts) {
+    return ts->tv_sec * 1000000000L + ts->tv_nsec;
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s -i IFACE [options] <server_ip> <thread_count> <message_size> <duration_in_seconds>\n", prog);
+    fprintf(stderr, "  -i, --ifname IFACE        Interface to receive on (required)\n");
+    fprintf(stderr, "      --xdp-mode MODE       skb (generic XDP, default) or native (driver XDP)\n");
+    fprintf(stderr, "      --xdp-queue N         Interface queue to bind (default 0)\n");
+    fprintf(stderr, "      --busy-poll           Spin on the RX ring instead of sleeping in poll()\n");
+}
+
+int main(int argc, char const *argv[]) {
+    const char* ifname = NULL;
+    xdp_mode_t xdp_mode = XDP_MODE_SKB;
+    int queue = 0;
+    int busy_poll = 0;
+
+    static const struct option long_options[] = {
+        { "ifname",    required_argument, NULL, 'i' },
+        { "xdp-mode",  required_argument, NULL, 'X' },
+        { "xdp-queue", required_argument, NULL, 'Q' },
+        { "busy-poll", no_argument,       NULL, 'U' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, (char* const*)argv, "i:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'i':
+            ifname = optarg;
+            break;
+        case 'X':
+            if (parse_xdp_mode(optarg, &xdp_mode) < 0) {
+                fprintf(stderr, "Unknown XDP mode '%s' (expected skb or native)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'Q':
+            queue = atoi(optarg);
+            break;
+        case 'U':
+            busy_poll = 1;
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind != 4 || !ifname) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char* server_ip = argv[optind];
+    int thread_count = atoi(argv[optind + 1]);
+    int msg_size = atoi(argv[optind + 2]);
+    int duration = atoi(argv[optind + 3]);
+
+    if (thread_count <= 0 || msg_size <= 0 || duration <= 0) {
+        fprintf(stderr, "Invalid arguments. All values must be positive integers.\n");
+        return 1;
+    }
+    if (thread_count != 1) {
+        fprintf(stderr, "The AF_XDP client receives on one interface queue: thread_count must be 1\n");
+        return 1;
+    }
+
+    unsigned char mac[ETH_ALEN];
+    if (xdp_if_mac(ifname, mac) < 0) {
+        return 1;
+    }
+
+    // The XDP socket must be ready before the server starts streaming
+    xsk_t xsk;
+    if (xsk_open(&xsk, ifname, (uint32_t)queue, xdp_mode, 1) < 0) {
+        xsk_close(&xsk);
+        return 1;
+    }
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(PORT);
+    if (sock < 0 || inet_pton(AF_INET, server_ip, &serv_addr.sin_addr) <= 0 ||
+        connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        printf("\nConnection Failed \n");
+        xsk_close(&xsk);
+        return 1;
+    }
+
+    char ready[1 + ETH_ALEN];
+    ready[0] = XDP_READY_SIGNAL;
+    memcpy(ready + 1, mac, ETH_ALEN);
+    char go_signal;
+    if (send(sock, ready, sizeof(ready), 0) != (ssize_t)sizeof(ready) || recv(sock, &go_signal, 1, 0) <= 0) {
+        perror("Handshake failed");
+        close(sock);
+        xsk_close(&xsk);
+        return 1;
+    }
+
+    meta_report(argv[0], 0);
+    printf("Starting 1 client receiver thread on %s queue %d (AF_XDP, %s mode, %s)...\n", ifname, queue,
+           xdp_mode_name(xdp_mode), xsk.zerocopy ? "zero-copy" : "copy");
+
+    xdp_rx_stats_t st;
+    memset(&st, 0, sizeof(st));
+    hist_t latency_hist;
+    arrival_t arrivals;
+    hist_init(&latency_hist);
+    arrival_init(&arrivals);
+    long latency_ns = 0;
+
+    struct timeval start_test, end_test, current_time;
+    struct timespec wait_start, batch_end;
+    gettimeofday(&start_test, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &wait_start);
+
+    while (1) {
+        gettimeofday(&current_time, NULL);
+        if (current_time.tv_sec - start_test.tv_sec >= duration) {
+            break;
+        }
+
+        // One receive operation: wait for the next batch of frames. The wait
+        // runs from the end of the previous batch, across empty polls.
+        uint32_t idx;
+        uint32_t n = xsk_cons_peek(&xsk.rx, XDP_BATCH, &idx);
+        if (n == 0) {
+            if (!busy_poll) {
+                struct pollfd pfd = { .fd = xsk.fd, .events = POLLIN, .revents = 0 };
+                poll(&pfd, 1, RX_POLL_TIMEOUT_MS);
+            } else if (xsk_needs_wakeup(&xsk.fill)) {
+                recvfrom(xsk.fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+            }
+            continue;
+        }
+
+        uint32_t fill_idx;
+        uint32_t reserved = xsk_prod_reserve(&xsk.fill, n, &fill_idx);
+        size_t completed = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            const struct xdp_desc* desc = xsk_desc(&xsk.rx, idx + i);
+            const char* frame = xsk.umem + desc->addr;
+            const struct ethhdr* eth = (const struct ethhdr*)frame;
+            st.frames++;
+            if (desc->len < ETH_HLEN + sizeof(xdp_chunk_hdr_t) || eth->h_proto != htons(ETH_P_MT25043)) {
+                st.foreign++;
+            } else {
+                xdp_chunk_hdr_t hdr;
+                memcpy(&hdr, frame + ETH_HLEN, sizeof(hdr));
+                if (st.synced && hdr.seq != st.next_seq) {
+                    st.lost += (long)(uint32_t)(hdr.seq - st.next_seq);
+                    st.intact = 0;
+                }
+                if (hdr.offset == 0) {
+                    st.intact = 1; // Any gap belonged to earlier messages
+                }
+                st.next_seq = hdr.seq + 1;
+                st.synced = 1;
+                uint32_t chunk = desc->len - ETH_HLEN - (uint32_t)sizeof(hdr);
+                st.bytes += chunk;
+                if (hdr.offset + chunk == hdr.msg_len && st.intact) {
+                    completed++;
+                }
+            }
+            // Hand the frame back to the kernel (its base, without headroom)
+            if (i < reserved) {
+                *xsk_addr(&xsk.fill, fill_idx + i) = desc->addr & ~(uint64_t)(XDP_FRAME_SIZE - 1);
+            }
+        }
+        xsk_cons_release(&xsk.rx);
+        xsk_prod_submit(&xsk.fill);
+
+        clock_gettime(CLOCK_MONOTONIC, &batch_end);
+        long op_ns = timespec_ns(&batch_end) - timespec_ns(&wait_start);
+        latency_ns += op_ns;
+        hist_record(&latency_hist, (uint64_t)op_ns);
+        arrival_record(&arrivals, timespec_ns(&batch_end), completed);
+        st.messages += (long)completed;
+        st.polls++;
+        wait_start = batch_end;
+    }
+
+    gettimeofday(&end_test, NULL);
+    close(sock);
+
+    double elapsed_sec = (end_test.tv_sec - start_test.tv_sec) +
+                         (end_test.tv_usec - start_test.tv_usec) / 1000000.0;
+    double throughput_gbps = elapsed_sec > 0.000001 ? st.bytes * 8.0 / elapsed_sec / 1e9 : 0.0;
+    double avg_latency_us = st.polls > 0 ? latency_ns / 1000.0 / st.polls : 0.0;
+    long expected = st.frames - st.foreign + st.lost;
+
+    printf("\nTest complete.\n");
+    printf("Total bytes received: %ld\n", st.bytes);
+    printf("Test Duration (Actual): %.6f seconds\n", elapsed_sec);
+    printf("Throughput: %.6f Gbps\n", throughput_gbps);
+    printf("Average Latency: %.6f us\n", avg_latency_us);
+    printf("P50 Latency: %.6f us\n", hist_percentile(&latency_hist, 0.50) / 1000.0);
+    printf("P99 Latency: %.6f us\n", hist_percentile(&latency_hist, 0.99) / 1000.0);
+    printf("P99.9 Latency: %.6f us\n", hist_percentile(&latency_hist, 0.999) / 1000.0);
+    printf("Max Latency: %.6f us\n", latency_hist.max / 1000.0);
+    printf("Message Interarrival: %.6f us (p99 %.6f us)\n", hist_mean(&arrivals.gaps) / 1000.0,
+           hist_percentile(&arrivals.gaps, 0.99) / 1000.0);
+    printf("Interarrival Jitter: %.6f us\n", arrival_jitter(&arrivals) / 1000.0);
+    printf("Receive Strategy: af_xdp (%s mode, %s, batch %d frames)\n", xdp_mode_name(xdp_mode),
+           xsk.zerocopy ? "zero-copy" : "copy", XDP_BATCH);
+    printf("Frames per Receive: %.6f\n", st.polls > 0 ? (double)(st.frames) / st.polls : 0.0);
+    printf("Messages Completed: %ld\n", st.messages);
+    printf("XDP Frames: %ld received, %ld lost (%.3f%%), %ld foreign\n", st.frames - st.foreign, st.lost,
+           expected > 0 ? 100.0 * st.lost / expected : 0.0, st.foreign);
+
+    xsk_close(&xsk);
+    return 0;
+}
@@ -0,0 +1,363 @@
+// MT25043
+//
+// File: MT25043_Part_A6_Server.c (ROLE: SENDER)
+//
+// Description: AF_XDP Kernel-Bypass Server. Clients still connect over TCP
+// on the usual port, but only as a control channel: the handshake carries
+// the receiver's MAC address, and the message stream itself bypasses the
+// TCP/IP stack. The server writes every message's fields straight into
+// UMEM frames (one Ethernet frame per MTU-sized chunk, see MT25043_Xdp.h),
+// posts them on the AF_XDP TX ring and kicks the kernel with sendto().
+//
+// There is no congestion control or retransmission: the sender runs as
+// fast as the TX ring drains (or at -r), and the receiver counts lost
+// frames. A single XDP socket is bound to the interface queue, so the
+// server streams to one client at a time.
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <time.h>
+#include <getopt.h>
+#include <errno.h>
+
+#include "MT25043_Message.h"
+#include "MT25043_Payload.h"
+#include "MT25043_Pacing.h"
+#include "MT25043_Xdp.h"
+#include "MT25043_Meta.h"
+
+#define PORT 8080
+#define CONTROL_CHECK_INTERVAL 1024 // Batches between control-socket checks
+
+// Global parameters set from command line
+static int g_msg_size = 8192;
+static int g_duration = 10;
+
+// Message layout: field count and sizes (see MT25043_Message.h)
+static const char* g_schema_spec = "uniform:8";
+static schema_t g_schema;
+
+// Payload options: how message contents change between sends
+static payload_mode_t g_payload_mode = PAYLOAD_STATIC;
+static size_t g_pool_bytes = 0;
+static payload_pool_t g_payload_pool;
+
+// AF_XDP interface, queue and XDP mode (see MT25043_Xdp.h)
+static const char* g_ifname = NULL;
+static int g_queue = 0;
+static xdp_mode_t g_xdp_mode = XDP_MODE_SKB;
+
+// Sending rate in bits/s of Ethernet frames (0 = as fast as the ring drains)
+static uint64_t g_pacing_rate = 0;
+
+typedef struct {
+    long frames;
+    long messages;
+    long bytes;             // Message bytes, without frame headers
+    long wire_bytes;
+    long kicks;
+    long ring_full;         // Batches that found no free TX frame or slot
+} xdp_tx_stats_t;
+
+// Copies len bytes starting at offset of msg's byte stream into dst.
+static void copy_message_range(char* dst, const message_t* msg, size_t offset, size_t len) {
+    const schema_t* schema = msg->schema;
+    for (int i = 0; i < schema->num_fields && len > 0; i++) {
+        size_t start = schema->offset[i], end = start + schema->size[i];
+        if (offset >= end) {
+            continue;
+        }
+        size_t take = end - offset < len ? end - offset : len;
+        memcpy(dst, msg->field[i] + (offset - start), take);
+        dst += take;
+        offset += take;
+        len -= take;
+    }
+}
+
+static void stream_to_client(int control_socket, const unsigned char dst_mac[ETH_ALEN]) {
+    unsigned char src_mac[ETH_ALEN];
+    int mtu = xdp_if_mtu(g_ifname);
+    if (mtu < 0 || xdp_if_mac(g_ifname, src_mac) < 0) {
+        return;
+    }
+    size_t chunk_max = xsk_chunk_max(mtu);
+
+    xsk_t xsk;
+    if (xsk_open(&xsk, g_ifname, (uint32_t)g_queue, g_xdp_mode, 0) < 0) {
+        xsk_close(&xsk);
+        return;
+    }
+    printf("Server: Socket %d streaming over AF_XDP on %s queue %d (%s mode, %s), %zu message bytes per frame\n",
+           control_socket, g_ifname, g_queue, xdp_mode_name(g_xdp_mode), xsk.zerocopy ? "zero-copy" : "copy",
+           chunk_max);
+
+    payload_t payload;
+    if (payload_init(&payload, g_payload_mode, &g_schema, &g_payload_pool, (uint64_t)control_socket, 0) < 0) {
+        xsk_close(&xsk);
+        return;
+    }
+
+    // Txtime pacing: every batch departs on an earliest-departure schedule
+    pacing_t pacing;
+    pacing_init(&pacing, xsk.fd, PACING_TXTIME, g_pacing_rate);
+
+    xdp_tx_stats_t st;
+    memset(&st, 0, sizeof(st));
+    message_t* msg = payload_next(&payload);
+    size_t msg_offset = 0;
+    uint32_t seq = 0;
+
+    struct timeval start_time, current_time;
+    gettimeofday(&start_time, NULL);
+
+    for (long batch = 0;; batch++) {
+        gettimeofday(&current_time, NULL);
+        if (current_time.tv_sec - start_time.tv_sec >= g_duration) {
+            break;
+        }
+        if (batch % CONTROL_CHECK_INTERVAL == 0) {
+            // The client closes the control connection when it is done
+            char probe;
+            if (recv(control_socket, &probe, 1, MSG_DONTWAIT | MSG_PEEK) == 0) {
+                break;
+            }
+        }
+
+        xsk_reclaim(&xsk);
+        uint32_t want = XDP_BATCH < (uint32_t)xsk.num_tx_free ? XDP_BATCH : (uint32_t)xsk.num_tx_free;
+        uint32_t idx;
+        uint32_t n = xsk_prod_reserve(&xsk.tx, want, &idx);
+        if (n == 0) {
+            // Frames still in flight: let the kernel drain the TX ring
+            st.ring_full++;
+            xsk_kick(&xsk);
+            st.kicks++;
+            continue;
+        }
+
+        pacing_wait(&pacing);
+        size_t batch_wire = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            uint64_t addr = xsk.tx_free[--xsk.num_tx_free];
+            char* frame = xsk.umem + addr;
+            struct ethhdr* eth = (struct ethhdr*)frame;
+            memcpy(eth->h_dest, dst_mac, ETH_ALEN);
+            memcpy(eth->h_source, src_mac, ETH_ALEN);
+            eth->h_proto = htons(ETH_P_MT25043);
+
+            size_t chunk = g_schema.total - msg_offset < chunk_max ? g_schema.total - msg_offset : chunk_max;
+            xdp_chunk_hdr_t* hdr = (xdp_chunk_hdr_t*)(frame + ETH_HLEN);
+            hdr->seq = seq++;
+            hdr->msg = (uint32_t)st.messages;
+            hdr->offset = (uint32_t)msg_offset;
+            hdr->msg_len = (uint32_t)g_schema.total;
+            copy_message_range(frame + ETH_HLEN + sizeof(*hdr), msg, msg_offset, chunk);
+
+            struct xdp_desc* desc = xsk_desc(&xsk.tx, idx + i);
+            desc->addr = addr;
+            desc->len = (uint32_t)(ETH_HLEN + sizeof(*hdr) + chunk);
+            desc->options = 0;
+
+            st.frames++;
+            st.bytes += (long)chunk;
+            batch_wire += desc->len;
+            msg_offset += chunk;
+            if (msg_offset == g_schema.total) {
+                st.messages++;
+                msg = payload_next(&payload);
+                msg_offset = 0;
+            }
+        }
+        xsk_prod_submit(&xsk.tx);
+        xsk_kick(&xsk);
+        st.kicks++;
+        st.wire_bytes += (long)batch_wire;
+        pacing_sent(&pacing, batch_wire);
+    }
+
+    double elapsed = (current_time.tv_sec - start_time.tv_sec) + (current_time.tv_usec - start_time.tv_usec) / 1e6;
+    printf("Server: Socket %d sent %ld messages in %ld frames over AF_XDP: %.3f Gbps of messages, "
+           "%.3f Gbps on the wire (%ld kicks, %ld ring-full waits)\n",
+           control_socket, st.messages, st.frames, elapsed > 0 ? st.bytes * 8.0 / elapsed / 1e9 : 0.0,
+           elapsed > 0 ? st.wire_bytes * 8.0 / elapsed / 1e9 : 0.0, st.kicks, st.ring_full);
+    if (g_pacing_rate > 0) {
+        pacing_report(&pacing, control_socket);
+    }
+    payload_report(&payload, control_socket);
+    payload_destroy(&payload);
+    xsk_close(&xsk);
+}
+
+static void handle_client(int control_socket) {
+    // *** HANDSHAKE: 'X' and the MAC address the client receives on ***
+    char ready[1 + ETH_ALEN];
+    if (recv(control_socket, ready, sizeof(ready), MSG_WAITALL) != (ssize_t)sizeof(ready) ||
+        ready[0] != XDP_READY_SIGNAL) {
+        fprintf(stderr, "Server: Socket %d is not an AF_XDP client (expected '%c' + MAC)\n",
+                control_socket, XDP_READY_SIGNAL);
+        close(control_socket);
+        return;
+    }
+
+    char go_signal = 'G';
+    if (send(control_socket, &go_signal, 1, 0) <= 0) {
+        perror("Server: Handshake send failed");
+        close(control_socket);
+        return;
+    }
+
+    stream_to_client(control_socket, (const unsigned char*)ready + 1);
+    printf("Server: Client disconnected. Closing socket %d.\n", control_socket);
+    close(control_socket);
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s -i IFACE [options] [message_size] [duration_in_seconds]\n", prog);
+    fprintf(stderr, "  -i, --ifname IFACE          Interface to send on (required)\n");
+    fprintf(stderr, "      --xdp-mode MODE         skb (generic XDP, default) or native (driver XDP)\n");
+    fprintf(stderr, "      --xdp-queue N           Interface queue to bind (default 0)\n");
+    fprintf(stderr, "  -p, --payload MODE          static (default), counter, random or pool\n");
+    fprintf(stderr, "  -f, --schema SPEC           uniform:N (default uniform:8), skewed:N or file:PATH\n");
+    fprintf(stderr, "  -r, --rate RATE             Send at RATE bits/s of frames (k/m/g suffix, default unpaced)\n");
+    fprintf(stderr, "      --pool-mb MB            Pool size for -p pool (default %d x LLC, at least 64)\n", PAYLOAD_POOL_LLC_FACTOR);
+}
+
+int main(int argc, char const *argv[]) {
+    // Line-buffer stdout so per-connection reports survive the harness kill
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    static const struct option long_options[] = {
+        { "ifname",    required_argument, NULL, 'i' },
+        { "xdp-mode",  required_argument, NULL, 'X' },
+        { "xdp-queue", required_argument, NULL, 'Q' },
+        { "payload",   required_argument, NULL, 'p' },
+        { "schema",    required_argument, NULL, 'f' },
+        { "rate",      required_argument, NULL, 'r' },
+        { "pool-mb",   required_argument, NULL, 'P' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    // Parse command-line options, then the positional arguments
+    int option;
+    while ((option = getopt_long(argc, (char* const*)argv, "i:p:f:r:", long_options, NULL)) != -1) {
+        switch (option) {
+        case 'i':
+            g_ifname = optarg;
+            break;
+        case 'X':
+            if (parse_xdp_mode(optarg, &g_xdp_mode) < 0) {
+                fprintf(stderr, "Unknown XDP mode '%s' (expected skb or native)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'Q':
+            g_queue = atoi(optarg);
+            break;
+        case 'p':
+            if (parse_payload_mode(optarg, &g_payload_mode) < 0) {
+                fprintf(stderr, "Unknown payload mode '%s' (expected static, counter, random or pool)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'f':
+            g_schema_spec = optarg;
+            break;
+        case 'r':
+            if (parse_rate(optarg, &g_pacing_rate) < 0) {
+                fprintf(stderr, "Invalid rate '%s' (e.g. 500m or 2g bits/s)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'P':
+            g_pool_bytes = (size_t)atol(optarg) * 1024 * 1024;
+            break;
+        default:
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc - optind >= 1) {
+        g_msg_size = atoi(argv[optind]);
+    }
+    if (argc - optind >= 2) {
+        g_duration = atoi(argv[optind + 1]);
+    }
+
+    if (!g_ifname) {
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (g_msg_size <= 0 || schema_parse(&g_schema, g_schema_spec, (size_t)g_msg_size) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Server configured: msg_size=%d bytes, duration=%d seconds\n", g_msg_size, g_duration);
+    meta_report(argv[0], 0);
+    schema_print(&g_schema, "Server schema");
+
+    if (g_payload_mode == PAYLOAD_POOL) {
+        if (g_pool_bytes == 0) {
+            g_pool_bytes = payload_default_pool_bytes();
+        }
+        if (payload_pool_build(&g_payload_pool, &g_schema, g_pool_bytes) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        printf("Server payload: pool of %d messages (%zu MB)\n", g_payload_pool.count,
+               (size_t)g_payload_pool.count * g_msg_size / (1024 * 1024));
+    } else {
+        printf("Server payload: %s\n", payload_mode_name(g_payload_mode));
+    }
+    printf("Server AF_XDP: %s queue %d, %s mode\n", g_ifname, g_queue, xdp_mode_name(g_xdp_mode));
+    if (g_pacing_rate > 0) {
+        printf("Server pacing: %.3f Mbit/s of frames (txtime)\n", g_pacing_rate / 1e6);
+    }
+
+    int server_fd;
+    struct sockaddr_in address;
+    int opt = 1;
+
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+        perror("socket failed");
+        exit(EXIT_FAILURE);
+    }
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+        perror("setsockopt");
+        exit(EXIT_FAILURE);
+    }
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(PORT);
+
+    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("bind failed");
+        exit(EXIT_FAILURE);
+    }
+
+    if (listen(server_fd, 10) < 0) {
+        perror("listen");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Server (Receiver) listening on port %d...\n", PORT);
+
+    // One XDP socket per queue: clients are served one after another
+    while (1) {
+        int client_socket = accept(server_fd, NULL, NULL);
+        if (client_socket < 0) {
+            perror("accept");
+            continue;
+        }
+        printf("Server: New connection accepted. Socket fd is %d\n", client_socket);
+        handle_client(client_socket);
+    }
+
+    close(server_fd);
+    return 0;
+}
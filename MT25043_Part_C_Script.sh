@@ -7,9 +7,103 @@ set -e
 
 # Experimental Parameters
 MESSAGE_SIZES=(1024 4096 16384 65536)
-THREAD_COUNTS=(1 2 4 8)
 DURATION=10
 
+# Thread (connection) counts: powers of two up to twice the core count (at
+# least 8), plus the core count itself, so the sweep crosses the point where
+# scaling stops and the USL fit (MT25043_Part_D_Usl.py) can place the peak.
+# Override: THREAD_COUNTS="1 2 4 8"
+CORES=$(nproc)
+default_thread_counts() {
+    local n=1 limit=$(( 2 * CORES > 8 ? 2 * CORES : 8 ))
+    local counts=("$CORES" "$limit")
+    while (( n <= limit )); do
+        counts+=("$n")
+        n=$((n * 2))
+    done
+    printf '%s\n' "${counts[@]}" | sort -n -u | tr '\n' ' '
+}
+read -r -a THREAD_COUNTS <<< "${THREAD_COUNTS:-$(default_thread_counts)}"
+
+# Payload regimes: "static" resends the same cache-hot message, "pool" cycles
+# through a pool much larger than the LLC (cache-cold), "counter"/"random"
+# refill the message before every send. Override: PAYLOAD_MODES="static pool"
+read -r -a PAYLOAD_MODES <<< "${PAYLOAD_MODES:-static}"
+
+# Message schemas (field count and size distribution, see MT25043_Message.h)
+# Override: SCHEMAS="uniform:8 uniform:64 skewed:32"
+read -r -a SCHEMAS <<< "${SCHEMAS:-uniform:8}"
+
+# Implementations to compare; "hybrid" picks a strategy per send at runtime,
+# "xdp" streams raw frames over AF_XDP on the veth pair (single-threaded only,
+# XDP_MODE=skb or native). Override: IMPLEMENTATIONS="one_copy hybrid xdp"
+read -r -a IMPLEMENTATIONS <<< "${IMPLEMENTATIONS:-two_copy one_copy zero_copy hybrid}"
+
+# Set TRACE_DIR to record a hot-path trace of every server and client run;
+# summarize with: python3 MT25043_Part_D_Trace.py --summary "$TRACE_DIR"/*.trace
+TRACE_DIR="${TRACE_DIR:-}"
+
+# Set TCP_INFO_DIR to sample TCP_INFO (cwnd, RTT, retransmits, queues) on
+# both ends of every run into CSV time series, every TCP_INFO_MS ms
+TCP_INFO_DIR="${TCP_INFO_DIR:-}"
+TCP_INFO_MS="${TCP_INFO_MS:-100}"
+
+# Set DUPLEX=1 to stream in both directions (client -D); the client-to-server
+# direction is recorded in the TX_* columns
+DUPLEX="${DUPLEX:-0}"
+
+# Topology profiles emulated on the veth pair with tc: one-way delay,
+# jitter and loss (netem, applied on both ends so the RTT is twice the
+# delay) and a tbf rate limit ("none" = unlimited). Loss is applied on the
+# server side only, i.e. to the data direction.
+#   lan   : bare veth, ~0 RTT
+#   metro : 2 ms RTT, 10 Gbit/s
+#   wan   : 40 ms RTT, 0.01% loss, 1 Gbit/s
+# Extra profiles can be given inline as name:delay/jitter/loss/rate, e.g.
+# TOPOLOGIES="lan wan100:50ms/5ms/0.1%/500mbit"
+declare -A TOPOLOGY_PROFILES=(
+    [lan]="0ms/0ms/0%/none"
+    [metro]="1ms/0.1ms/0%/10gbit"
+    [wan]="20ms/2ms/0.01%/1gbit"
+)
+read -r -a TOPOLOGIES <<< "${TOPOLOGIES:-lan}"
+
+# Per-connection pacing rates (server -r, bits/s with k/m/g suffix; "none"
+# = unpaced) and how they are enforced: maxrate (SO_MAX_PACING_RATE; the
+# server veth gets the fq qdisc on the lan topology) or txtime (timed sends)
+# Override: PACING_RATES="none 500m 2g" PACING_MODE=txtime
+read -r -a PACING_RATES <<< "${PACING_RATES:-none}"
+PACING_MODE="${PACING_MODE:-maxrate}"
+
+# Set TLS=1 to encrypt every run with kernel TLS (--tls on both ends; needs
+# the tls module). Results carry a TLS column so encrypted and plaintext
+# runs can be compared in one CSV
+TLS="${TLS:-0}"
+
+# Set DESERIALIZE=view or naive to decode every message on the client; the
+# schemas must be framed, e.g. SCHEMAS="framed:uniform:8 framed:skewed:64"
+DESERIALIZE="${DESERIALIZE:-}"
+
+# Set WORKERS=N to hand every received message to N client worker threads
+# over lock-free queues (QUEUE=mpmc or spsc, WORK_NS of synthetic work each)
+WORKERS="${WORKERS:-0}"
+QUEUE="${QUEUE:-mpmc}"
+WORK_NS="${WORK_NS:-1000}"
+
+# Set PRODUCERS=N to run the sendmsg() servers (one_copy, zero_copy) in
+# publish mode: N producer threads per connection feed the socket writer
+PRODUCERS="${PRODUCERS:-0}"
+
+# Set LEAN=1 to run servers and clients in lean mode (small connection
+# stacks, one shared static message); memory per connection is recorded
+# either way
+LEAN="${LEAN:-0}"
+
+# Set CORO=N to run the client sessions as coroutines on N threads instead
+# of one thread each
+CORO="${CORO:-0}"
+XDP_MODE="${XDP_MODE:-skb}"
+
 # Network Namespace Configuration
 SERVER_NS="ns1"
 CLIENT_NS="ns2"
@@ -22,6 +116,13 @@ SUBNET_MASK="24"
 # Results File
 RESULTS_FILE="MT25043_Part_C_Results.csv"
 
+# Run metadata: one JSON record per session (host settings, git revision)
+# and per run (parameters and the client's "Run Metadata" line), linked
+# to the results rows by the RunId column
+METADATA_FILE="MT25043_Part_C_Metadata.jsonl"
+SESSION_ID="$(date -u +%Y%m%dT%H%M%SZ)-$$"
+RUN_SEQ=0
+
 # Functions
 cleanup() {
     echo "--- Cleaning up network namespaces ---"
@@ -30,6 +131,43 @@ cleanup() {
     echo "Cleanup complete."
 }
 
+# Reads a sysctl/sysfs value in the server namespace ("n/a" if missing)
+server_ns_value() {
+    local value
+    value=$(ip netns exec "$SERVER_NS" cat "$1" 2> /dev/null) || value="n/a"
+    echo "${value//$'\t'/ }"
+}
+
+# Records the session metadata and warns about settings that distort results
+check_host_settings() {
+    local governors smt thp optmem git_rev
+    governors=$(cat /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor 2> /dev/null | sort -u | tr '\n' ' ')
+    smt=$(cat /sys/devices/system/cpu/smt/control 2> /dev/null || echo "n/a")
+    thp=$(sed -n 's/.*\[\(.*\)\].*/\1/p' /sys/kernel/mm/transparent_hugepage/enabled 2> /dev/null)
+    optmem=$(server_ns_value /proc/sys/net/core/optmem_max)
+    git_rev=$(git describe --always --dirty 2> /dev/null || echo "unknown")
+
+    if [[ "$governors" == *powersave* || "$governors" == *conservative* ]]; then
+        echo "WARNING: CPU frequency governor is '${governors% }'; set 'performance' for stable results"
+    fi
+    if [[ " ${IMPLEMENTATIONS[*]} " == *" zero_copy "* || " ${IMPLEMENTATIONS[*]} " == *" hybrid "* ]] &&
+       [[ "$optmem" =~ ^[0-9]+$ ]] && (( optmem < 131072 )); then
+        echo "WARNING: net.core.optmem_max is $optmem in $SERVER_NS; MSG_ZEROCOPY runs fail or fall back to copying"
+        echo "         (raise it with: ip netns exec $SERVER_NS sysctl -w net.core.optmem_max=131072)"
+    fi
+    if [[ "$smt" == "on" ]]; then
+        echo "NOTE: SMT is on; sibling hyperthreads share cores past $((CORES / 2)) threads"
+    fi
+
+    printf '{"record":"session","session":"%s","git":"%s","kernel":"%s","cpu_model":"%s","cpus":%d,' \
+        "$SESSION_ID" "$git_rev" "$(uname -r)" \
+        "$(sed -n 's/^model name[[:space:]]*: //p' /proc/cpuinfo | head -1 | tr -d '"\\')" "$CORES" >> "$METADATA_FILE"
+    printf '"governor":"%s","smt":"%s","thp":"%s","server_ns":{"optmem_max":"%s","rmem_max":"%s","wmem_max":"%s","tcp_rmem":"%s","tcp_wmem":"%s"}}\n' \
+        "${governors% }" "$smt" "$thp" "$optmem" \
+        "$(server_ns_value /proc/sys/net/core/rmem_max)" "$(server_ns_value /proc/sys/net/core/wmem_max)" \
+        "$(server_ns_value /proc/sys/net/ipv4/tcp_rmem)" "$(server_ns_value /proc/sys/net/ipv4/tcp_wmem)" >> "$METADATA_FILE"
+}
+
 setup_namespaces() {
     echo "--- Setting up network namespaces ---"
     ip netns add "$SERVER_NS"
@@ -48,6 +186,47 @@ setup_namespaces() {
     echo "Namespace setup complete."
 }
 
+# Applies a topology profile to both ends of the veth pair.
+apply_topology() {
+    local name="$1"
+    local spec="${TOPOLOGY_PROFILES[$name]:-}"
+    if [[ "$name" == *:* ]]; then
+        spec="${name#*:}"
+    fi
+    if [[ -z "$spec" ]]; then
+        echo "Unknown topology '$name' (known: ${!TOPOLOGY_PROFILES[*]}, or name:delay/jitter/loss/rate)"
+        exit 1
+    fi
+    local delay jitter loss rate
+    IFS=/ read -r delay jitter loss rate <<< "$spec"
+
+    local ns dev side_loss
+    for side in server client; do
+        if [[ "$side" == "server" ]]; then
+            ns="$SERVER_NS"; dev="$VETH_SERVER"; side_loss="$loss"
+        else
+            ns="$CLIENT_NS"; dev="$VETH_CLIENT"; side_loss="0%"
+        fi
+        ip netns exec "$ns" tc qdisc del dev "$dev" root &> /dev/null || true
+        if [[ "$delay" == "0ms" && "$side_loss" == "0%" && "$rate" == "none" ]]; then
+            # Bare veth; fq enforces SO_MAX_PACING_RATE on the sending side
+            if [[ "$side" == "server" && "${PACING_RATES[*]}" != "none" ]]; then
+                ip netns exec "$ns" tc qdisc add dev "$dev" root fq
+            fi
+            continue
+        fi
+        # Large limit: a 40 ms RTT at line rate queues thousands of packets
+        ip netns exec "$ns" tc qdisc add dev "$dev" root handle 1: netem \
+            delay "$delay" "$jitter" loss "$side_loss" limit 100000
+        if [[ "$rate" != "none" ]]; then
+            ip netns exec "$ns" tc qdisc add dev "$dev" parent 1: handle 2: tbf \
+                rate "$rate" burst 1mbit latency 100ms
+        fi
+    done
+    echo "Topology ${name%%:*}: delay $delay +-$jitter each way, loss $loss, rate $rate"
+    ip netns exec "$CLIENT_NS" ping -c 3 -q "$SERVER_IP" | tail -1
+}
+
 # Main Script
 if [[ $EUID -ne 0 ]]; then
    echo "This script requires root privileges. Please run with sudo."
@@ -65,18 +244,80 @@ cleanup
 setup_namespaces
 
 echo "--- Preparing for experiments ---"
-echo "Implementation,Threads,MsgSize_Bytes,Duration_s,Throughput_Gbps,Latency_us,Cycles,Instructions,L1_Cache_Misses,LLC_Misses,Branches,Branch_Misses,Context_Switches" > "$RESULTS_FILE"
-echo "Results will be stored in $RESULTS_FILE"
+echo "Implementation,Threads,MsgSize_Bytes,Duration_s,Throughput_Gbps,Latency_us,Cycles,Instructions,L1_Cache_Misses,LLC_Misses,Branches,Branch_Misses,Context_Switches,Payload,Schema,TX_Throughput_Gbps,TX_Latency_us,Topology,Pacing_Rate,P99_Latency_us,Jitter_us,TLS,Deserialize,Deserialize_us,Workers,Queue,Pipeline_Gbps,Handoff_p99_us,Producers,Lean,Server_Mem_Per_Conn_KB,Server_Conn_Per_GB,Client_Mem_Per_Conn_KB,Client_Conn_Per_GB,Coro,Sched_ns_per_resume,RunId" > "$RESULTS_FILE"
+echo "Results will be stored in $RESULTS_FILE (run metadata in $METADATA_FILE, session $SESSION_ID)"
+check_host_settings
 
-for impl in two_copy one_copy zero_copy; do
+for topology in "${TOPOLOGIES[@]}"; do
+apply_topology "$topology"
+topology_name="${topology%%:*}"
+
+for impl in "${IMPLEMENTATIONS[@]}"; do
     SERVER_EXE="${impl}_server"
     CLIENT_EXE="${impl}_client"
 
+    for schema in "${SCHEMAS[@]}"; do
+    for payload in "${PAYLOAD_MODES[@]}"; do
+    for pacing in "${PACING_RATES[@]}"; do
     for threads in "${THREAD_COUNTS[@]}"; do
+        if [[ "$impl" == "xdp" && "$threads" -ne 1 ]]; then
+            continue
+        fi
         for size in "${MESSAGE_SIZES[@]}"; do
-            echo "--- Running: Impl=$impl, Threads=$threads, Size=$size ---"
+            echo "--- Running: Impl=$impl, Threads=$threads, Size=$size, Payload=$payload, Schema=$schema, Topology=$topology_name, Pacing=$pacing ---"
+
+            RUN_SEQ=$((RUN_SEQ + 1))
+            RUN_ID="${SESSION_ID}-$(printf '%04d' "$RUN_SEQ")"
+            SERVER_ARGS=()
+            CLIENT_ARGS=()
+            RUN_TAG="${topology_name}_${impl}_${schema//[:\/]/-}_${payload}_${pacing}_${threads}t_${size}B"
+            if [[ -n "$TRACE_DIR" ]]; then
+                mkdir -p "$TRACE_DIR"
+                SERVER_ARGS+=(-T "$TRACE_DIR/${RUN_TAG}_server.trace")
+                CLIENT_ARGS+=(-T "$TRACE_DIR/${RUN_TAG}_client.trace")
+            fi
+            if [[ "$pacing" != "none" ]]; then
+                SERVER_ARGS+=(-r "$pacing" --pacing "$PACING_MODE")
+            fi
+            if [[ "$PRODUCERS" -gt 0 && ( "$impl" == "one_copy" || "$impl" == "zero_copy" ) ]]; then
+                SERVER_ARGS+=(--producers "$PRODUCERS")
+            fi
+            if [[ "$TLS" == "1" ]]; then
+                SERVER_ARGS+=(--tls)
+                CLIENT_ARGS+=(--tls)
+            fi
+            if [[ "$LEAN" == "1" ]]; then
+                SERVER_ARGS+=(--lean)
+                CLIENT_ARGS+=(--lean)
+            fi
+            if [[ "$CORO" -gt 0 ]]; then
+                CLIENT_ARGS+=(--coro "$CORO")
+            fi
+            if [[ -n "$DESERIALIZE" ]]; then
+                CLIENT_ARGS+=(--deserialize "$DESERIALIZE" -f "$schema")
+            fi
+            if [[ "$WORKERS" -gt 0 ]]; then
+                CLIENT_ARGS+=(-W "$WORKERS" --queue "$QUEUE" --work-ns "$WORK_NS")
+            fi
+            if [[ "$DUPLEX" == "1" ]]; then
+                CLIENT_ARGS+=(-D)
+            fi
+            if [[ -n "$TCP_INFO_DIR" ]]; then
+                mkdir -p "$TCP_INFO_DIR"
+                SERVER_ARGS+=(-I "$TCP_INFO_DIR/${RUN_TAG}_server.csv" --tcp-info-ms "$TCP_INFO_MS")
+                CLIENT_ARGS+=(-I "$TCP_INFO_DIR/${RUN_TAG}_client.csv" --tcp-info-ms "$TCP_INFO_MS")
+            fi
+            if [[ "$impl" == "xdp" ]]; then
+                # The AF_XDP pair only takes its interface, XDP mode and rate
+                SERVER_ARGS=(-i "$VETH_SERVER" --xdp-mode "$XDP_MODE")
+                CLIENT_ARGS=(-i "$VETH_CLIENT" --xdp-mode "$XDP_MODE")
+                if [[ "$pacing" != "none" ]]; then
+                    SERVER_ARGS+=(-r "$pacing")
+                fi
+            fi
 
-            ip netns exec "$SERVER_NS" ./"$SERVER_EXE" &
+            SERVER_LOG=$(mktemp)
+            ip netns exec "$SERVER_NS" ./"$SERVER_EXE" "${SERVER_ARGS[@]}" -p "$payload" -f "$schema" "$size" "$DURATION" > "$SERVER_LOG" 2>&1 &
             SERVER_PID=$!
             sleep 1
 
@@ -84,14 +325,35 @@ for impl in two_copy one_copy zero_copy; do
             ALL_OUTPUT=$(ip netns exec "$CLIENT_NS" perf stat \
                 -x, \
                 -e cycles,instructions,L1-dcache-load-misses,LLC-load-misses,branches,branch-misses,context-switches \
-                ./"$CLIENT_EXE" "$SERVER_IP" "$threads" "$size" "$DURATION" 2>&1)
+                ./"$CLIENT_EXE" "${CLIENT_ARGS[@]}" "$SERVER_IP" "$threads" "$size" "$DURATION" 2>&1)
 
+            # The server reports its memory once the last connection has closed
+            for _ in {1..10}; do
+                grep -q "^Server Connection Density" "$SERVER_LOG" && break
+                sleep 0.1
+            done
             kill "$SERVER_PID" 2>/dev/null || true
             wait "$SERVER_PID" 2>/dev/null || true
+            SERVER_OUTPUT=$(cat "$SERVER_LOG")
+            rm -f "$SERVER_LOG"
+            echo "$SERVER_OUTPUT"
 
             # Parse client output
-            THROUGHPUT=$(echo "$ALL_OUTPUT" | grep "Throughput" | awk '{print $2}')
-            LATENCY=$(echo "$ALL_OUTPUT" | grep "Average Latency" | awk '{print $3}')
+            THROUGHPUT=$(echo "$ALL_OUTPUT" | grep "^Throughput" | awk '{print $2}')
+            TX_THROUGHPUT=$(echo "$ALL_OUTPUT" | grep "^TX Throughput" | awk '{print $3}')
+            TX_LATENCY=$(echo "$ALL_OUTPUT" | grep "^TX Average Latency" | awk '{print $4}')
+            LATENCY=$(echo "$ALL_OUTPUT" | grep "^Average Latency" | awk '{print $3}')
+            P99_LATENCY=$(echo "$ALL_OUTPUT" | grep "^P99 Latency" | awk '{print $3}')
+            JITTER=$(echo "$ALL_OUTPUT" | grep "^Interarrival Jitter" | awk '{print $3}')
+            DESER_COST=$(echo "$ALL_OUTPUT" | grep "^Deserialize Cost" | awk '{print $3}')
+            PIPELINE_GBPS=$(echo "$ALL_OUTPUT" | grep "^Pipeline Throughput" | awk '{print $3}')
+            HANDOFF_P99=$(echo "$ALL_OUTPUT" | grep "^Handoff Latency" | awk '{print $10}')
+            CLIENT_META=$(echo "$ALL_OUTPUT" | sed -n 's/^Run Metadata: //p' | head -1)
+            CLIENT_MEM_KB=$(echo "$ALL_OUTPUT" | grep "^Memory per Connection" | awk '{print $4}')
+            CLIENT_CONN_PER_GB=$(echo "$ALL_OUTPUT" | grep "^Connection Density" | awk '{print $3}')
+            SCHED_NS=$(echo "$ALL_OUTPUT" | grep "^Scheduler Overhead" | awk '{print $3}')
+            SERVER_MEM_KB=$(echo "$SERVER_OUTPUT" | grep "^Server Memory per Connection" | awk '{print $5}')
+            SERVER_CONN_PER_GB=$(echo "$SERVER_OUTPUT" | grep "^Server Connection Density" | awk '{print $4}')
 
             # Parse perf metrics (CSV format: value,,event_name,...)
             parse_metric() {
@@ -112,6 +374,8 @@ for impl in two_copy one_copy zero_copy; do
 
             # Default to N/A if empty
             THROUGHPUT=${THROUGHPUT:-"N/A"}
+            TX_THROUGHPUT=${TX_THROUGHPUT:-"N/A"}
+            TX_LATENCY=${TX_LATENCY:-"N/A"}
             LATENCY=${LATENCY:-"N/A"}
             CYCLES=${CYCLES:-"N/A"}
             L1_CACHE_MISSES=${L1_CACHE_MISSES:-"N/A"}
@@ -121,13 +385,26 @@ for impl in two_copy one_copy zero_copy; do
             BRANCH_MISSES=${BRANCH_MISSES:-"N/A"}
             CONTEXT_SWITCHES=${CONTEXT_SWITCHES:-"N/A"}
 
-            echo "$impl,$threads,$size,$DURATION,$THROUGHPUT,$LATENCY,$CYCLES,$INSTRUCTIONS,$L1_CACHE_MISSES,$LLC_MISSES,$BRANCHES,$BRANCH_MISSES,$CONTEXT_SWITCHES" >> "$RESULTS_FILE"
+            echo "$impl,$threads,$size,$DURATION,$THROUGHPUT,$LATENCY,$CYCLES,$INSTRUCTIONS,$L1_CACHE_MISSES,$LLC_MISSES,$BRANCHES,$BRANCH_MISSES,$CONTEXT_SWITCHES,$payload,$schema,$TX_THROUGHPUT,$TX_LATENCY,$topology_name,$pacing,$P99_LATENCY,$JITTER,$TLS,${DESERIALIZE:-none},$DESER_COST,$WORKERS,$QUEUE,$PIPELINE_GBPS,$HANDOFF_P99,$PRODUCERS,$LEAN,${SERVER_MEM_KB:-N/A},${SERVER_CONN_PER_GB:-N/A},${CLIENT_MEM_KB:-N/A},${CLIENT_CONN_PER_GB:-N/A},$CORO,${SCHED_NS:-N/A},$RUN_ID" >> "$RESULTS_FILE"
+            printf '{"record":"run","run_id":"%s","session":"%s","impl":"%s","threads":%d,"msg_size":%d,"duration":%d,"payload":"%s","schema":"%s","topology":"%s","pacing":"%s","server_args":"%s","client_args":"%s","client":%s}\n' \
+                "$RUN_ID" "$SESSION_ID" "$impl" "$threads" "$size" "$DURATION" "$payload" "$schema" "$topology_name" "$pacing" \
+                "${SERVER_ARGS[*]}" "${CLIENT_ARGS[*]}" "${CLIENT_META:-null}" >> "$METADATA_FILE"
             
-            echo "TP: $THROUGHPUT Gbps, Lat: $LATENCY us, Cyc: $CYCLES, Inst: $INSTRUCTIONS"
+            echo "TP: $THROUGHPUT Gbps, Lat: $LATENCY us (p99 $P99_LATENCY), Cyc: $CYCLES, Inst: $INSTRUCTIONS"
             sleep 1
         done
     done
+    done
+    done
+    done
+done
 done
 
 echo "--- All experiments complete ---"
+
+# Scalability summary: contention/coherency coefficients and peak concurrency
+if python3 -c 'import numpy' &> /dev/null; then
+    echo "--- Universal Scalability Law fit ($CORES cores) ---"
+    python3 MT25043_Part_D_Usl.py "$RESULTS_FILE" || true
+fi
 exit 0
@@ -7,7 +7,19 @@ This script generates performance comparison plots for three socket communicatio
 2. One-Copy (sendmsg with iovec scatter-gather)
 3. Zero-Copy (sendmsg with MSG_ZEROCOPY)
 
-All experimental data is hardcoded (not read from CSV) as per assignment requirements.
+With no arguments the plots use the hardcoded data below (as per assignment
+requirements). Given one or more results CSVs from MT25043_Part_C_Script.sh,
+the plots are drawn from the CSVs instead: repeated trials of the same
+(implementation, message size, threads) point are averaged and drawn with
+standard-deviation error bars. With --baseline, every point is compared
+against a stored baseline run, and the script exits with status 1 if any
+throughput or p99 latency regressed by more than the threshold.
+
+Usage:
+    python3 MT25043_Part_D_Plotting.py
+    python3 MT25043_Part_D_Plotting.py run1.csv run2.csv run3.csv
+    python3 MT25043_Part_D_Plotting.py new.csv --baseline baseline.csv --threshold 5
+    python3 MT25043_Part_D_Plotting.py new.csv --baseline baseline.csv --no-plots --where Topology=lan
 
 ================================================================================
 AI USAGE DECLARATION
@@ -54,6 +66,11 @@ Date: February 2026
 # Library Imports
 # ============================================================================
 
+import argparse
+import csv
+import sys
+from collections import defaultdict
+
 import matplotlib
 matplotlib.use('Agg')  # Use non-interactive backend for headless plot generation
 import matplotlib.pyplot as plt
@@ -129,6 +146,143 @@ data = {
     }
 }
 
+# ============================================================================
+# CSV Loading and Aggregation
+# ============================================================================
+
+# Metric name in the data dictionary -> column in the results CSV
+# (cache_misses are LLC misses, matching the hardcoded data above)
+CSV_METRICS = {
+    'throughput': 'Throughput_Gbps',
+    'latency': 'Latency_us',
+    'p99_latency': 'P99_Latency_us',
+    'cpu_cycles': 'Cycles',
+    'instructions': 'Instructions',
+    'cache_misses': 'LLC_Misses',
+    'branches': 'Branches',
+    'branch_misses': 'Branch_Misses',
+    'context_switches': 'Context_Switches',
+    'conn_per_gb': 'Server_Conn_Per_GB',
+}
+
+# Configuration columns that must not differ between the trials of a point
+CONFIG_COLUMNS = ['Payload', 'Schema', 'Topology', 'Pacing_Rate', 'TLS', 'Deserialize',
+                  'Workers', 'Queue', 'Producers', 'Lean', 'Coro']
+
+
+def load_results(paths, where):
+    """
+    Read one or more results CSVs and aggregate repeated trials.
+
+    Rows are grouped by (implementation, message size, threads). Every group
+    becomes one data point holding the mean of each metric, its standard
+    deviation ('<metric>_std') and the number of trials. Missing values
+    ('N/A' when a run or perf counter failed) are left out of the mean.
+
+    Args:
+        paths (list): Results CSV files written by MT25043_Part_C_Script.sh
+        where (list): 'Column=Value' filters; rows must match all of them
+
+    Returns:
+        dict: Same layout as the hardcoded data (implementation -> metric ->
+              array), sorted by thread count then message size
+    """
+    filters = [w.split('=', 1) for w in where]
+    groups = defaultdict(list)
+    for path in paths:
+        with open(path, newline='') as f:
+            for row in csv.DictReader(f):
+                if any(row.get(col) != value for col, value in filters):
+                    continue
+                try:
+                    key = (row['Implementation'], int(row['MsgSize_Bytes']), int(row['Threads']))
+                except (KeyError, ValueError):
+                    continue
+                groups[key].append(row)
+
+    results = {}
+    for (impl, size, threads) in sorted(groups, key=lambda k: (k[0], k[2], k[1])):
+        rows = groups[(impl, size, threads)]
+        mixed = [c for c in CONFIG_COLUMNS if len({r.get(c) for r in rows}) > 1]
+        if mixed:
+            print(f'warning: {impl} {size} B {threads} threads averages trials with different '
+                  f'{", ".join(mixed)}; narrow with --where', file=sys.stderr)
+        metrics = results.setdefault(impl, defaultdict(list))
+        metrics['threads'].append(threads)
+        metrics['msg_size'].append(size)
+        metrics['trials'].append(len(rows))
+        for name, column in CSV_METRICS.items():
+            values = []
+            for r in rows:
+                try:
+                    values.append(float(r.get(column)))
+                except (TypeError, ValueError):
+                    pass
+            metrics[name].append(float(np.mean(values)) if values else np.nan)
+            metrics[name + '_std'].append(float(np.std(values, ddof=1)) if len(values) > 1 else 0.0)
+    return results
+
+
+def has_metric(data, name):
+    """True if any implementation has a positive value for the metric (perf may have been unavailable)."""
+    return any(np.nan_to_num(np.asarray(m.get(name, []), dtype=float)).max(initial=0) > 0 for m in data.values())
+
+
+def error_bars(metrics, name, indices):
+    """Standard deviations for the selected points, or None when there are none."""
+    if name + '_std' not in metrics:
+        return None
+    return [metrics[name + '_std'][i] for i in indices]
+
+
+# ============================================================================
+# Baseline Comparison
+# ============================================================================
+
+def compare_to_baseline(current, baseline, threshold_pct):
+    """
+    Compare every (implementation, message size, threads) point present in
+    both runs. A point regresses when its throughput drops, or its p99
+    latency rises, by more than threshold_pct percent; moves of the same size
+    in the good direction are listed as improvements. A point whose run
+    failed (N/A) or that is missing from the current run also regresses.
+
+    Returns:
+        int: Number of regressed points
+    """
+    def points(data):
+        out = {}
+        for impl, m in data.items():
+            for i in range(len(m['threads'])):
+                out[(impl, m['msg_size'][i], m['threads'][i])] = (m['throughput'][i], m['p99_latency'][i])
+        return out
+
+    cur, base = points(current), points(baseline)
+    common = sorted(set(cur) & set(base), key=lambda k: (k[0], k[2], k[1]))
+    regressions = 0
+    print(f'Baseline comparison ({len(common)} common points, threshold {threshold_pct:g}%):')
+    print(f'  {"implementation":<16}{"size":>8}{"thr":>5}{"Gbps":>10}{"base":>10}{"change":>9}'
+          f'{"p99 us":>11}{"base":>11}{"change":>9}  verdict')
+    for key in common:
+        (tp, p99), (base_tp, base_p99) = cur[key], base[key]
+        tp_change = 100.0 * (tp - base_tp) / base_tp if base_tp > 0 else np.nan
+        p99_change = 100.0 * (p99 - base_p99) / base_p99 if base_p99 > 0 else np.nan
+        # NaN fails every comparison, so a failed run must be caught explicitly
+        failed = (np.isnan(tp) and not np.isnan(base_tp)) or (np.isnan(p99) and not np.isnan(base_p99))
+        worse = failed or tp_change < -threshold_pct or p99_change > threshold_pct
+        better = tp_change > threshold_pct or p99_change < -threshold_pct
+        verdict = 'REGRESSION (failed)' if failed else ('REGRESSION' if worse else ('improved' if better else 'ok'))
+        regressions += worse
+        print(f'  {key[0]:<16}{key[1]:>8}{key[2]:>5}{tp:>10.3f}{base_tp:>10.3f}{tp_change:>8.1f}%'
+              f'{p99:>11.2f}{base_p99:>11.2f}{p99_change:>8.1f}%  {verdict}')
+    missing = sorted(set(base) - set(cur), key=lambda k: (k[0], k[2], k[1]))
+    for key in missing:
+        print(f'  {key[0]:<16}{key[1]:>8}{key[2]:>5}  REGRESSION (missing from this run)')
+    regressions += len(missing)
+    print(f'{regressions} regression(s)')
+    return regressions
+
+
 # ============================================================================
 # Plotting Functions
 # ============================================================================
@@ -164,7 +318,9 @@ def plot_throughput_vs_msg_size(data):
         throughputs = [metrics['throughput'][i] for i in indices]
         
         # Plot line with markers: 'o' = circle markers, '-' = solid line
-        plt.plot(msg_sizes, throughputs, marker='o', linestyle='-', label=impl)
+        # (error bars show the spread of repeated trials when read from CSV)
+        plt.errorbar(msg_sizes, throughputs, yerr=error_bars(metrics, 'throughput', indices),
+                     marker='o', linestyle='-', capsize=3, label=impl)
 
     # Set plot title with dynamic thread count value
     plt.title(f'Throughput vs. Message Size ({thread_count_to_plot} Threads)')
@@ -228,7 +384,8 @@ def plot_latency_vs_thread_count(data):
         latencies = [metrics['latency'][i] for i in indices]
         
         # Plot with markers and connecting lines
-        plt.plot(threads, latencies, marker='o', linestyle='-', label=impl)
+        plt.errorbar(threads, latencies, yerr=error_bars(metrics, 'latency', indices),
+                     marker='o', linestyle='-', capsize=3, label=impl)
 
     # Set descriptive title
     plt.title(f'Latency vs. Thread Count (Message Size: {msg_size_to_plot} Bytes)')
@@ -237,9 +394,9 @@ def plot_latency_vs_thread_count(data):
     plt.xlabel('Number of Threads')
     plt.ylabel('Average Latency (µs)')  # µs = microseconds
     
-    # Set X-axis ticks to show all thread counts (1, 2, 4, 8)
+    # Set X-axis ticks to show every measured thread count
     # Extract unique thread counts from data and sort them
-    plt.xticks(sorted(list(set(data['two_copy']['threads']))))
+    plt.xticks(sorted({t for metrics in data.values() for t in metrics['threads']}))
     
     # Add grid for readability
     plt.grid(True, which="both", ls="--")
@@ -291,7 +448,8 @@ def plot_cache_misses_vs_msg_size(data):
         cache_misses = [metrics['cache_misses'][i] for i in indices]
 
         # Plot data
-        plt.plot(msg_sizes, cache_misses, marker='o', linestyle='-', label=impl)
+        plt.errorbar(msg_sizes, cache_misses, yerr=error_bars(metrics, 'cache_misses', indices),
+                     marker='o', linestyle='-', capsize=3, label=impl)
 
     # Set title
     plt.title(f'Cache Misses vs. Message Size ({thread_count_to_plot} Threads)')
@@ -360,8 +518,11 @@ def plot_cpu_cycles_per_byte(data):
         # Lower values = more efficient (less CPU work per byte)
         cycles_per_byte = cpu_cycles / msg_sizes
 
-        # Plot efficiency metric
-        plt.plot(msg_sizes, cycles_per_byte, marker='o', linestyle='-', label=impl)
+        # Plot efficiency metric (the spread scales like the cycles)
+        yerr = error_bars(metrics, 'cpu_cycles', indices)
+        if yerr is not None:
+            yerr = np.array(yerr) / msg_sizes
+        plt.errorbar(msg_sizes, cycles_per_byte, yerr=yerr, marker='o', linestyle='-', capsize=3, label=impl)
 
     # Set title
     plt.title(f'CPU Cycles per Byte vs. Message Size ({thread_count_to_plot} Threads)')
@@ -394,6 +555,45 @@ def plot_cpu_cycles_per_byte(data):
     plt.close()
 
 
+def plot_connection_density(data):
+    """
+    Generate plot: Server Connection Density vs. Thread Count
+
+    Purpose: Compare how many connections each implementation fits in a GB
+    of server memory (user RSS, kernel socket memory and pinned pages, see
+    MT25043_Memory.h); higher is better
+    Fixed Parameter: 16KB message size
+    Variable: Thread count (one connection per client thread)
+
+    Args:
+        data (dict): Results loaded from CSVs with a Server_Conn_Per_GB column
+
+    Output:
+        connection_density.png - Saved to current directory
+    """
+    plt.figure(figsize=(10, 6))
+    msg_size_to_plot = 16384
+
+    for impl, metrics in data.items():
+        indices = [i for i, s in enumerate(metrics['msg_size']) if s == msg_size_to_plot]
+        threads = [metrics['threads'][i] for i in indices]
+        density = [metrics['conn_per_gb'][i] for i in indices]
+        plt.errorbar(threads, density, yerr=error_bars(metrics, 'conn_per_gb', indices),
+                     marker='o', linestyle='-', capsize=3, label=impl)
+
+    plt.title(f'Server Connection Density vs. Thread Count (Message Size: {msg_size_to_plot} Bytes)')
+    plt.xlabel('Number of Threads (Connections)')
+    plt.ylabel('Connections per GB')
+    plt.xticks(sorted({t for metrics in data.values() for t in metrics['threads']}))
+    plt.grid(True, which="both", ls="--")
+    plt.legend()
+    plt.figtext(0.99, 0.01, SYSTEM_CONFIG, horizontalalignment='right',
+                fontsize=8, multialignment='left', linespacing=1.5)
+    plt.tight_layout(rect=[0, 0.1, 1, 0.95])
+    plt.savefig('connection_density.png')
+    plt.close()
+
+
 # ============================================================================
 # Main Execution
 # ============================================================================
@@ -401,26 +601,63 @@ def plot_cpu_cycles_per_byte(data):
 if __name__ == '__main__':
     """
     Main entry point for plot generation.
-    Generates all four required plots for the assignment.
+    Generates all four required plots for the assignment, from the CSVs
+    given on the command line or from the hardcoded data, then compares
+    against a baseline if one is given.
     """
-    print("Generating plots...")
-    
-    # Generate Plot 1: Throughput vs Message Size
-    plot_throughput_vs_msg_size(data)
-    print("✓ throughput_vs_msg_size.png generated")
-    
-    # Generate Plot 2: Latency vs Thread Count
-    plot_latency_vs_thread_count(data)
-    print("✓ latency_vs_thread_count.png generated")
-    
-    # Generate Plot 3: Cache Misses vs Message Size
-    plot_cache_misses_vs_msg_size(data)
-    print("✓ cache_misses_vs_msg_size.png generated")
-    
-    # Generate Plot 4: CPU Cycles per Byte
-    plot_cpu_cycles_per_byte(data)
-    print("✓ cpu_cycles_per_byte.png generated")
-    
-    print("\nAll plots generated successfully!")
-    print("Output files: throughput_vs_msg_size.png, latency_vs_thread_count.png,")
-    print("              cache_misses_vs_msg_size.png, cpu_cycles_per_byte.png")
+    parser = argparse.ArgumentParser(description='Plot MT25043 results and check them against a baseline')
+    parser.add_argument('results', nargs='*', help='Results CSVs (default: hardcoded data)')
+    parser.add_argument('--baseline', nargs='+', metavar='CSV', help='Baseline results CSVs to compare against')
+    parser.add_argument('--threshold', type=float, default=5.0,
+                        help='Regression threshold in percent for throughput and p99 latency (default 5)')
+    parser.add_argument('--where', action='append', default=[], metavar='COLUMN=VALUE',
+                        help='Only use CSV rows with this column value (repeatable)')
+    parser.add_argument('--no-plots', action='store_true', help='Skip the plots (baseline check only)')
+    args = parser.parse_args()
+
+    if args.results:
+        data = load_results(args.results, args.where)
+        if not data:
+            sys.exit('No results matched in ' + ', '.join(args.results))
+    elif args.baseline:
+        parser.error('--baseline needs results CSVs to compare')
+
+    if not args.no_plots:
+        print("Generating plots...")
+        
+        # Generate Plot 1: Throughput vs Message Size
+        plot_throughput_vs_msg_size(data)
+        print("✓ throughput_vs_msg_size.png generated")
+        
+        # Generate Plot 2: Latency vs Thread Count
+        plot_latency_vs_thread_count(data)
+        print("✓ latency_vs_thread_count.png generated")
+        
+        # Generate Plot 3: Cache Misses vs Message Size (log scale: needs perf counters)
+        if has_metric(data, 'cache_misses'):
+            plot_cache_misses_vs_msg_size(data)
+            print("✓ cache_misses_vs_msg_size.png generated")
+        else:
+            print("- cache_misses_vs_msg_size.png skipped (no LLC_Misses in results)")
+        
+        # Generate Plot 4: CPU Cycles per Byte
+        if has_metric(data, 'cpu_cycles'):
+            plot_cpu_cycles_per_byte(data)
+            print("✓ cpu_cycles_per_byte.png generated")
+        else:
+            print("- cpu_cycles_per_byte.png skipped (no Cycles in results)")
+
+        # Generate Plot 5: Connection Density (results CSVs with memory accounting only)
+        if has_metric(data, 'conn_per_gb'):
+            plot_connection_density(data)
+            print("✓ connection_density.png generated")
+        
+        print("\nAll plots generated successfully!")
+        print("Output files: throughput_vs_msg_size.png, latency_vs_thread_count.png,")
+        print("              cache_misses_vs_msg_size.png, cpu_cycles_per_byte.png")
+
+    # Regression gate: non-zero exit status when any point got worse
+    if args.baseline:
+        baseline = load_results(args.baseline, args.where)
+        if compare_to_baseline(data, baseline, args.threshold) > 0:
+            sys.exit(1)
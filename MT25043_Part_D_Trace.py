@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""
+MT25043 - Programming Assignment 02 - Part D: Trace Conversion
+
+Reads binary traces written by the servers and clients (-T FILE, see
+MT25043_Trace.h) and either converts them to the Chrome trace / Perfetto
+JSON format or prints a per-phase time breakdown.
+
+Usage:
+    python3 MT25043_Part_D_Trace.py server.trace client.trace -o trace.json
+    python3 MT25043_Part_D_Trace.py --summary *.trace
+
+Open the JSON in https://ui.perfetto.dev or chrome://tracing. Each input
+file becomes one process named after the binary that wrote it.
+"""
+
+import argparse
+import json
+import struct
+import sys
+from collections import defaultdict
+
+# Must match trace_type_t in MT25043_Trace.h
+EVENT_NAMES = [
+    ('send', 'B'), ('send', 'E'),
+    ('errqueue', 'B'), ('errqueue', 'E'),
+    ('completion', 'i'),
+    ('recv', 'B'), ('recv', 'E'),
+    ('clock', 'B'), ('clock', 'E'),
+    ('fill', 'B'), ('fill', 'E'),
+    ('verify', 'B'), ('verify', 'E'),
+]
+
+# The hybrid server records its strategy in the arg of each send BEGIN
+HYBRID_STRATEGIES = ['copy', 'sendmsg', 'zerocopy']
+
+FILE_HEADER = struct.Struct('<8sIIdQQ32s')
+RING_HEADER = struct.Struct('<IiQQ')
+EVENT = struct.Struct('<QQII')
+
+
+def read_trace(path):
+    """Returns (label, ticks_per_ns, base_tsc, [(thread, sock, dropped, events)])."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, num_threads, _, ticks_per_ns, base_tsc, _, label = FILE_HEADER.unpack_from(data, 0)
+    if magic != b'MT25TRC1':
+        sys.exit(f'{path}: not an MT25043 trace')
+    label = label.split(b'\0', 1)[0].decode()
+    offset = FILE_HEADER.size
+    threads = []
+    for _ in range(num_threads):
+        thread, sock, count, dropped = RING_HEADER.unpack_from(data, offset)
+        offset += RING_HEADER.size
+        events = [EVENT.unpack_from(data, offset + i * EVENT.size) for i in range(count)]
+        offset += count * EVENT.size
+        threads.append((thread, sock, dropped, events))
+    return label, ticks_per_ns, base_tsc, threads
+
+
+def phases(label, events):
+    """Yields (name, begin_tsc, end_tsc, end_arg) for every matched BEGIN/END pair."""
+    open_phase = {}
+    for tsc, arg, etype, _ in events:
+        if etype >= len(EVENT_NAMES):
+            continue
+        name, kind = EVENT_NAMES[etype]
+        if kind == 'B':
+            if name == 'send' and label.startswith('hybrid') and arg < len(HYBRID_STRATEGIES):
+                name = 'send:' + HYBRID_STRATEGIES[arg]
+            open_phase[EVENT_NAMES[etype][0]] = (name, tsc)
+        elif kind == 'E':
+            # An END without BEGIN belongs to a phase overwritten in the ring
+            begun = open_phase.pop(name, None)
+            if begun is not None:
+                yield begun[0], begun[1], tsc, arg
+
+
+def to_chrome(paths, output):
+    trace_events = []
+    for pid, path in enumerate(paths):
+        label, ticks_per_ns, base_tsc, threads = read_trace(path)
+        trace_events.append({'name': 'process_name', 'ph': 'M', 'pid': pid,
+                             'args': {'name': label}})
+
+        def us(tsc):
+            return (tsc - base_tsc) / ticks_per_ns / 1000.0
+
+        for thread, sock, dropped, events in threads:
+            trace_events.append({'name': 'thread_name', 'ph': 'M', 'pid': pid, 'tid': thread,
+                                 'args': {'name': f'socket {sock}'}})
+            for name, begin, end, arg in phases(label, events):
+                trace_events.append({'name': name, 'ph': 'X', 'pid': pid, 'tid': thread,
+                                     'ts': us(begin), 'dur': (end - begin) / ticks_per_ns / 1000.0,
+                                     'args': {'bytes': arg}})
+            for tsc, arg, etype, _ in events:
+                if etype < len(EVENT_NAMES) and EVENT_NAMES[etype][1] == 'i':
+                    trace_events.append({'name': EVENT_NAMES[etype][0], 'ph': 'i', 's': 't',
+                                         'pid': pid, 'tid': thread, 'ts': us(tsc),
+                                         'args': {'count': arg}})
+            if dropped:
+                print(f'{path}: thread {thread} lost {dropped} oldest events to ring wrap',
+                      file=sys.stderr)
+
+    with open(output, 'w') as f:
+        json.dump({'traceEvents': trace_events, 'displayTimeUnit': 'ns'}, f)
+    print(f'Wrote {len(trace_events)} events to {output}')
+
+
+def summary(paths):
+    """Prints, per binary, the share of traced thread time spent in each phase."""
+    for path in paths:
+        label, ticks_per_ns, _, threads = read_trace(path)
+        total_ns = 0.0
+        phase_ns = defaultdict(float)
+        phase_count = defaultdict(int)
+        phase_bytes = defaultdict(int)
+        for _, _, _, events in threads:
+            if len(events) < 2:
+                continue
+            total_ns += (events[-1][0] - events[0][0]) / ticks_per_ns
+            for name, begin, end, arg in phases(label, events):
+                phase_ns[name] += (end - begin) / ticks_per_ns
+                phase_count[name] += 1
+                phase_bytes[name] += arg
+        if total_ns == 0:
+            print(f'{label} ({path}): no events')
+            continue
+
+        print(f'{label} ({path}): {len(threads)} thread(s), {total_ns / 1e6:.3f} ms traced')
+        print(f'  {"phase":<18}{"calls":>12}{"total ms":>12}{"share":>9}{"avg ns":>11}{"ns/byte":>10}')
+        for name in sorted(phase_ns, key=phase_ns.get, reverse=True):
+            ns = phase_ns[name]
+            per_byte = f'{ns / phase_bytes[name]:.4f}' if phase_bytes[name] and name != 'fill' else '-'
+            print(f'  {name:<18}{phase_count[name]:>12}{ns / 1e6:>12.3f}{100 * ns / total_ns:>8.1f}%'
+                  f'{ns / phase_count[name]:>11.1f}{per_byte:>10}')
+        other = total_ns - sum(phase_ns.values())
+        print(f'  {"(untraced)":<18}{"":>12}{other / 1e6:>12.3f}{100 * other / total_ns:>8.1f}%')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert or summarize MT25043 hot-path traces')
+    parser.add_argument('traces', nargs='+', help='Binary trace files written with -T')
+    parser.add_argument('-o', '--output', default='trace.json', help='Chrome trace JSON output')
+    parser.add_argument('--summary', action='store_true', help='Print a per-phase time breakdown instead')
+    args = parser.parse_args()
+
+    if args.summary:
+        summary(args.traces)
+    else:
+        to_chrome(args.traces, args.output)
+
+
+if __name__ == '__main__':
+    main()
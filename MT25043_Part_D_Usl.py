@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""
+MT25043 - Programming Assignment 02 - Part D: Universal Scalability Law Fit
+
+Reads the results CSV written by MT25043_Part_C_Script.sh and fits the
+Universal Scalability Law to throughput versus thread (connection) count,
+separately for every implementation and configuration:
+
+    X(N) = lambda * N / (1 + sigma * (N - 1) + kappa * N * (N - 1))
+
+lambda is the single-thread throughput, sigma the contention (serialized
+fraction) and kappa the coherency (crosstalk) coefficient. With kappa > 0
+throughput peaks at N* = sqrt((1 - sigma) / kappa) and then falls; with
+kappa = 0 it only flattens towards lambda / sigma.
+
+Usage:
+    python3 MT25043_Part_D_Usl.py MT25043_Part_C_Results.csv
+    python3 MT25043_Part_D_Usl.py results.csv --size 65536 --plot usl_fit.png
+
+The fit is only meaningful when the sweep goes past the core count; the
+default THREAD_COUNTS of the script does that.
+"""
+
+import argparse
+import csv
+import math
+import sys
+from collections import defaultdict
+
+import numpy as np
+
+# Configuration columns that split the results into separate curves (only
+# those present in the CSV are used; older result files have fewer)
+CONFIG_COLUMNS = ['Implementation', 'MsgSize_Bytes', 'Payload', 'Schema', 'Topology', 'Pacing_Rate',
+                  'TLS', 'Deserialize', 'Workers', 'Queue', 'Producers', 'Lean', 'Coro']
+
+
+def load(path, size):
+    """Returns {config tuple: {threads: [throughput, ...]}} and the config column names."""
+    with open(path, newline='') as f:
+        rows = list(csv.DictReader(f))
+    if not rows:
+        sys.exit(f'{path}: no results')
+    columns = [c for c in CONFIG_COLUMNS if c in rows[0]]
+    groups = defaultdict(lambda: defaultdict(list))
+    for row in rows:
+        if size and row['MsgSize_Bytes'] != str(size):
+            continue
+        try:
+            threads = int(row['Threads'])
+            throughput = float(row['Throughput_Gbps'])
+        except (TypeError, ValueError):
+            continue                                # N/A: the run failed
+        if not throughput > 0:
+            continue                                # No data moved (or NaN): N / X(N) is undefined
+        groups[tuple(row[c] for c in columns)][threads].append(throughput)
+    return groups, columns
+
+
+def fit_usl(n, x):
+    """
+    Least-squares USL fit. N / X(N) = a + b (N - 1) + c N (N - 1) is linear in
+    a = 1/lambda, b = sigma/lambda and c = kappa/lambda. Negative coefficients
+    have no physical meaning, so the best fit with b, c >= 0 is taken from the
+    unconstrained fit and the fits with b and/or c pinned to zero.
+    Returns (lambda, sigma, kappa, r2) or None.
+    """
+    n = np.asarray(n, dtype=float)
+    x = np.asarray(x, dtype=float)
+    y = n / x
+    regressors = {'a': np.ones_like(n), 'b': n - 1, 'c': n * (n - 1)}
+    best = None
+    for terms in (('a', 'b', 'c'), ('a', 'b'), ('a', 'c'), ('a',)):
+        A = np.column_stack([regressors[t] for t in terms])
+        coef, _, _, _ = np.linalg.lstsq(A, y, rcond=None)
+        params = dict(zip(terms, coef))
+        a, b, c = params['a'], params.get('b', 0.0), params.get('c', 0.0)
+        if a <= 0 or b < 0 or c < 0:
+            continue
+        predicted = n / (a + b * (n - 1) + c * n * (n - 1))
+        sse = float(np.sum((x - predicted) ** 2))
+        if best is None or sse < best[0] - 1e-12:
+            best = (sse, a, b, c)
+    if best is None:
+        return None
+    sse, a, b, c = best
+    sst = float(np.sum((x - x.mean()) ** 2))
+    r2 = 1.0 - sse / sst if sst > 0 else 1.0
+    return 1.0 / a, b / a, c / a, r2
+
+
+def usl(n, lam, sigma, kappa):
+    return lam * n / (1 + sigma * (n - 1) + kappa * n * (n - 1))
+
+
+def peak(lam, sigma, kappa):
+    """Returns (N*, X(N*)); N* is None when the model never turns down."""
+    if kappa <= 0 or sigma >= 1:
+        return None, (lam / sigma if sigma > 0 else math.inf)
+    n_star = math.sqrt((1 - sigma) / kappa)
+    return n_star, usl(n_star, lam, sigma, kappa)
+
+
+def plot(fits, output):
+    import matplotlib
+    matplotlib.use('Agg')  # Non-interactive backend for headless plot generation
+    import matplotlib.pyplot as plt
+
+    plt.figure(figsize=(10, 6))
+    for label, n, x, (lam, sigma, kappa, _), n_star in fits:
+        top = max(n[-1], n_star or 0) * 1.25
+        curve_n = np.linspace(1, top, 200)
+        line, = plt.plot(curve_n, usl(curve_n, lam, sigma, kappa), linestyle='--')
+        plt.plot(n, x, marker='o', linestyle='', color=line.get_color(), label=label)
+        if n_star is not None:
+            plt.axvline(n_star, color=line.get_color(), linestyle=':', linewidth=1)
+    plt.title('Throughput vs. Thread Count with Universal Scalability Law fit')
+    plt.xlabel('Number of Threads (connections)')
+    plt.ylabel('Throughput (Gbps)')
+    plt.grid(True, which='both', ls='--')
+    plt.legend(fontsize=8)
+    plt.tight_layout()
+    plt.savefig(output)
+    plt.close()
+    print(f'Wrote {output}')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Fit the Universal Scalability Law to MT25043 results')
+    parser.add_argument('results', nargs='?', default='MT25043_Part_C_Results.csv', help='Results CSV')
+    parser.add_argument('--size', type=int, help='Only fit this message size (bytes)')
+    parser.add_argument('--plot', metavar='PNG', help='Also plot measured points and fitted curves')
+    args = parser.parse_args()
+
+    groups, columns = load(args.results, args.size)
+    # Only the columns that actually vary are worth printing
+    varying = [i for i, c in enumerate(columns) if len({k[i] for k in groups}) > 1 or c == 'Implementation']
+    fits = []
+
+    print(f'{"configuration":<40}{"N":>4}{"lambda Gbps":>13}{"sigma":>9}{"kappa":>10}{"R^2":>7}'
+          f'{"peak N*":>9}{"peak Gbps":>11}{"best meas.":>12}')
+    for key in sorted(groups, key=lambda k: tuple(int(v) if v.isdigit() else v for v in k)):
+        label = ' '.join(f'{columns[i]}={key[i]}' if columns[i] != 'Implementation' else key[i] for i in varying)
+        by_threads = groups[key]
+        n = sorted(by_threads)
+        x = [float(np.mean(by_threads[t])) for t in n]
+        best_n = n[int(np.argmax(x))]
+        measured = f'{max(x):.3f}@{best_n}'
+        if len(n) < 3:
+            print(f'{label:<40}{len(n):>4}  (needs at least 3 thread counts)')
+            continue
+        fit = fit_usl(n, x)
+        if fit is None:
+            print(f'{label:<40}{len(n):>4}  (no physical fit)')
+            continue
+        lam, sigma, kappa, r2 = fit
+        n_star, x_star = peak(lam, sigma, kappa)
+        peak_n = f'{n_star:.1f}' if n_star is not None else 'none'
+        print(f'{label:<40}{len(n):>4}{lam:>13.3f}{sigma:>9.4f}{kappa:>10.5f}{r2:>7.3f}'
+              f'{peak_n:>9}{x_star:>11.3f}{measured:>12}')
+        if n_star is not None and n_star > 2 * n[-1]:
+            print(f'{"":<40}    peak lies beyond 2x the largest measured count; extend THREAD_COUNTS')
+        fits.append((label, n, x, fit, n_star))
+
+    if args.plot and fits:
+        plot(fits, args.plot)
+
+
+if __name__ == '__main__':
+    main()
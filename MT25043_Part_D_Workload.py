@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""
+MT25043 - Programming Assignment 02 - Part D: Workload Traces
+
+Records real message-size and timing patterns into the compact binary
+workload trace that the servers replay with --replay FILE (see
+MT25043_Replay.h for the format), generates synthetic ones, and summarizes
+existing traces.
+
+A recording starts from a message log: a CSV with one message per line,
+its timestamp followed by the size of each field (a single size is a
+one-field message). Lines starting with '#' are skipped, and so is a
+header line. Timestamps are in seconds unless --unit says otherwise;
+only their differences matter.
+
+    1718000000.000000,64,1400
+    1718000000.000212,64,9000,32
+
+Usage:
+    python3 MT25043_Part_D_Workload.py record messages.csv -o app.trace
+    python3 MT25043_Part_D_Workload.py synthetic --rate 20000 --size 4096 -o poisson.trace
+    python3 MT25043_Part_D_Workload.py summary app.trace
+
+Then: ./one_copy_server --replay app.trace 8192 10
+      ./one_copy_client 127.0.0.1 1 <message_size> 10 -f framed:uniform:1 --deserialize view
+with message_size at least the largest message the server prints.
+"""
+
+import argparse
+import csv
+import math
+import random
+import struct
+import sys
+
+MAGIC = b'MT25WKL1'
+HEADER = struct.Struct('<8sIIQ')        # magic, num_layouts, reserved, num_records
+RECORD = struct.Struct('<QI')           # gap_ns, layout index
+MAX_FIELDS = 63                         # MAX_FIELDS - 1: field 0 is the frame header
+UNITS = {'s': 1e9, 'ms': 1e6, 'us': 1e3, 'ns': 1.0}
+
+
+def write_trace(path, messages):
+    """Writes [(gap_ns, (field sizes...)), ...], storing each distinct layout once."""
+    layouts = {}
+    records = []
+    for gap_ns, fields in messages:
+        records.append((gap_ns, layouts.setdefault(fields, len(layouts))))
+    with open(path, 'wb') as f:
+        f.write(HEADER.pack(MAGIC, len(layouts), 0, len(records)))
+        for fields in layouts:                  # dicts keep insertion order
+            f.write(struct.pack(f'<I{len(fields)}I', len(fields), *fields))
+        for gap_ns, layout in records:
+            f.write(RECORD.pack(gap_ns, layout))
+    print(f'{path}: {len(records)} messages, {len(layouts)} layouts, '
+          f'{HEADER.size + sum(4 + 4 * len(l) for l in layouts) + RECORD.size * len(records)} bytes')
+
+
+def read_trace(path):
+    """Returns [(gap_ns, (field sizes...)), ...]."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, num_layouts, _, num_records = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        sys.exit(f'{path}: not a workload trace')
+    pos = HEADER.size
+    layouts = []
+    for _ in range(num_layouts):
+        (n,) = struct.unpack_from('<I', data, pos)
+        layouts.append(struct.unpack_from(f'<{n}I', data, pos + 4))
+        pos += 4 + 4 * n
+    return [(gap_ns, layouts[layout]) for gap_ns, layout in
+            RECORD.iter_unpack(data[pos:pos + RECORD.size * num_records])]
+
+
+def record(args):
+    scale = UNITS[args.unit]
+    messages = []
+    previous = None
+    with open(args.log, newline='') as f:
+        for line, row in enumerate(csv.reader(f), 1):
+            if not row or row[0].lstrip().startswith('#'):
+                continue
+            try:
+                stamp = float(row[0]) * scale
+                fields = tuple(int(v) for v in row[1:] if v.strip())
+            except ValueError:
+                if line == 1:
+                    continue                    # Header line
+                sys.exit(f'{args.log}:{line}: expected timestamp,size[,size...]')
+            if not fields or len(fields) > MAX_FIELDS or min(fields) < 0:
+                sys.exit(f'{args.log}:{line}: 1 to {MAX_FIELDS} non-negative field sizes')
+            if previous is not None and stamp < previous:
+                sys.exit(f'{args.log}:{line}: timestamps go backwards')
+            gap_ns = 0 if previous is None else round((stamp - previous) / args.speed)
+            messages.append((gap_ns, fields))
+            previous = stamp
+    if not messages:
+        sys.exit(f'{args.log}: no messages')
+    write_trace(args.output, messages)
+
+
+def synthetic(args):
+    """Poisson arrivals at --rate, lognormal message sizes around --size."""
+    rng = random.Random(args.seed)
+    messages = []
+    for _ in range(args.count):
+        gap_ns = round(rng.expovariate(args.rate) * 1e9)
+        size = max(args.fields, round(rng.lognormvariate(math.log(args.size), args.sigma)))
+        size = min(size, args.max_size)
+        # A fixed small header field followed by the body split evenly
+        head = min(64, size // args.fields)
+        body = size - head
+        rest = [body // (args.fields - 1) + (i < body % (args.fields - 1)) for i in range(args.fields - 1)]
+        messages.append((gap_ns, tuple([head] + rest) if args.fields > 1 else (size,)))
+    write_trace(args.output, messages)
+
+
+def percentile(values, q):
+    return values[min(len(values) - 1, int(q * (len(values) - 1)))]
+
+
+def summary(args):
+    for path in args.traces:
+        messages = read_trace(path)
+        gaps = sorted(g for g, _ in messages[1:]) or [0]
+        sizes = sorted(sum(fields) for _, fields in messages)
+        span_s = sum(g for g, _ in messages) / 1e9
+        print(f'{path}: {len(messages)} messages over {span_s:.3f} s, '
+              f'{len(set(f for _, f in messages))} layouts')
+        if span_s > 0:
+            print(f'  rate    {len(messages) / span_s:.1f} msg/s, {sum(sizes) * 8 / span_s / 1e9:.3f} Gbps offered')
+        print(f'  size    min {sizes[0]}  p50 {percentile(sizes, 0.5)}  p99 {percentile(sizes, 0.99)}  '
+              f'max {sizes[-1]} bytes')
+        print(f'  gap     p50 {percentile(gaps, 0.5) / 1e3:.3f}  p99 {percentile(gaps, 0.99) / 1e3:.3f}  '
+              f'max {gaps[-1] / 1e3:.3f} us')
+        print(f'  fields  {min(len(f) for _, f in messages)} to {max(len(f) for _, f in messages)} per message')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Record, generate or summarize MT25043 workload traces')
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('record', help='Convert a message log (timestamp,size[,size...]) into a trace')
+    p.add_argument('log', help='CSV message log')
+    p.add_argument('-o', '--output', default='workload.trace', help='Trace output')
+    p.add_argument('--unit', choices=sorted(UNITS), default='s', help='Timestamp unit (default s)')
+    p.add_argument('--speed', type=float, default=1.0, help='Replay speed-up: gaps are divided by it')
+    p.set_defaults(run=record)
+
+    p = sub.add_parser('synthetic', help='Poisson arrivals with lognormal sizes')
+    p.add_argument('-o', '--output', default='workload.trace', help='Trace output')
+    p.add_argument('--count', type=int, default=100000, help='Messages (default 100000)')
+    p.add_argument('--rate', type=float, default=10000, help='Mean messages per second (default 10000)')
+    p.add_argument('--size', type=int, default=4096, help='Median message size in bytes (default 4096)')
+    p.add_argument('--sigma', type=float, default=1.0, help='Lognormal shape of the sizes (default 1.0)')
+    p.add_argument('--max-size', type=int, default=1 << 20, help='Largest message (default 1 MiB)')
+    p.add_argument('--fields', type=int, default=8, help='Fields per message (default 8)')
+    p.add_argument('--seed', type=int, default=25043, help='Random seed')
+    p.set_defaults(run=synthetic)
+
+    p = sub.add_parser('summary', help='Print rate, size and gap statistics of traces')
+    p.add_argument('traces', nargs='+', help='Trace files')
+    p.set_defaults(run=summary)
+
+    args = parser.parse_args()
+    if args.command == 'synthetic' and not 1 <= args.fields <= MAX_FIELDS:
+        sys.exit(f'--fields must be 1 to {MAX_FIELDS}')
+    if args.command == 'record' and args.speed <= 0:
+        sys.exit('--speed must be positive')
+    args.run(args)
+
+
+if __name__ == '__main__':
+    main()
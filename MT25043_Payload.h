@@ -0,0 +1,323 @@
+// MT25043
+//
+// File: MT25043_Payload.h
+//
+// Description: Payload generators that give every send fresh message
+// contents instead of the same cache-hot bytes.
+//
+// Modes:
+// - static  : one message built once (original behaviour, cache-hot)
+// - counter : fields rewritten before each send with a 64-bit counter fill
+// - random  : fields rewritten before each send with xorshift128+ output
+// - pool    : rotate through a shared pool of pre-built messages that is
+//             much larger than the last-level cache (cache-cold)
+//
+// The counter and random fills use AVX2 when the CPU supports it. When
+// checksums are enabled every message carries a CRC32C that stays valid
+// for as long as the message itself (pool checksums are precomputed).
+//
+// Static connections normally build a private copy of the message; given a
+// one-message pool (payload_shared_build, lean mode) they all send that one
+// read-only message instead.
+// ============================================================================
+
+#ifndef MT25043_PAYLOAD_H
+#define MT25043_PAYLOAD_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <immintrin.h>
+
+#include "MT25043_Message.h"
+#include "MT25043_Crc32c.h"
+
+#define PAYLOAD_POOL_MIN_BYTES (64L * 1024 * 1024)
+#define PAYLOAD_POOL_LLC_FACTOR 4 // Default pool is this many times the LLC
+
+typedef enum {
+    PAYLOAD_STATIC = 0,
+    PAYLOAD_COUNTER,
+    PAYLOAD_RANDOM,
+    PAYLOAD_POOL
+} payload_mode_t;
+
+static const char* const payload_mode_names[] = { "static", "counter", "random", "pool" };
+
+// Read-only pool of messages shared by every connection of a server.
+typedef struct {
+    message_t** msgs;
+    uint32_t* crcs;
+    int count;
+} payload_pool_t;
+
+// Per-connection generator state.
+typedef struct {
+    payload_mode_t mode;
+    const schema_t* schema;
+    message_t* msg;               // Private message for static/counter/random
+    const payload_pool_t* pool;   // Shared messages for pool mode
+    int index;
+    int checksum;                 // Maintain a CRC32C for every message
+    uint32_t crc;                 // Checksum of the private message
+    const uint32_t* crc_ptr;      // Checksum of the last returned message
+    uint64_t counter;
+    uint64_t rng[2][4];           // Four xorshift128+ lanes
+    long fills;
+    long fill_ns;
+} payload_t;
+
+static inline int parse_payload_mode(const char* name, payload_mode_t* mode) {
+    for (int i = 0; i < (int)(sizeof(payload_mode_names) / sizeof(payload_mode_names[0])); i++) {
+        if (strcasecmp(name, payload_mode_names[i]) == 0) {
+            *mode = (payload_mode_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline const char* payload_mode_name(payload_mode_t mode) {
+    return payload_mode_names[mode];
+}
+
+static inline size_t payload_default_pool_bytes(void) {
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    size_t bytes = llc > 0 ? (size_t)llc * PAYLOAD_POOL_LLC_FACTOR : 0;
+    return bytes > PAYLOAD_POOL_MIN_BYTES ? bytes : PAYLOAD_POOL_MIN_BYTES;
+}
+
+static inline uint64_t payload_splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// --- Fill kernels ---
+
+static inline void fill_counter_scalar(char* dst, size_t len, uint64_t* counter) {
+    uint64_t c = *counter;
+    size_t words = len / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t v = c++;
+        memcpy(dst + i * 8, &v, 8);
+    }
+    memset(dst + words * 8, (int)(c & 0xFF), len - words * 8);
+    *counter = c;
+}
+
+static inline __attribute__((target("avx2")))
+void fill_counter_avx2(char* dst, size_t len, uint64_t* counter) {
+    uint64_t c = *counter;
+    __m256i v = _mm256_set_epi64x((long long)(c + 3), (long long)(c + 2), (long long)(c + 1), (long long)c);
+    const __m256i step = _mm256_set1_epi64x(4);
+    while (len >= 32) {
+        _mm256_storeu_si256((__m256i*)dst, v);
+        v = _mm256_add_epi64(v, step);
+        dst += 32; len -= 32; c += 4;
+    }
+    *counter = c;
+    fill_counter_scalar(dst, len, counter);
+}
+
+static inline void fill_random_scalar(char* dst, size_t len, uint64_t rng[2][4]) {
+    // Lane 0 of the vector generator, so both paths produce valid streams
+    uint64_t s1 = rng[0][0], s0 = rng[1][0];
+    while (len > 0) {
+        uint64_t x = s1;
+        s1 = s0;
+        x ^= x << 23;
+        x ^= x >> 17;
+        x ^= s0 ^ (s0 >> 26);
+        s0 = x;
+        uint64_t out = s0 + s1;
+        size_t n = len < 8 ? len : 8;
+        memcpy(dst, &out, n);
+        dst += n; len -= n;
+    }
+    rng[0][0] = s1;
+    rng[1][0] = s0;
+}
+
+static inline __attribute__((target("avx2")))
+void fill_random_avx2(char* dst, size_t len, uint64_t rng[2][4]) {
+    __m256i s1 = _mm256_loadu_si256((const __m256i*)rng[0]);
+    __m256i s0 = _mm256_loadu_si256((const __m256i*)rng[1]);
+    while (len >= 32) {
+        __m256i x = s1;
+        s1 = s0;
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 23));
+        x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 17));
+        x = _mm256_xor_si256(x, _mm256_xor_si256(s0, _mm256_srli_epi64(s0, 26)));
+        s0 = x;
+        _mm256_storeu_si256((__m256i*)dst, _mm256_add_epi64(s0, s1));
+        dst += 32; len -= 32;
+    }
+    _mm256_storeu_si256((__m256i*)rng[0], s1);
+    _mm256_storeu_si256((__m256i*)rng[1], s0);
+    fill_random_scalar(dst, len, rng);
+}
+
+static inline void payload_fill(message_t* msg, payload_mode_t mode,
+                                uint64_t* counter, uint64_t rng[2][4]) {
+    static int have_avx2 = -1;
+    if (have_avx2 < 0) {
+        __builtin_cpu_init();
+        have_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    // The frame header of a framed schema is never overwritten
+    for (int i = msg->schema->framed; i < msg->schema->num_fields; i++) {
+        size_t field_size = msg->schema->size[i];
+        if (mode == PAYLOAD_COUNTER) {
+            if (have_avx2) fill_counter_avx2(msg->field[i], field_size, counter);
+            else fill_counter_scalar(msg->field[i], field_size, counter);
+        } else {
+            if (have_avx2) fill_random_avx2(msg->field[i], field_size, rng);
+            else fill_random_scalar(msg->field[i], field_size, rng);
+        }
+    }
+}
+
+static inline void payload_seed(uint64_t rng[2][4], uint64_t seed) {
+    for (int lane = 0; lane < 4; lane++) {
+        rng[0][lane] = payload_splitmix64(&seed);
+        rng[1][lane] = payload_splitmix64(&seed) | 1; // State must not be all zero
+    }
+}
+
+// --- Shared pool ---
+
+static inline int payload_pool_fill(payload_pool_t* pool, const schema_t* schema, int count) {
+    pool->count = count;
+    pool->msgs = (message_t**)calloc(pool->count, sizeof(message_t*));
+    pool->crcs = (uint32_t*)calloc(pool->count, sizeof(uint32_t));
+    if (!pool->msgs || !pool->crcs) {
+        perror("Failed to allocate payload pool");
+        return -1;
+    }
+
+    uint64_t rng[2][4];
+    payload_seed(rng, 0x4D543235303433ULL);
+    for (int i = 0; i < pool->count; i++) {
+        pool->msgs[i] = create_message(schema);
+        if (!pool->msgs[i]) {
+            return -1;
+        }
+        payload_fill(pool->msgs[i], PAYLOAD_RANDOM, NULL, rng);
+        pool->crcs[i] = crc32c_message(pool->msgs[i]);
+    }
+    return 0;
+}
+
+static inline int payload_pool_build(payload_pool_t* pool, const schema_t* schema, size_t pool_bytes) {
+    int count = (int)(pool_bytes / schema->total);
+    return payload_pool_fill(pool, schema, count < 2 ? 2 : count);
+}
+
+// The single message every static connection shares
+static inline int payload_shared_build(payload_pool_t* pool, const schema_t* schema) {
+    return payload_pool_fill(pool, schema, 1);
+}
+
+static inline void payload_pool_destroy(payload_pool_t* pool) {
+    for (int i = 0; i < pool->count && pool->msgs; i++) {
+        free_message(pool->msgs[i]);
+    }
+    free(pool->msgs);
+    free(pool->crcs);
+    pool->msgs = NULL;
+    pool->crcs = NULL;
+    pool->count = 0;
+}
+
+// --- Per-connection generator ---
+
+static inline int payload_init(payload_t* p, payload_mode_t mode, const schema_t* schema,
+                               const payload_pool_t* pool, uint64_t seed, int checksum) {
+    memset(p, 0, sizeof(*p));
+    p->mode = mode;
+    p->schema = schema;
+    p->checksum = checksum;
+    p->crc_ptr = &p->crc;
+    if (mode == PAYLOAD_POOL) {
+        p->pool = pool;
+        // Spread connections over the pool so they do not share hot lines
+        p->index = (int)(payload_splitmix64(&seed) % (uint64_t)pool->count);
+        return 0;
+    }
+    if (mode == PAYLOAD_STATIC && pool && pool->count > 0) {
+        p->pool = pool;
+        p->crc_ptr = &pool->crcs[0];
+        return 0;
+    }
+    p->msg = create_message(schema);
+    if (!p->msg) {
+        return -1;
+    }
+    p->counter = seed << 32;
+    payload_seed(p->rng, seed);
+    if (checksum) {
+        p->crc = crc32c_message(p->msg);
+    }
+    return 0;
+}
+
+// True for the modes that rewrite a message before every send.
+static inline int payload_refills(const payload_t* p) {
+    return p->mode == PAYLOAD_COUNTER || p->mode == PAYLOAD_RANDOM;
+}
+
+// Gives msg the next counter/random contents and, with checksums, stores its
+// CRC32C in *crc. For callers that keep several messages in flight at once.
+static inline void payload_refill(payload_t* p, message_t* msg, uint32_t* crc) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    payload_fill(msg, p->mode, &p->counter, p->rng);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    p->fill_ns += (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+    p->fills++;
+    if (p->checksum) {
+        *crc = crc32c_message(msg);
+    }
+}
+
+// Returns the message to send next, with fresh contents unless static.
+static inline message_t* payload_next(payload_t* p) {
+    switch (p->mode) {
+    case PAYLOAD_STATIC:
+        return p->msg ? p->msg : p->pool->msgs[0];
+    case PAYLOAD_POOL: {
+        message_t* msg = p->pool->msgs[p->index];
+        p->crc_ptr = &p->pool->crcs[p->index];
+        if (++p->index == p->pool->count) p->index = 0;
+        return msg;
+    }
+    default:
+        payload_refill(p, p->msg, &p->crc);
+        return p->msg;
+    }
+}
+
+// CRC32C of the message most recently returned by payload_next().
+static inline const uint32_t* payload_crc(const payload_t* p) {
+    return p->crc_ptr;
+}
+
+static inline void payload_report(const payload_t* p, int client_socket) {
+    if (p->fills > 0) {
+        printf("Server: Socket %d refilled %ld messages (%s), avg %.3f us per fill\n",
+               client_socket, p->fills, payload_mode_name(p->mode), p->fill_ns / 1000.0 / p->fills);
+    }
+}
+
+static inline void payload_destroy(payload_t* p) {
+    free_message(p->msg);
+    p->msg = NULL;
+}
+
+#endif // MT25043_PAYLOAD_H
@@ -0,0 +1,406 @@
+// MT25043
+//
+// File: MT25043_Pipeline.h
+//
+// Description: Receive-to-worker pipeline for the clients. Receive threads
+// cut the byte stream into messages, copy each into a slot of their own
+// arena and push a pointer to it through a lock-free queue (see
+// MT25043_Queue.h) to a pool of worker threads. A worker reads the message
+// and spins for a configurable time per message (synthetic processing),
+// then hands the slot back.
+//
+// Queue layouts (--queue):
+// - mpmc : one shared MPMC queue; every receiver pushes, every worker pops
+// - spsc : one SPSC queue per (receiver, worker) pair; receivers deal
+//          messages round-robin, workers poll their queues in turn
+//
+// When workers fall behind, receivers find their arena slots still busy or
+// the queues full and stall, so back-pressure reaches the socket and the
+// server. The report covers end-to-end throughput (bytes the workers
+// processed), handoff latency (push to pop), queue depth at push time and
+// receiver stalls.
+// ============================================================================
+
+#ifndef MT25043_PIPELINE_H
+#define MT25043_PIPELINE_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "MT25043_Queue.h"
+#include "MT25043_Hist.h"
+
+#define PIPELINE_DEFAULT_DEPTH 256
+#define PIPELINE_DEFAULT_WORK_NS 1000
+#define PIPELINE_IDLE_SPINS 64          // Empty polls before a worker yields
+
+typedef enum {
+    PIPELINE_MPMC = 0,
+    PIPELINE_SPSC
+} pipeline_queue_t;
+
+static const char* const pipeline_queue_names[] = { "mpmc", "spsc" };
+
+typedef struct {
+    char* data;
+    long enqueue_ns;
+    int busy;                   // Producer sets it, the worker clears it
+} pipeline_slot_t;
+
+typedef struct pipeline pipeline_t;
+
+typedef struct {
+    pipeline_t* pipe;
+    int id;
+    pipeline_slot_t* slots;
+    char* arena;
+    size_t num_slots;
+    size_t next_slot;
+    pipeline_slot_t* filling;   // Slot of the message being assembled
+    size_t filled;
+    int next_worker;            // spsc: queue the next message goes to
+    long pushed;
+    long stalls;
+    long stall_ns;
+    uint64_t depth_sum;
+    size_t depth_max;
+} __attribute__((aligned(QUEUE_CACHE_LINE))) pipeline_producer_t;
+
+typedef struct {
+    pipeline_t* pipe;
+    int id;
+    pthread_t thread;
+    int next_producer;          // spsc: queue polled first on the next pop
+    long messages;
+    uint64_t sink;
+    hist_t handoff;
+} __attribute__((aligned(QUEUE_CACHE_LINE))) pipeline_worker_t;
+
+struct pipeline {
+    pipeline_queue_t kind;
+    int num_producers;
+    int num_workers;
+    size_t depth;
+    size_t frame_size;
+    long work_ns;
+    mpmc_queue_t* mpmc;
+    spsc_queue_t* spsc;         // [producer * num_workers + worker]
+    pipeline_producer_t* producers;
+    pipeline_worker_t* workers;
+    int started;                // Workers running
+    int done;
+    long start_ns;
+    long end_ns;
+};
+
+static inline int parse_pipeline_queue(const char* name, pipeline_queue_t* kind) {
+    for (int i = 0; i < (int)(sizeof(pipeline_queue_names) / sizeof(pipeline_queue_names[0])); i++) {
+        if (strcasecmp(name, pipeline_queue_names[i]) == 0) {
+            *kind = (pipeline_queue_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline long pipeline_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static inline int pipeline_pop(pipeline_worker_t* w, pipeline_slot_t** slot) {
+    pipeline_t* p = w->pipe;
+    if (p->kind == PIPELINE_MPMC) {
+        return mpmc_pop(p->mpmc, (void**)slot);
+    }
+    // Start after the queue served last, so every receiver gets its turn
+    for (int i = 0; i < p->num_producers; i++) {
+        int producer = (w->next_producer + i) % p->num_producers;
+        if (spsc_pop(&p->spsc[producer * p->num_workers + w->id], (void**)slot)) {
+            w->next_producer = (producer + 1) % p->num_producers;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline void* pipeline_worker_thread(void* arg) {
+    pipeline_worker_t* w = (pipeline_worker_t*)arg;
+    pipeline_t* p = w->pipe;
+    int idle = 0;
+    while (1) {
+        pipeline_slot_t* slot;
+        if (!pipeline_pop(w, &slot)) {
+            if (!__atomic_load_n(&p->done, __ATOMIC_ACQUIRE)) {
+                if (++idle >= PIPELINE_IDLE_SPINS) {
+                    sched_yield();
+                    idle = 0;
+                }
+                continue;
+            }
+            // Producers stop pushing before done is set, so one more empty
+            // poll after seeing it means the queues are drained; a message
+            // found by that poll is processed like any other
+            if (!pipeline_pop(w, &slot)) {
+                break;
+            }
+        }
+        idle = 0;
+        long start = pipeline_now_ns();
+        hist_record(&w->handoff, (uint64_t)(start - slot->enqueue_ns));
+
+        // Synthetic processing: read the message, then burn work_ns
+        w->sink += (unsigned char)slot->data[0] ^ (unsigned char)slot->data[p->frame_size - 1];
+        while (pipeline_now_ns() - start < p->work_ns) {
+        }
+        w->messages++;
+        __atomic_store_n(&slot->busy, 0, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static inline void pipeline_destroy(pipeline_t* p);
+
+// Undoes a partial pipeline_create(): stops the workers already running
+// and frees whatever was allocated.
+static inline pipeline_t* pipeline_abort(pipeline_t* p) {
+    __atomic_store_n(&p->done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < p->started; i++) {
+        pthread_join(p->workers[i].thread, NULL);
+    }
+    pipeline_destroy(p);
+    return NULL;
+}
+
+// Creates the queues and arenas and starts the workers. Each producer owns
+// depth slots of frame_size bytes.
+static inline pipeline_t* pipeline_create(pipeline_queue_t kind, int num_producers, int num_workers,
+                                          size_t depth, size_t frame_size, long work_ns) {
+    pipeline_t* p = (pipeline_t*)calloc(1, sizeof(pipeline_t));
+    if (!p) {
+        perror("Failed to allocate pipeline");
+        return NULL;
+    }
+    p->kind = kind;
+    p->num_producers = num_producers;
+    p->num_workers = num_workers;
+    p->depth = depth;
+    p->frame_size = frame_size;
+    p->work_ns = work_ns;
+    p->producers = (pipeline_producer_t*)aligned_alloc(QUEUE_CACHE_LINE, num_producers * sizeof(pipeline_producer_t));
+    p->workers = (pipeline_worker_t*)aligned_alloc(QUEUE_CACHE_LINE, num_workers * sizeof(pipeline_worker_t));
+    if (!p->producers || !p->workers) {
+        perror("Failed to allocate pipeline threads");
+        free(p->producers);
+        p->producers = NULL;
+        return pipeline_abort(p);
+    }
+    memset(p->producers, 0, num_producers * sizeof(pipeline_producer_t));
+    memset(p->workers, 0, num_workers * sizeof(pipeline_worker_t));
+
+    int queues = kind == PIPELINE_MPMC ? 1 : num_producers * num_workers;
+    if (kind == PIPELINE_MPMC) {
+        p->mpmc = (mpmc_queue_t*)aligned_alloc(QUEUE_CACHE_LINE, sizeof(mpmc_queue_t));
+        if (!p->mpmc) {
+            perror("Failed to allocate MPMC queue");
+            return pipeline_abort(p);
+        }
+        memset(p->mpmc, 0, sizeof(mpmc_queue_t));
+        if (mpmc_init(p->mpmc, depth) < 0) {
+            return pipeline_abort(p);
+        }
+    } else {
+        p->spsc = (spsc_queue_t*)aligned_alloc(QUEUE_CACHE_LINE, queues * sizeof(spsc_queue_t));
+        if (!p->spsc) {
+            perror("Failed to allocate SPSC queues");
+            return pipeline_abort(p);
+        }
+        memset(p->spsc, 0, queues * sizeof(spsc_queue_t));
+        for (int i = 0; i < queues; i++) {
+            if (spsc_init(&p->spsc[i], depth) < 0) {
+                return pipeline_abort(p);
+            }
+        }
+    }
+
+    for (int i = 0; i < num_producers; i++) {
+        pipeline_producer_t* prod = &p->producers[i];
+        prod->pipe = p;
+        prod->id = i;
+        prod->num_slots = depth;
+        prod->slots = (pipeline_slot_t*)calloc(depth, sizeof(pipeline_slot_t));
+        prod->arena = (char*)malloc(depth * frame_size);
+        if (!prod->slots || !prod->arena) {
+            perror("Failed to allocate pipeline arena");
+            return pipeline_abort(p);
+        }
+        for (size_t s = 0; s < depth; s++) {
+            prod->slots[s].data = prod->arena + s * frame_size;
+        }
+    }
+
+    p->start_ns = pipeline_now_ns();
+    for (int i = 0; i < num_workers; i++) {
+        pipeline_worker_t* w = &p->workers[i];
+        w->pipe = p;
+        w->id = i;
+        hist_init(&w->handoff);
+        if (pthread_create(&w->thread, NULL, pipeline_worker_thread, w) != 0) {
+            perror("Failed to start pipeline worker");
+            return pipeline_abort(p);
+        }
+        p->started++;
+    }
+    return p;
+}
+
+static inline pipeline_producer_t* pipeline_producer(pipeline_t* p, int id) {
+    return &p->producers[id];
+}
+
+// Next free arena slot; waits (a stall) while the workers still hold it.
+static inline pipeline_slot_t* pipeline_acquire(pipeline_producer_t* prod) {
+    pipeline_slot_t* slot = &prod->slots[prod->next_slot];
+    prod->next_slot = (prod->next_slot + 1) % prod->num_slots;
+    if (__atomic_load_n(&slot->busy, __ATOMIC_ACQUIRE)) {
+        long start = pipeline_now_ns();
+        while (__atomic_load_n(&slot->busy, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+        prod->stalls++;
+        prod->stall_ns += pipeline_now_ns() - start;
+    }
+    slot->busy = 1;
+    return slot;
+}
+
+static inline void pipeline_push(pipeline_producer_t* prod, pipeline_slot_t* slot) {
+    pipeline_t* p = prod->pipe;
+    long start = 0;
+    slot->enqueue_ns = pipeline_now_ns();
+    while (1) {
+        if (p->kind == PIPELINE_MPMC) {
+            if (mpmc_push(p->mpmc, slot)) {
+                size_t depth = mpmc_depth(p->mpmc);
+                prod->depth_sum += depth;
+                if (depth > prod->depth_max) prod->depth_max = depth;
+                break;
+            }
+        } else {
+            int pushed = 0;
+            for (int i = 0; i < p->num_workers && !pushed; i++) {
+                spsc_queue_t* q = &p->spsc[prod->id * p->num_workers + prod->next_worker];
+                prod->next_worker = (prod->next_worker + 1) % p->num_workers;
+                if (spsc_push(q, slot)) {
+                    size_t depth = spsc_depth(q);
+                    prod->depth_sum += depth;
+                    if (depth > prod->depth_max) prod->depth_max = depth;
+                    pushed = 1;
+                }
+            }
+            if (pushed) {
+                break;
+            }
+        }
+        if (start == 0) {
+            start = pipeline_now_ns();
+        }
+        sched_yield();
+    }
+    if (start != 0) {
+        prod->stalls++;
+        prod->stall_ns += pipeline_now_ns() - start;
+    }
+    prod->pushed++;
+}
+
+// recv_span_fn (see MT25043_Recv.h): assembles received bytes into whole
+// messages and hands each one to the workers.
+static inline void pipeline_span(void* ctx, const char* data, size_t len) {
+    pipeline_producer_t* prod = (pipeline_producer_t*)ctx;
+    size_t frame_size = prod->pipe->frame_size;
+    while (len > 0) {
+        if (!prod->filling) {
+            prod->filling = pipeline_acquire(prod);
+            prod->filled = 0;
+        }
+        size_t take = frame_size - prod->filled < len ? frame_size - prod->filled : len;
+        memcpy(prod->filling->data + prod->filled, data, take);
+        prod->filled += take;
+        data += take;
+        len -= take;
+        if (prod->filled == frame_size) {
+            pipeline_push(prod, prod->filling);
+            prod->filling = NULL;
+        }
+    }
+}
+
+// Call after every producer has stopped: drains the queues, joins workers.
+static inline void pipeline_finish(pipeline_t* p) {
+    __atomic_store_n(&p->done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < p->num_workers; i++) {
+        pthread_join(p->workers[i].thread, NULL);
+    }
+    p->end_ns = pipeline_now_ns();
+}
+
+static inline void pipeline_report(const pipeline_t* p) {
+    hist_t handoff;
+    hist_init(&handoff);
+    long processed = 0, pushed = 0, stalls = 0, stall_ns = 0;
+    uint64_t depth_sum = 0;
+    size_t depth_max = 0;
+    for (int i = 0; i < p->num_workers; i++) {
+        hist_merge(&handoff, &p->workers[i].handoff);
+        processed += p->workers[i].messages;
+    }
+    for (int i = 0; i < p->num_producers; i++) {
+        pushed += p->producers[i].pushed;
+        stalls += p->producers[i].stalls;
+        stall_ns += p->producers[i].stall_ns;
+        depth_sum += p->producers[i].depth_sum;
+        if (p->producers[i].depth_max > depth_max) depth_max = p->producers[i].depth_max;
+    }
+    double elapsed = (p->end_ns - p->start_ns) / 1e9;
+
+    printf("Pipeline: %s queue%s, %d worker%s, %ld ns work per message, depth %zu\n",
+           pipeline_queue_names[p->kind], p->kind == PIPELINE_SPSC ? "s" : "", p->num_workers,
+           p->num_workers == 1 ? "" : "s", p->work_ns, p->depth);
+    printf("Pipeline Throughput: %.6f Gbps (%ld messages processed)\n",
+           elapsed > 0 ? processed * (double)p->frame_size * 8.0 / elapsed / 1e9 : 0.0, processed);
+    printf("Handoff Latency: avg %.3f us, p50 %.3f us, p99 %.3f us, p99.9 %.3f us\n", hist_mean(&handoff) / 1000.0,
+           hist_percentile(&handoff, 0.50) / 1000.0, hist_percentile(&handoff, 0.99) / 1000.0,
+           hist_percentile(&handoff, 0.999) / 1000.0);
+    printf("Queue Depth: avg %.1f, max %zu\n", pushed > 0 ? (double)depth_sum / pushed : 0.0, depth_max);
+    printf("Receiver Stalls: %ld, %.3f ms total\n", stalls, stall_ns / 1e6);
+}
+
+static inline void pipeline_destroy(pipeline_t* p) {
+    if (p->mpmc) {
+        mpmc_destroy(p->mpmc);
+        free(p->mpmc);
+    }
+    if (p->spsc) {
+        for (int i = 0; i < p->num_producers * p->num_workers; i++) {
+            spsc_destroy(&p->spsc[i]);
+        }
+        free(p->spsc);
+    }
+    for (int i = 0; i < p->num_producers && p->producers; i++) {
+        free(p->producers[i].slots);
+        free(p->producers[i].arena);
+    }
+    free(p->producers);
+    free(p->workers);
+    free(p);
+}
+
+#endif // MT25043_PIPELINE_H
@@ -0,0 +1,468 @@
+// MT25043
+//
+// File: MT25043_Publish.h
+//
+// Description: Publish mode for the sendmsg() servers. Instead of building
+// and sending every message on the connection thread, producer threads
+// build messages into buffers from a fixed per-connection pool and push
+// them through a lock-free queue (see MT25043_Queue.h). The connection
+// thread becomes a pure socket writer: it takes whatever is queued, up to
+// one batch, and sends it with a single sendmsg() (one iovec per message),
+// optionally with MSG_ZEROCOPY.
+//
+// Buffers go back to the pool when the kernel is done with them: right
+// after sendmsg() returns for a copying send, or once the MSG_ERRQUEUE
+// completion covering the send arrives for MSG_ZEROCOPY. With too few
+// buffers, producers wait for the writer (producer stalls); with a slow
+// writer, the queue fills and batches grow.
+//
+// The per-connection report gives producer stalls, queue occupancy seen
+// by the writer, the batch size distribution and, for MSG_ZEROCOPY, how
+// many buffers were held waiting for completions.
+// ============================================================================
+
+#ifndef MT25043_PUBLISH_H
+#define MT25043_PUBLISH_H
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/errqueue.h>
+
+#include "MT25043_Message.h"
+#include "MT25043_Payload.h"
+#include "MT25043_Copy.h"
+#include "MT25043_Crc32c.h"
+#include "MT25043_Queue.h"
+#include "MT25043_Hist.h"
+#include "MT25043_Metrics.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+#define PUBLISH_DEFAULT_BUFFERS 256
+#define PUBLISH_INITIAL_RANGES 64       // Out-of-order completion ranges; grows on demand
+#define PUBLISH_DRAIN_TIMEOUT_MS 1000   // Wait for zero-copy completions at exit
+
+typedef struct publisher publisher_t;
+
+typedef struct {
+    publisher_t* pub;
+    int id;
+    pthread_t thread;
+    payload_t payload;
+    long messages;
+    long stalls;
+    long stall_ns;
+} __attribute__((aligned(QUEUE_CACHE_LINE))) publish_producer_t;
+
+typedef struct {
+    uint32_t lo;
+    uint32_t hi;
+} publish_range_t;
+
+struct publisher {
+    mpmc_queue_t free_q;        // Buffers ready to be filled
+    mpmc_queue_t ready_q;       // Filled buffers, in production order
+    int sock;
+    const schema_t* schema;
+    int checksum;
+    size_t frame_size;
+    int num_buffers;
+    char* arena;
+    int num_producers;
+    publish_producer_t* producers;
+    int stop;
+
+    // Writer state (connection thread only)
+    int max_batch;
+    int batch_count;
+    char** batch;
+    struct iovec* iov;
+    int zerocopy;
+    uint32_t zc_seq;            // Sequence number of the next MSG_ZEROCOPY send
+    uint32_t zc_done;           // Every send before this one has completed
+    publish_range_t* ranges;
+    int num_ranges;
+    int max_ranges;
+    char** pending;             // Buffers pinned by zero-copy sends, in order
+    uint32_t* pending_seq;
+    int pending_head;
+    int pending_count;
+
+    // Statistics
+    long syscalls;
+    long messages;
+    long writer_waits;
+    long collects;
+    uint64_t occupancy_sum;
+    size_t occupancy_max;
+    hist_t batch_sizes;
+    int max_pending;
+    long completions;
+    long copied;
+};
+
+static inline long publish_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static inline void* publish_producer_thread(void* arg) {
+    publish_producer_t* prod = (publish_producer_t*)arg;
+    publisher_t* pub = prod->pub;
+    while (!__atomic_load_n(&pub->stop, __ATOMIC_ACQUIRE)) {
+        char* buf;
+        if (!mpmc_pop(&pub->free_q, (void**)&buf)) {
+            // Every buffer is queued or in flight: wait for the writer
+            long start = publish_now_ns();
+            int got = 0;
+            while (!__atomic_load_n(&pub->stop, __ATOMIC_ACQUIRE)) {
+                if (mpmc_pop(&pub->free_q, (void**)&buf)) {
+                    got = 1;
+                    break;
+                }
+                sched_yield();
+            }
+            prod->stalls++;
+            prod->stall_ns += publish_now_ns() - start;
+            if (!got) {
+                break;
+            }
+        }
+        message_t* msg = payload_next(&prod->payload);
+        gather_message(buf, msg, COPY_KERNEL_MEMCPY);
+        if (pub->checksum) {
+            memcpy(buf + pub->schema->total, payload_crc(&prod->payload), CRC32C_TRAILER_SIZE);
+        }
+        // The ready queue holds every buffer, so this push cannot fail
+        mpmc_push(&pub->ready_q, buf);
+        prod->messages++;
+    }
+    return NULL;
+}
+
+// Allocates num_buffers message buffers and starts num_producers producer
+// threads. batch <= 0 lets a batch take everything queued (up to IOV_MAX);
+// byte_budget > 0 bounds it further. zerocopy needs SO_ZEROCOPY on sock.
+static inline int publisher_start(publisher_t* pub, int sock, const schema_t* schema, payload_mode_t mode,
+                                  const payload_pool_t* pool, int checksum, int num_producers, int num_buffers,
+                                  int batch, size_t byte_budget, int zerocopy) {
+    memset(pub, 0, sizeof(*pub));
+    pub->sock = sock;
+    pub->schema = schema;
+    pub->checksum = checksum;
+    pub->frame_size = schema->total + (checksum ? CRC32C_TRAILER_SIZE : 0);
+    pub->num_buffers = num_buffers;
+    hist_init(&pub->batch_sizes);
+
+    pub->max_batch = batch > 0 && batch < IOV_MAX ? batch : IOV_MAX;
+    if (byte_budget > 0 && (size_t)pub->max_batch * pub->frame_size > byte_budget) {
+        pub->max_batch = (int)(byte_budget / pub->frame_size);
+    }
+    if (pub->max_batch > num_buffers) pub->max_batch = num_buffers;
+    if (pub->max_batch < 1) pub->max_batch = 1;
+
+    if (zerocopy) {
+        // Without SO_ZEROCOPY the flag is ignored and no completion would
+        // ever return the buffers
+        int enabled = 0;
+        socklen_t len = sizeof(enabled);
+        if (getsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &enabled, &len) < 0 || !enabled) {
+            printf("Server: Socket %d has no SO_ZEROCOPY, publishing with plain sendmsg()\n", sock);
+            zerocopy = 0;
+        }
+    }
+    pub->zerocopy = zerocopy;
+
+    // Buffers start on their own cache lines, so producers never share one
+    size_t stride = (pub->frame_size + QUEUE_CACHE_LINE - 1) & ~(size_t)(QUEUE_CACHE_LINE - 1);
+    pub->arena = (char*)aligned_alloc(QUEUE_CACHE_LINE, (size_t)num_buffers * stride);
+    pub->batch = (char**)malloc((size_t)pub->max_batch * sizeof(char*));
+    pub->iov = (struct iovec*)malloc((size_t)pub->max_batch * sizeof(struct iovec));
+    pub->pending = (char**)malloc((size_t)num_buffers * sizeof(char*));
+    pub->pending_seq = (uint32_t*)malloc((size_t)num_buffers * sizeof(uint32_t));
+    pub->producers = (publish_producer_t*)aligned_alloc(QUEUE_CACHE_LINE, num_producers * sizeof(publish_producer_t));
+    pub->max_ranges = PUBLISH_INITIAL_RANGES;
+    pub->ranges = (publish_range_t*)malloc((size_t)pub->max_ranges * sizeof(publish_range_t));
+    if (!pub->arena || !pub->batch || !pub->iov || !pub->pending || !pub->pending_seq || !pub->producers ||
+        !pub->ranges) {
+        perror("Failed to allocate publisher");
+        return -1;
+    }
+    if (mpmc_init(&pub->free_q, (size_t)num_buffers) < 0 || mpmc_init(&pub->ready_q, (size_t)num_buffers) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < num_buffers; i++) {
+        mpmc_push(&pub->free_q, pub->arena + (size_t)i * stride);
+    }
+
+    memset(pub->producers, 0, num_producers * sizeof(publish_producer_t));
+    for (int i = 0; i < num_producers; i++) {
+        publish_producer_t* prod = &pub->producers[i];
+        prod->pub = pub;
+        prod->id = i;
+        if (payload_init(&prod->payload, mode, schema, pool, (uint64_t)sock * 64 + i, checksum) < 0) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < num_producers; i++) {
+        if (pthread_create(&pub->producers[i].thread, NULL, publish_producer_thread, &pub->producers[i]) != 0) {
+            perror("Failed to start producer thread");
+            return -1;
+        }
+        pub->num_producers = i + 1; // Only started producers are joined
+    }
+    return 0;
+}
+
+// Returns pinned buffers whose sends have all completed to the pool.
+static inline void publisher_release(publisher_t* pub) {
+    while (pub->pending_count > 0 && (int32_t)(pub->pending_seq[pub->pending_head] - pub->zc_done) < 0) {
+        mpmc_push(&pub->free_q, pub->pending[pub->pending_head]);
+        pub->pending_head = (pub->pending_head + 1) % pub->num_buffers;
+        pub->pending_count--;
+    }
+}
+
+// Records that sends lo..hi completed. TCP normally completes in order;
+// a range that arrives early is kept until the gap before it closes. The
+// gap is never assumed complete: its buffers may still be pinned.
+static inline void publisher_complete(publisher_t* pub, uint32_t lo, uint32_t hi) {
+    if (lo != pub->zc_done) {
+        if (pub->num_ranges == pub->max_ranges) {
+            publish_range_t* grown = (publish_range_t*)realloc(pub->ranges,
+                                                               2 * (size_t)pub->max_ranges * sizeof(publish_range_t));
+            if (!grown) {
+                // Losing the range only keeps its buffers pinned for good
+                perror("Failed to grow zero-copy completion ranges");
+                return;
+            }
+            pub->ranges = grown;
+            pub->max_ranges *= 2;
+        }
+        pub->ranges[pub->num_ranges].lo = lo;
+        pub->ranges[pub->num_ranges].hi = hi;
+        pub->num_ranges++;
+        return;
+    }
+    pub->zc_done = hi + 1;
+    for (int i = 0; i < pub->num_ranges;) {
+        if ((int32_t)(pub->ranges[i].lo - pub->zc_done) <= 0) {
+            if ((int32_t)(pub->ranges[i].hi + 1 - pub->zc_done) > 0) {
+                pub->zc_done = pub->ranges[i].hi + 1;
+            }
+            pub->ranges[i] = pub->ranges[--pub->num_ranges];
+            i = 0; // zc_done moved: rescan
+        } else {
+            i++;
+        }
+    }
+    publisher_release(pub);
+}
+
+// Drains MSG_ERRQUEUE without blocking.
+static inline void publisher_reap(publisher_t* pub) {
+    char cmsg_buf[CMSG_SPACE(sizeof(struct sock_extended_err))];
+    struct msghdr hdr;
+    while (1) {
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_control = cmsg_buf;
+        hdr.msg_controllen = sizeof(cmsg_buf);
+        if (recvmsg(pub->sock, &hdr, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return;
+        }
+        struct cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+        if (!cm) {
+            continue;
+        }
+        struct sock_extended_err* serr = (struct sock_extended_err*)CMSG_DATA(cm);
+        if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+            continue;
+        }
+        pub->completions++;
+        uint32_t count = serr->ee_data - serr->ee_info + 1;
+        if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+            pub->copied += count;
+        }
+        metrics_completions(count, serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED ? count : 0);
+        publisher_complete(pub, serr->ee_info, serr->ee_data);
+    }
+}
+
+// Takes up to one batch of queued messages and points hdr at them.
+// Waits until at least one message is queued. Returns the message count.
+static inline int publisher_collect(publisher_t* pub, struct msghdr* hdr) {
+    int waited = 0;
+    size_t depth;
+    while (1) {
+        if (pub->zerocopy) {
+            publisher_reap(pub);
+        }
+        depth = mpmc_depth(&pub->ready_q);
+        if (depth > 0) {
+            break;
+        }
+        waited = 1;
+        sched_yield();
+    }
+    pub->writer_waits += waited;
+    pub->collects++;
+    pub->occupancy_sum += depth;
+    if (depth > pub->occupancy_max) pub->occupancy_max = depth;
+
+    int n = 0;
+    char* buf;
+    while (n < pub->max_batch && mpmc_pop(&pub->ready_q, (void**)&buf)) {
+        pub->batch[n] = buf;
+        pub->iov[n].iov_base = buf;
+        pub->iov[n].iov_len = pub->frame_size;
+        n++;
+    }
+    pub->batch_count = n;
+    hdr->msg_iov = pub->iov;
+    hdr->msg_iovlen = (size_t)n;
+    return n;
+}
+
+// Sends the collected batch completely (resuming after partial sends) and
+// hands its buffers back to the pool or to the zero-copy pending list.
+// Returns the bytes sent, or <= 0 when the connection failed.
+static inline ssize_t publisher_send(publisher_t* pub, struct msghdr* hdr) {
+    size_t remaining = (size_t)pub->batch_count * pub->frame_size;
+    ssize_t total = 0;
+    while (remaining > 0) {
+        ssize_t sent = sendmsg(pub->sock, hdr, pub->zerocopy ? MSG_ZEROCOPY : 0);
+        if (sent < 0 && errno == EOPNOTSUPP && pub->zerocopy) {
+            printf("Server: Socket %d does not support MSG_ZEROCOPY (kTLS), publishing with plain sendmsg()\n", pub->sock);
+            pub->zerocopy = 0;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return sent;
+        }
+        if (pub->zerocopy) {
+            pub->zc_seq++;
+        }
+        pub->syscalls++;
+        total += sent;
+        remaining -= (size_t)sent;
+        // Skip what went out; the buffers stay listed in pub->batch
+        while (sent > 0 && (size_t)sent >= hdr->msg_iov->iov_len) {
+            sent -= (ssize_t)hdr->msg_iov->iov_len;
+            hdr->msg_iov++;
+            hdr->msg_iovlen--;
+        }
+        if (sent > 0) {
+            hdr->msg_iov->iov_base = (char*)hdr->msg_iov->iov_base + sent;
+            hdr->msg_iov->iov_len -= (size_t)sent;
+        }
+    }
+
+    for (int i = 0; i < pub->batch_count; i++) {
+        if (pub->zerocopy) {
+            int slot = (pub->pending_head + pub->pending_count) % pub->num_buffers;
+            pub->pending[slot] = pub->batch[i];
+            pub->pending_seq[slot] = pub->zc_seq - 1;
+            pub->pending_count++;
+        } else {
+            mpmc_push(&pub->free_q, pub->batch[i]);
+        }
+    }
+    if (pub->pending_count > pub->max_pending) pub->max_pending = pub->pending_count;
+    hist_record(&pub->batch_sizes, (uint64_t)pub->batch_count);
+    pub->messages += pub->batch_count;
+    pub->batch_count = 0;
+    return total;
+}
+
+// Stops and joins the producers, then waits (bounded) for outstanding
+// zero-copy completions so no buffer is freed while the kernel holds it.
+// Buffers still pending after the timeout keep the arena alive for good
+// (see publisher_destroy).
+static inline void publisher_stop(publisher_t* pub) {
+    __atomic_store_n(&pub->stop, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < pub->num_producers; i++) {
+        pthread_join(pub->producers[i].thread, NULL);
+    }
+    long deadline = publish_now_ns() + PUBLISH_DRAIN_TIMEOUT_MS * 1000000L;
+    while (pub->pending_count > 0 && publish_now_ns() < deadline) {
+        struct pollfd pfd = { .fd = pub->sock, .events = 0, .revents = 0 };
+        poll(&pfd, 1, 10); // POLLERR is always reported
+        publisher_reap(pub);
+    }
+    if (pub->pending_count > 0) {
+        printf("Server: Socket %d still has %d buffers pinned after %d ms, leaking the publish arena\n",
+               pub->sock, pub->pending_count, PUBLISH_DRAIN_TIMEOUT_MS);
+    }
+}
+
+static inline void publisher_report(const publisher_t* pub, int client_socket) {
+    long produced = 0, stalls = 0, stall_ns = 0;
+    for (int i = 0; i < pub->num_producers; i++) {
+        produced += pub->producers[i].messages;
+        stalls += pub->producers[i].stalls;
+        stall_ns += pub->producers[i].stall_ns;
+    }
+    printf("Server: Socket %d published %ld of %ld produced messages from %d producer%s "
+           "(%ld producer stalls, %.3f ms waiting for buffers)\n", client_socket, pub->messages, produced,
+           pub->num_producers, pub->num_producers == 1 ? "" : "s", stalls, stall_ns / 1e6);
+    if (pub->messages == 0) {
+        return;
+    }
+    printf("Server: Socket %d publish queue occupancy avg %.1f, max %zu of %d buffers; "
+           "batch avg %.1f, p50 %lu, p99 %lu, max %lu messages (limit %d, %ld sendmsg calls, %ld writer waits)\n",
+           client_socket, (double)pub->occupancy_sum / pub->collects, pub->occupancy_max, pub->num_buffers,
+           hist_mean(&pub->batch_sizes), (unsigned long)hist_percentile(&pub->batch_sizes, 0.50),
+           (unsigned long)hist_percentile(&pub->batch_sizes, 0.99), (unsigned long)pub->batch_sizes.max,
+           pub->max_batch, pub->syscalls, pub->writer_waits);
+    if (pub->zc_seq > 0) {
+        printf("Server: Socket %d MSG_ZEROCOPY held up to %d buffers until completion "
+               "(%ld notifications, %ld sends copied by the kernel, %d still pending)\n",
+               client_socket, pub->max_pending, pub->completions, pub->copied, pub->pending_count);
+    }
+}
+
+static inline void publisher_destroy(publisher_t* pub) {
+    for (int i = 0; pub->producers && i < pub->num_producers; i++) {
+        payload_destroy(&pub->producers[i].payload);
+    }
+    mpmc_destroy(&pub->free_q);
+    mpmc_destroy(&pub->ready_q);
+    if (pub->pending_count == 0) {
+        free(pub->arena); // Otherwise the kernel may still send from it
+    }
+    free(pub->batch);
+    free(pub->iov);
+    free(pub->pending);
+    free(pub->pending_seq);
+    free(pub->ranges);
+    free(pub->producers);
+    pub->arena = NULL;
+    pub->producers = NULL;
+}
+
+#endif // MT25043_PUBLISH_H
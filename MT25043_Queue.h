@@ -0,0 +1,185 @@
+// MT25043
+//
+// File: MT25043_Queue.h
+//
+// Description: Bounded lock-free queues of pointers for handing messages
+// between threads.
+//
+// - mpmc_queue_t : any number of producers and consumers (Dmitry Vyukov's
+//                  bounded MPMC queue: every cell carries a sequence number
+//                  that says whose turn it is, so a push or pop is one CAS
+//                  on the shared position plus one store to the cell)
+// - spsc_queue_t : exactly one producer and one consumer; head and tail
+//                  live on their own cache lines and each side caches the
+//                  other's index, so the fast path touches no shared line
+//
+// Both hold a power-of-two number of slots, never block and return 0 when
+// full (push) or empty (pop). Callers decide how to wait.
+// ============================================================================
+
+#ifndef MT25043_QUEUE_H
+#define MT25043_QUEUE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define QUEUE_CACHE_LINE 64
+
+// At least 8 slots, so every ring is a whole number of cache lines.
+static inline size_t queue_round_up(size_t n) {
+    size_t size = 8;
+    while (size < n) size <<= 1;
+    return size;
+}
+
+// --- Multi-producer, multi-consumer ---
+
+typedef struct {
+    size_t seq;
+    void* item;
+} mpmc_cell_t;
+
+typedef struct {
+    mpmc_cell_t* cells;
+    size_t mask;
+    size_t enqueue_pos __attribute__((aligned(QUEUE_CACHE_LINE)));
+    size_t dequeue_pos __attribute__((aligned(QUEUE_CACHE_LINE)));
+    char pad[QUEUE_CACHE_LINE - sizeof(size_t)];
+} mpmc_queue_t;
+
+static inline int mpmc_init(mpmc_queue_t* q, size_t capacity) {
+    size_t size = queue_round_up(capacity);
+    q->cells = (mpmc_cell_t*)aligned_alloc(QUEUE_CACHE_LINE, size * sizeof(mpmc_cell_t));
+    if (!q->cells) {
+        perror("Failed to allocate MPMC queue");
+        return -1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        q->cells[i].seq = i;
+    }
+    q->mask = size - 1;
+    q->enqueue_pos = 0;
+    q->dequeue_pos = 0;
+    return 0;
+}
+
+static inline int mpmc_push(mpmc_queue_t* q, void* item) {
+    size_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    mpmc_cell_t* cell;
+    while (1) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0; // Full: the consumer of this cell's previous lap is behind
+        } else {
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    cell->item = item;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static inline int mpmc_pop(mpmc_queue_t* q, void** item) {
+    size_t pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    mpmc_cell_t* cell;
+    while (1) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0; // Empty
+        } else {
+            pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    *item = cell->item;
+    __atomic_store_n(&cell->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Approximate number of queued items (exact when the queue is quiet).
+static inline size_t mpmc_depth(mpmc_queue_t* q) {
+    size_t tail = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    return tail > head ? tail - head : 0;
+}
+
+static inline void mpmc_destroy(mpmc_queue_t* q) {
+    free(q->cells);
+    q->cells = NULL;
+}
+
+// --- Single-producer, single-consumer ---
+
+typedef struct {
+    void** items;
+    size_t mask;
+    size_t head __attribute__((aligned(QUEUE_CACHE_LINE)));  // Consumer side
+    size_t cached_tail;
+    size_t tail __attribute__((aligned(QUEUE_CACHE_LINE)));  // Producer side
+    size_t cached_head;
+    char pad[QUEUE_CACHE_LINE - 2 * sizeof(size_t)];
+} spsc_queue_t;
+
+static inline int spsc_init(spsc_queue_t* q, size_t capacity) {
+    size_t size = queue_round_up(capacity);
+    q->items = (void**)aligned_alloc(QUEUE_CACHE_LINE, size * sizeof(void*));
+    if (!q->items) {
+        perror("Failed to allocate SPSC queue");
+        return -1;
+    }
+    q->mask = size - 1;
+    q->head = q->cached_tail = 0;
+    q->tail = q->cached_head = 0;
+    return 0;
+}
+
+static inline int spsc_push(spsc_queue_t* q, void* item) {
+    size_t tail = q->tail;
+    if (tail - q->cached_head > q->mask) {
+        q->cached_head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+        if (tail - q->cached_head > q->mask) {
+            return 0;
+        }
+    }
+    q->items[tail & q->mask] = item;
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static inline int spsc_pop(spsc_queue_t* q, void** item) {
+    size_t head = q->head;
+    if (head == q->cached_tail) {
+        q->cached_tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+        if (head == q->cached_tail) {
+            return 0;
+        }
+    }
+    *item = q->items[head & q->mask];
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static inline size_t spsc_depth(spsc_queue_t* q) {
+    size_t tail = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    return tail > head ? tail - head : 0;
+}
+
+static inline void spsc_destroy(spsc_queue_t* q) {
+    free(q->items);
+    q->items = NULL;
+}
+
+#endif // MT25043_QUEUE_H
@@ -0,0 +1,218 @@
+// MT25043
+//
+// File: MT25043_Recv.h
+//
+// Description: Selectable receive strategies shared by all clients. Each
+// call to receiver_recv() performs exactly one receive system call, so the
+// caller can time it and count recvs per message and bytes per syscall.
+//
+// Strategies:
+// - recv    : recv() into a buffer of configurable size
+// - waitall : recv() with MSG_WAITALL, one whole message per call
+// - readv   : readv() straight into the fields of a rebuilt message_t
+//             (laid out by the same schema as the sender's)
+// - trunc   : recvmsg() with MSG_TRUNC, the kernel discards the data
+//
+// A frame is one message optionally followed by a small trailer (e.g. the
+// CRC32C sent in checksum mode); waitall and readv read whole frames.
+// ============================================================================
+
+#ifndef MT25043_RECV_H
+#define MT25043_RECV_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "MT25043_Message.h"
+
+#define RECV_BUFFER_SIZE 65536 // Default 64KB buffer for receiving data
+#define RECV_MAX_TRAILER 16
+
+typedef enum {
+    RECV_MODE_RECV = 0,
+    RECV_MODE_WAITALL,
+    RECV_MODE_READV,
+    RECV_MODE_TRUNC
+} recv_mode_t;
+
+static const char* const recv_mode_names[] = { "recv", "waitall", "readv", "trunc" };
+
+typedef struct {
+    recv_mode_t mode;
+    int sock;
+    const schema_t* schema;
+    size_t msg_size;
+    size_t trailer_size;
+    size_t frame_size;      // msg_size + trailer_size
+    size_t buf_size;
+    size_t msg_offset;      // Bytes of the current frame received so far
+    char* buffer;           // recv / waitall destination
+    message_t* msg;         // readv destination
+    char trailer[RECV_MAX_TRAILER];
+} receiver_t;
+
+// Called with every contiguous run of bytes a receive call delivered.
+typedef void (*recv_span_fn)(void* ctx, const char* data, size_t len);
+
+static inline int parse_recv_mode(const char* name, recv_mode_t* mode) {
+    for (int i = 0; i < (int)(sizeof(recv_mode_names) / sizeof(recv_mode_names[0])); i++) {
+        if (strcasecmp(name, recv_mode_names[i]) == 0) {
+            *mode = (recv_mode_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline const char* recv_mode_name(recv_mode_t mode) {
+    return recv_mode_names[mode];
+}
+
+// Validates the receive buffer size before any thread starts.
+static inline int recv_mode_check(int buf_size) {
+    if (buf_size <= 0) {
+        fprintf(stderr, "Receive buffer size must be positive (got %d)\n", buf_size);
+        return -1;
+    }
+    return 0;
+}
+
+static inline int receiver_init(receiver_t* r, recv_mode_t mode, int sock, const schema_t* schema,
+                                size_t trailer_size, size_t buf_size) {
+    memset(r, 0, sizeof(*r));
+    r->mode = mode;
+    r->sock = sock;
+    r->schema = schema;
+    r->msg_size = schema->total;
+    r->trailer_size = trailer_size < RECV_MAX_TRAILER ? trailer_size : RECV_MAX_TRAILER;
+    r->frame_size = r->msg_size + r->trailer_size;
+    r->buf_size = buf_size;
+
+    switch (mode) {
+    case RECV_MODE_RECV:
+        r->buffer = (char*)malloc(buf_size);
+        break;
+    case RECV_MODE_WAITALL:
+        // Whole-message reads: the buffer always holds exactly one frame
+        r->buf_size = r->frame_size;
+        r->buffer = (char*)malloc(r->frame_size);
+        break;
+    case RECV_MODE_READV:
+        r->msg = create_message(schema);
+        return r->msg ? 0 : -1;
+    case RECV_MODE_TRUNC:
+        // Nothing to allocate, the kernel never copies into user space
+        return 0;
+    }
+    if (!r->buffer) {
+        perror("Failed to allocate receive buffer");
+        return -1;
+    }
+    return 0;
+}
+
+// Performs one receive system call. Returns the byte count like recv().
+static inline ssize_t receiver_recv(receiver_t* r) {
+    ssize_t n = -1;
+
+    switch (r->mode) {
+    case RECV_MODE_RECV:
+        n = recv(r->sock, r->buffer, r->buf_size, 0);
+        break;
+    case RECV_MODE_WAITALL:
+        // Ask only for what is missing so a short read (signal, EOF) keeps
+        // later reads aligned to message boundaries
+        n = recv(r->sock, r->buffer + r->msg_offset, r->frame_size - r->msg_offset, MSG_WAITALL);
+        break;
+    case RECV_MODE_READV: {
+        // Resume inside the field (or trailer) where the previous readv() stopped
+        struct iovec iov[MAX_FIELDS + 1];
+        int count = 0;
+        if (r->msg_offset < r->msg_size) {
+            int first = schema_field_at(r->schema, r->msg_offset);
+            size_t skip = r->msg_offset - r->schema->offset[first];
+            for (int i = first; i < r->schema->num_fields; i++) {
+                iov[count].iov_base = r->msg->field[i] + (i == first ? skip : 0);
+                iov[count].iov_len = r->schema->size[i] - (i == first ? skip : 0);
+                count++;
+            }
+        }
+        if (r->trailer_size > 0) {
+            size_t done = r->msg_offset > r->msg_size ? r->msg_offset - r->msg_size : 0;
+            iov[count].iov_base = r->trailer + done;
+            iov[count].iov_len = r->trailer_size - done;
+            count++;
+        }
+        n = readv(r->sock, iov, count);
+        break;
+    }
+    case RECV_MODE_TRUNC: {
+        struct iovec iov = { NULL, r->buf_size };
+        struct msghdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        n = recvmsg(r->sock, &hdr, MSG_TRUNC);
+        break;
+    }
+    }
+
+    if (n > 0) {
+        r->msg_offset = (r->msg_offset + (size_t)n) % r->frame_size;
+    }
+    return n;
+}
+
+// Hands the n bytes delivered by the last receiver_recv() to fn, in stream
+// order. prev_offset is r->msg_offset as it was before that call. The trunc
+// strategy never sees the data, so it produces no spans.
+static inline void receiver_for_each_span(const receiver_t* r, size_t prev_offset, ssize_t n,
+                                          recv_span_fn fn, void* ctx) {
+    if (n <= 0) {
+        return;
+    }
+    switch (r->mode) {
+    case RECV_MODE_RECV:
+        fn(ctx, r->buffer, (size_t)n);
+        break;
+    case RECV_MODE_WAITALL:
+        fn(ctx, r->buffer + prev_offset, (size_t)n);
+        break;
+    case RECV_MODE_READV: {
+        size_t pos = prev_offset;
+        size_t left = (size_t)n;
+        while (left > 0) {
+            const char* base;
+            size_t avail;
+            if (pos < r->msg_size) {
+                int i = schema_field_at(r->schema, pos);
+                base = r->msg->field[i] + (pos - r->schema->offset[i]);
+                avail = r->schema->size[i] - (pos - r->schema->offset[i]);
+            } else {
+                base = r->trailer + (pos - r->msg_size);
+                avail = r->frame_size - pos;
+            }
+            if (avail > left) avail = left;
+            fn(ctx, base, avail);
+            pos += avail;
+            left -= avail;
+        }
+        break;
+    }
+    case RECV_MODE_TRUNC:
+        break;
+    }
+}
+
+static inline void receiver_destroy(receiver_t* r) {
+    free(r->buffer);
+    free_message(r->msg);
+    r->buffer = NULL;
+    r->msg = NULL;
+}
+
+#endif // MT25043_RECV_H
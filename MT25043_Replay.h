@@ -0,0 +1,406 @@
+// MT25043
+//
+// File: MT25043_Replay.h
+//
+// Description: Workload trace replay. A workload trace is a recorded
+// sequence of messages (gap since the previous message, message layout)
+// written by MT25043_Part_D_Workload.py; a server started with --replay
+// sends exactly those sizes, field layouts and gaps instead of fixed-size
+// messages back to back, with its own copy strategy (two-copy server:
+// copy + send, one-copy: sendmsg, zero-copy: MSG_ZEROCOPY).
+//
+// Trace file (little endian):
+//   header  : "MT25WKL1", uint32 num_layouts, uint32 reserved, uint64 num_records
+//   layouts : uint32 num_fields, then num_fields x uint32 field size
+//   records : uint64 gap_ns, uint32 layout index
+// Distinct layouts are stored once, so a record is 12 bytes.
+//
+// Replayed messages are stamped frames (see MT25043_Message.h): a frame
+// header carries the layout and the send time, so a client decoding with
+// --deserialize finds the variable-size messages and reports their latency.
+// The schedule is open loop: a late message is sent at once, and a sender
+// that falls more than REPLAY_MAX_LAG_NS behind restarts the schedule
+// instead of bursting the backlog. The trace loops until the test ends.
+// ============================================================================
+
+#ifndef MT25043_REPLAY_H
+#define MT25043_REPLAY_H
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/errqueue.h>
+
+#include "MT25043_Message.h"
+#include "MT25043_Copy.h"
+#include "MT25043_Duplex.h"
+#include "MT25043_Hist.h"
+#include "MT25043_Metrics.h"
+
+#define REPLAY_MAGIC "MT25WKL1"
+#define REPLAY_MAX_LAYOUTS 65536
+#define REPLAY_MAX_LAG_NS 10000000L     // 10 ms behind: restart the schedule
+#define REPLAY_SPIN_NS 50000L           // Spin (not sleep) for the last 50 us of a gap
+#define REPLAY_HEADER_SLOTS 1024        // Stamped headers in flight (MSG_ZEROCOPY)
+
+typedef struct __attribute__((packed)) {
+    uint64_t gap_ns;
+    uint32_t layout;
+} replay_record_t;
+
+// Loaded once and shared by every connection (read-only).
+typedef struct {
+    int num_layouts;
+    schema_t* layouts;          // Stamped framed schemas (field 0 = header)
+    char** headers;             // Frame header of each layout, stamp zeroed
+    size_t num_records;
+    replay_record_t* records;
+    size_t field_max[MAX_FIELDS]; // Largest size of each field across layouts
+    size_t largest;             // Largest message, frame header included
+    uint64_t span_ns;           // Duration of one pass over the trace
+    uint64_t bytes;             // Data bytes of one pass
+} replay_trace_t;
+
+typedef struct {
+    const replay_trace_t* trace;
+    int sock;
+    tx_strategy_t strategy;
+    char* fields[MAX_FIELDS];   // Shared data buffers, field_max[i] bytes each
+    char* header_slots;         // Stamped headers, one slot per send in flight
+    size_t slot_size;
+    char* buffer;               // Copy strategy: the gathered frame
+    struct iovec iov[MAX_FIELDS];
+    struct msghdr hdr;
+    size_t cursor;
+    long next_ns;               // Scheduled send time of the next record
+    uint64_t zc_sent;           // MSG_ZEROCOPY sends issued / completed
+    uint64_t zc_done;
+    long messages;
+    long bytes;
+    long passes;
+    long restarts;
+    hist_t lateness;            // Actual minus scheduled send time
+    long send_ns;
+} replayer_t;
+
+static inline long replay_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static inline void replay_free(replay_trace_t* t) {
+    if (t->headers) {
+        for (int i = 0; i < t->num_layouts; i++) {
+            free(t->headers[i]);
+        }
+    }
+    free(t->headers);
+    free(t->layouts);
+    free(t->records);
+    memset(t, 0, sizeof(*t));
+}
+
+static inline int replay_load(replay_trace_t* t, const char* path) {
+    memset(t, 0, sizeof(*t));
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        perror("Replay: cannot open trace");
+        return -1;
+    }
+    char magic[8];
+    uint32_t num_layouts, reserved;
+    uint64_t num_records;
+    if (fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0 ||
+        fread(&num_layouts, sizeof(num_layouts), 1, fp) != 1 || fread(&reserved, sizeof(reserved), 1, fp) != 1 ||
+        fread(&num_records, sizeof(num_records), 1, fp) != 1) {
+        fprintf(stderr, "Replay: %s is not a workload trace\n", path);
+        fclose(fp);
+        return -1;
+    }
+    if (num_layouts == 0 || num_layouts > REPLAY_MAX_LAYOUTS || num_records == 0) {
+        fprintf(stderr, "Replay: %s has %u layouts and %llu records\n", path, num_layouts,
+                (unsigned long long)num_records);
+        fclose(fp);
+        return -1;
+    }
+
+    t->num_layouts = (int)num_layouts;
+    t->layouts = (schema_t*)calloc(num_layouts, sizeof(schema_t));
+    t->headers = (char**)calloc(num_layouts, sizeof(char*));
+    t->records = (replay_record_t*)malloc(num_records * sizeof(replay_record_t));
+    if (!t->layouts || !t->headers || !t->records) {
+        perror("Replay: cannot allocate trace");
+        fclose(fp);
+        replay_free(t);
+        return -1;
+    }
+    for (uint32_t l = 0; l < num_layouts; l++) {
+        schema_t* s = &t->layouts[l];
+        uint32_t n;
+        if (fread(&n, sizeof(n), 1, fp) != 1 || n == 0 || n >= MAX_FIELDS) {
+            fprintf(stderr, "Replay: layout %u of %s is invalid (1-%d fields)\n", l, path, MAX_FIELDS - 1);
+            fclose(fp);
+            replay_free(t);
+            return -1;
+        }
+        // Field 0 is the stamped frame header, the data fields follow
+        s->num_fields = (int)n + 1;
+        s->size[0] = FRAME_STAMPED_HEADER_SIZE(n);
+        for (uint32_t i = 1; i <= n; i++) {
+            uint32_t size;
+            if (fread(&size, sizeof(size), 1, fp) != 1) {
+                fprintf(stderr, "Replay: %s is truncated\n", path);
+                fclose(fp);
+                replay_free(t);
+                return -1;
+            }
+            s->size[i] = size;
+            if (size > t->field_max[i]) {
+                t->field_max[i] = size;
+            }
+        }
+        s->framed = 1;
+        schema_finish(s);
+        if (s->total > t->largest) {
+            t->largest = s->total;
+        }
+        t->headers[l] = (char*)malloc(s->size[0]);
+        if (!t->headers[l]) {
+            perror("Replay: cannot allocate frame header");
+            fclose(fp);
+            replay_free(t);
+            return -1;
+        }
+        frame_header_write(t->headers[l], s);
+        ((frame_header_t*)t->headers[l])->magic = FRAME_MAGIC_STAMPED;
+        if (s->size[0] > t->field_max[0]) {
+            t->field_max[0] = s->size[0];
+        }
+    }
+    if (fread(t->records, sizeof(replay_record_t), num_records, fp) != num_records) {
+        fprintf(stderr, "Replay: %s is truncated\n", path);
+        fclose(fp);
+        replay_free(t);
+        return -1;
+    }
+    fclose(fp);
+    t->num_records = (size_t)num_records;
+    for (size_t i = 0; i < t->num_records; i++) {
+        if (t->records[i].layout >= num_layouts) {
+            fprintf(stderr, "Replay: record %zu of %s uses layout %u of %u\n", i, path, t->records[i].layout,
+                    num_layouts);
+            replay_free(t);
+            return -1;
+        }
+        t->span_ns += t->records[i].gap_ns;
+        const schema_t* s = &t->layouts[t->records[i].layout];
+        t->bytes += s->total - s->size[0];
+    }
+    return 0;
+}
+
+static inline void replay_print(const replay_trace_t* t, const char* path) {
+    double span_s = t->span_ns / 1e9;
+    printf("Server replay: %s, %zu messages in %.3f s (%.1f msg/s, %.3f Gbps offered), %d layouts, "
+           "largest %zu bytes with header\n", path, t->num_records, span_s,
+           span_s > 0 ? t->num_records / span_s : 0.0, span_s > 0 ? t->bytes * 8.0 / span_s / 1e9 : 0.0,
+           t->num_layouts, t->largest);
+}
+
+static inline void replayer_destroy(replayer_t* r) {
+    for (int i = 0; i < MAX_FIELDS; i++) {
+        free(r->fields[i]);
+        r->fields[i] = NULL;
+    }
+    free(r->header_slots);
+    free(r->buffer);
+    r->header_slots = NULL;
+    r->buffer = NULL;
+}
+
+static inline int replayer_init(replayer_t* r, const replay_trace_t* t, int sock, tx_strategy_t strategy) {
+    memset(r, 0, sizeof(*r));
+    r->trace = t;
+    r->sock = sock;
+    r->strategy = strategy;
+    hist_init(&r->lateness);
+    for (int i = 1; i < MAX_FIELDS; i++) {
+        if (t->field_max[i] == 0) {
+            continue;
+        }
+        r->fields[i] = (char*)malloc(t->field_max[i]);
+        if (!r->fields[i]) {
+            perror("Replay: cannot allocate field buffer");
+            replayer_destroy(r);
+            return -1;
+        }
+        memset(r->fields[i], 'A' + i % 26, t->field_max[i]);
+    }
+    // Zero-copy keeps a header pinned until its completion: one slot per send
+    r->slot_size = t->field_max[0];
+    int slots = strategy == TX_STRATEGY_ZEROCOPY ? REPLAY_HEADER_SLOTS : 1;
+    r->header_slots = (char*)malloc(r->slot_size * slots);
+    if (!r->header_slots) {
+        perror("Replay: cannot allocate header slots");
+        replayer_destroy(r);
+        return -1;
+    }
+    if (strategy == TX_STRATEGY_COPY) {
+        r->buffer = (char*)malloc(t->largest);
+        if (!r->buffer) {
+            perror("Replay: cannot allocate send buffer");
+            replayer_destroy(r);
+            return -1;
+        }
+    }
+    int one = 1;
+    if (strategy == TX_STRATEGY_ZEROCOPY && setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+        perror("setsockopt SO_ZEROCOPY (replay falls back to sendmsg)");
+        r->strategy = TX_STRATEGY_SENDMSG;
+    }
+    r->hdr.msg_iov = r->iov;
+    r->next_ns = replay_now_ns();
+    return 0;
+}
+
+// Drains MSG_ZEROCOPY completions; with block set, waits for at least one.
+static inline void replayer_reap(replayer_t* r, int block) {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+    struct msghdr msg;
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(r->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (!block || errno != EAGAIN) {
+                return;
+            }
+            struct pollfd pfd = { .fd = r->sock, .events = 0, .revents = 0 };
+            if (poll(&pfd, 1, 100) <= 0 || !(pfd.revents & POLLERR)) {
+                return;
+            }
+            continue;
+        }
+        block = 0;
+        struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+        if (!cm) {
+            continue;
+        }
+        struct sock_extended_err* err = (struct sock_extended_err*)CMSG_DATA(cm);
+        if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+            continue;
+        }
+        uint32_t count = err->ee_data - err->ee_info + 1;
+        metrics_completions(count, err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED ? count : 0);
+        if ((uint64_t)err->ee_data + 1 > r->zc_done) {
+            // TCP completes sends in order: [ee_info, ee_data] ends the prefix
+            r->zc_done = (uint64_t)err->ee_data + 1;
+        }
+    }
+}
+
+// Waits for the next record's send time, then sends it. Returns the bytes
+// sent, 0 when the next send falls after deadline_ns, or < 0 on error.
+static inline ssize_t replayer_send_next(replayer_t* r, long deadline_ns) {
+    const replay_trace_t* t = r->trace;
+    const replay_record_t* rec = &t->records[r->cursor];
+    const schema_t* s = &t->layouts[rec->layout];
+
+    long due = r->next_ns + (long)rec->gap_ns;
+    if (due > deadline_ns) {
+        return 0;
+    }
+    long now = replay_now_ns();
+    if (due - now > REPLAY_SPIN_NS) {
+        struct timespec ts = { .tv_sec = (due - REPLAY_SPIN_NS) / 1000000000L,
+                               .tv_nsec = (due - REPLAY_SPIN_NS) % 1000000000L };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    while ((now = replay_now_ns()) < due) {
+        // Spin out the rest of the gap for sub-50 us accuracy
+    }
+    hist_record(&r->lateness, (uint64_t)(now - due));
+    if (now - due > REPLAY_MAX_LAG_NS) {
+        due = now;
+        r->restarts++;
+    }
+    r->next_ns = due;
+
+    // Stamp the header in a slot the kernel no longer references
+    char* header = r->header_slots;
+    if (r->strategy == TX_STRATEGY_ZEROCOPY) {
+        while (r->zc_sent - r->zc_done >= REPLAY_HEADER_SLOTS) {
+            replayer_reap(r, 1);
+        }
+        header += (r->zc_sent % REPLAY_HEADER_SLOTS) * r->slot_size;
+    }
+    size_t layout_size = s->size[0] - FRAME_STAMP_SIZE;
+    uint64_t stamp = (uint64_t)now;
+    memcpy(header, t->headers[rec->layout], layout_size);
+    memcpy(header + layout_size, &stamp, sizeof(stamp));
+
+    // The client may stop first: report the replay instead of dying of SIGPIPE
+    ssize_t sent;
+    if (r->strategy == TX_STRATEGY_COPY) {
+        memcpy(r->buffer, header, s->size[0]);
+        for (int i = 1; i < s->num_fields; i++) {
+            memcpy(r->buffer + s->offset[i], r->fields[i], s->size[i]);
+        }
+        sent = send(r->sock, r->buffer, s->total, MSG_NOSIGNAL);
+    } else {
+        r->iov[0].iov_base = header;
+        r->iov[0].iov_len = s->size[0];
+        for (int i = 1; i < s->num_fields; i++) {
+            r->iov[i].iov_base = r->fields[i];
+            r->iov[i].iov_len = s->size[i];
+        }
+        r->hdr.msg_iovlen = (size_t)s->num_fields;
+        if (r->strategy == TX_STRATEGY_ZEROCOPY) {
+            sent = sendmsg(r->sock, &r->hdr, MSG_ZEROCOPY | MSG_NOSIGNAL);
+            if (sent < 0 && errno == EOPNOTSUPP) {
+                // Software kTLS rejects MSG_ZEROCOPY: stay on plain sendmsg()
+                r->strategy = TX_STRATEGY_SENDMSG;
+                sent = sendmsg(r->sock, &r->hdr, MSG_NOSIGNAL);
+            } else if (sent > 0) {
+                r->zc_sent++;
+                replayer_reap(r, 0);
+            }
+        } else {
+            sent = sendmsg(r->sock, &r->hdr, MSG_NOSIGNAL);
+        }
+    }
+    r->send_ns += replay_now_ns() - now;
+    if (sent <= 0) {
+        return sent < 0 ? sent : -1;
+    }
+    metrics_tx((size_t)sent, (uint64_t)now);
+
+    r->messages++;
+    r->bytes += sent;
+    if (++r->cursor == t->num_records) {
+        r->cursor = 0;
+        r->passes++;
+    }
+    return sent;
+}
+
+static inline void replayer_report(const replayer_t* r, int sock, double elapsed_s) {
+    printf("Server: Socket %d replayed %ld messages with %s (%.2f passes over the trace): %.3f Gbps, "
+           "%.3f us per send\n", sock, r->messages, tx_strategy_name(r->strategy),
+           r->passes + (double)r->cursor / r->trace->num_records,
+           elapsed_s > 0 ? r->bytes * 8.0 / elapsed_s / 1e9 : 0.0,
+           r->messages > 0 ? r->send_ns / 1000.0 / r->messages : 0.0);
+    printf("Server: Socket %d schedule lateness p50 %.3f us, p99 %.3f us, max %.3f us; %ld restarts after "
+           "falling %ld ms behind\n", sock, hist_percentile(&r->lateness, 0.50) / 1000.0,
+           hist_percentile(&r->lateness, 0.99) / 1000.0, r->lateness.max / 1000.0, r->restarts,
+           REPLAY_MAX_LAG_NS / 1000000L);
+}
+
+#endif // MT25043_REPLAY_H
@@ -0,0 +1,187 @@
+// MT25043
+//
+// File: MT25043_TcpInfo.h
+//
+// Description: Per-connection TCP_INFO sampling. A side thread calls
+// getsockopt(TCP_INFO) on every registered socket at a fixed interval and
+// appends one CSV row per socket: congestion window, RTT, retransmits,
+// queue depths, delivery and pacing rate, and the time the connection was
+// limited by the receive window or the send buffer. Rows carry wall-clock
+// time, so server and client files line up with each other and with the
+// throughput timeline; goodput_mbps is the byte delta since the last row.
+//
+// Connection threads call tcpinfo_register() after the handshake and
+// tcpinfo_unregister() before close(); the hot path is untouched. Past
+// TCPINFO_MAX_SOCKETS connections the rest are not sampled (a warning says
+// so).
+// ============================================================================
+
+#ifndef MT25043_TCPINFO_H
+#define MT25043_TCPINFO_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/tcp.h>
+
+#define TCPINFO_MAX_SOCKETS 16384   // Matches MEM_MAX_SOCKETS and METRICS_MAX_SLOTS
+#define TCPINFO_DEFAULT_INTERVAL_MS 100
+
+typedef struct {
+    int sock;
+    int conn;               // Connection number, unique even if fds are reused
+    int active;
+    uint64_t last_bytes;    // bytes_acked (sender) + bytes_received (receiver)
+    double last_time;
+} tcpinfo_slot_t;
+
+typedef struct {
+    FILE* out;
+    char role[32];
+    int interval_ms;
+    int next_conn;
+    double start_time;
+    long rows;
+    int unslotted;          // Registered connections without a slot
+    pthread_mutex_t lock;   // Guards slots and out; never taken on the hot path
+    tcpinfo_slot_t slots[TCPINFO_MAX_SOCKETS];
+} tcpinfo_sampler_t;
+
+static tcpinfo_sampler_t* g_tcpinfo = NULL;
+
+static inline double tcpinfo_now(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Caller holds the lock.
+static inline void tcpinfo_sample_slot(tcpinfo_sampler_t* s, tcpinfo_slot_t* slot) {
+    struct tcp_info info;
+    memset(&info, 0, sizeof(info)); // Older kernels fill a prefix only
+    socklen_t len = sizeof(info);
+    if (getsockopt(slot->sock, IPPROTO_TCP, TCP_INFO, &info, &len) < 0) {
+        return;
+    }
+    double now = tcpinfo_now(CLOCK_MONOTONIC);
+    uint64_t bytes = info.tcpi_bytes_acked + info.tcpi_bytes_received;
+    double goodput = now > slot->last_time ? (bytes - slot->last_bytes) * 8.0 / (now - slot->last_time) / 1e6 : 0.0;
+    slot->last_bytes = bytes;
+    slot->last_time = now;
+
+    fprintf(s->out, "%.6f,%.6f,%s,%d,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%.3f,%.3f,%.3f,%llu,%llu,%llu\n",
+            tcpinfo_now(CLOCK_REALTIME), now - s->start_time, s->role, slot->conn, slot->sock,
+            (unsigned)info.tcpi_state, info.tcpi_snd_cwnd, info.tcpi_snd_ssthresh,
+            info.tcpi_rtt, info.tcpi_rttvar, info.tcpi_retransmits, info.tcpi_total_retrans,
+            info.tcpi_lost, info.tcpi_unacked, info.tcpi_notsent_bytes, info.tcpi_snd_wnd, info.tcpi_rcv_space,
+            goodput, info.tcpi_delivery_rate * 8.0 / 1e6, info.tcpi_pacing_rate * 8.0 / 1e6,
+            (unsigned long long)info.tcpi_busy_time, (unsigned long long)info.tcpi_rwnd_limited,
+            (unsigned long long)info.tcpi_sndbuf_limited);
+    s->rows++;
+}
+
+static inline void* tcpinfo_thread(void* arg) {
+    tcpinfo_sampler_t* s = (tcpinfo_sampler_t*)arg;
+    struct timespec interval = { s->interval_ms / 1000, (long)(s->interval_ms % 1000) * 1000000L };
+    while (1) {
+        nanosleep(&interval, NULL);
+        pthread_mutex_lock(&s->lock);
+        for (int i = 0; i < TCPINFO_MAX_SOCKETS; i++) {
+            if (s->slots[i].active) {
+                tcpinfo_sample_slot(s, &s->slots[i]);
+            }
+        }
+        fflush(s->out); // Rows must survive the harness kill
+        pthread_mutex_unlock(&s->lock);
+    }
+    return NULL;
+}
+
+// Opens path, writes the CSV header and starts the sampling thread.
+static inline int tcpinfo_start(const char* path, const char* role, int interval_ms) {
+    tcpinfo_sampler_t* s = (tcpinfo_sampler_t*)calloc(1, sizeof(tcpinfo_sampler_t));
+    if (!s) {
+        perror("TCP_INFO: failed to allocate sampler");
+        return -1;
+    }
+    s->out = fopen(path, "w");
+    if (!s->out) {
+        perror("TCP_INFO: cannot open output");
+        free(s);
+        return -1;
+    }
+    const char* base = strrchr(role, '/');
+    snprintf(s->role, sizeof(s->role), "%s", base ? base + 1 : role);
+    s->interval_ms = interval_ms > 0 ? interval_ms : TCPINFO_DEFAULT_INTERVAL_MS;
+    s->start_time = tcpinfo_now(CLOCK_MONOTONIC);
+    pthread_mutex_init(&s->lock, NULL);
+    fprintf(s->out, "Unix_Time,Elapsed_s,Role,Conn,Socket,State,Cwnd,Ssthresh,Rtt_us,Rttvar_us,"
+                    "Retransmits,Total_Retrans,Lost,Unacked,Notsent_Bytes,Snd_Wnd,Rcv_Space,"
+                    "Goodput_Mbps,Delivery_Rate_Mbps,Pacing_Rate_Mbps,Busy_us,Rwnd_Limited_us,Sndbuf_Limited_us\n");
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, tcpinfo_thread, s) != 0) {
+        perror("TCP_INFO: failed to start sampler");
+        fclose(s->out);
+        free(s);
+        return -1;
+    }
+    pthread_detach(thread);
+    g_tcpinfo = s;
+    printf("TCP_INFO: sampling every %d ms into %s\n", s->interval_ms, path);
+    return 0;
+}
+
+static inline void tcpinfo_register(int sock) {
+    tcpinfo_sampler_t* s = g_tcpinfo;
+    if (!s) {
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    int slotted = 0;
+    for (int i = 0; i < TCPINFO_MAX_SOCKETS; i++) {
+        if (!s->slots[i].active) {
+            s->slots[i].sock = sock;
+            s->slots[i].conn = s->next_conn++;
+            s->slots[i].last_bytes = 0;
+            s->slots[i].last_time = tcpinfo_now(CLOCK_MONOTONIC);
+            s->slots[i].active = 1;
+            slotted = 1;
+            break;
+        }
+    }
+    if (!slotted && s->unslotted++ == 0) {
+        fprintf(stderr, "TCP_INFO: more than %d connections, the rest are not sampled\n", TCPINFO_MAX_SOCKETS);
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Takes a final sample and stops sampling sock. Call before close(sock).
+static inline void tcpinfo_unregister(int sock) {
+    tcpinfo_sampler_t* s = g_tcpinfo;
+    if (!s) {
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    int found = 0;
+    for (int i = 0; i < TCPINFO_MAX_SOCKETS; i++) {
+        if (s->slots[i].active && s->slots[i].sock == sock) {
+            tcpinfo_sample_slot(s, &s->slots[i]);
+            s->slots[i].active = 0;
+            fflush(s->out);
+            found = 1;
+            break;
+        }
+    }
+    if (!found && s->unslotted > 0) {
+        s->unslotted--;
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+#endif // MT25043_TCPINFO_H
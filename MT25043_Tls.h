@@ -0,0 +1,144 @@
+// MT25043
+//
+// File: MT25043_Tls.h
+//
+// Description: Kernel TLS (kTLS) transport mode. After the plaintext R/G
+// handshake both ends attach the "tls" ULP and install fixed AES-GCM-128
+// TLS 1.2 keys with setsockopt(SOL_TLS, TLS_TX / TLS_RX), so every send is
+// encrypted in the kernel and every recv decrypted there. There is no TLS
+// handshake: the keys are compile-time test constants and must never be
+// used for real traffic.
+//
+// Each direction has its own key set, so a full-duplex connection (client
+// 'D') installs TLS_TX and TLS_RX on both ends.
+//
+// The software kTLS path encrypts from the caller's pages into its own
+// record buffers. That encryption is itself the copy into the kernel, so
+// MSG_ZEROCOPY is rejected (EOPNOTSUPP) and splice() loses its zero-copy
+// property. The senders fall back to plain sendmsg() where needed.
+//
+// ktls_session_t also measures thread CPU time over the connection, so the
+// per-connection report gives CPU ns per byte with and without encryption.
+// ============================================================================
+
+#ifndef MT25043_TLS_H
+#define MT25043_TLS_H
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+#include <sys/socket.h>
+#include <linux/tls.h>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+typedef enum {
+    KTLS_DOWNSTREAM = 0,    // Server to client: the benchmark stream
+    KTLS_UPSTREAM           // Client to server: duplex traffic
+} ktls_direction_t;
+
+// Fixed test keys, one set per direction
+static const unsigned char ktls_keys[2][TLS_CIPHER_AES_GCM_128_KEY_SIZE] = {
+    { 0x4d, 0x54, 0x32, 0x35, 0x30, 0x34, 0x33, 0x2d, 0x64, 0x6f, 0x77, 0x6e, 0x00, 0x01, 0x02, 0x03 },
+    { 0x4d, 0x54, 0x32, 0x35, 0x30, 0x34, 0x33, 0x2d, 0x75, 0x70, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05 }
+};
+static const unsigned char ktls_salts[2][TLS_CIPHER_AES_GCM_128_SALT_SIZE] = {
+    { 0xd0, 0x00, 0x00, 0x01 },
+    { 0x00, 0x0a, 0x00, 0x02 }
+};
+static const unsigned char ktls_ivs[2][TLS_CIPHER_AES_GCM_128_IV_SIZE] = {
+    { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 },
+    { 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11 }
+};
+
+// Attaches the TLS ULP; must happen once before ktls_install().
+static inline int ktls_attach(int sock) {
+    if (setsockopt(sock, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+        perror(errno == ENOENT ? "setsockopt TCP_ULP tls (is the tls module loaded? modprobe tls)"
+                               : "setsockopt TCP_ULP tls");
+        return -1;
+    }
+    return 0;
+}
+
+// Installs the key set of direction as TLS_TX or TLS_RX on sock.
+static inline int ktls_install(int sock, int optname, ktls_direction_t direction) {
+    struct tls12_crypto_info_aes_gcm_128 info;
+    memset(&info, 0, sizeof(info));
+    info.info.version = TLS_1_2_VERSION;
+    info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+    memcpy(info.key, ktls_keys[direction], sizeof(info.key));
+    memcpy(info.salt, ktls_salts[direction], sizeof(info.salt));
+    memcpy(info.iv, ktls_ivs[direction], sizeof(info.iv));
+    // Record sequence numbers start at 0 on both ends
+    if (setsockopt(sock, SOL_TLS, optname, &info, sizeof(info)) < 0) {
+        perror(optname == TLS_TX ? "setsockopt TLS_TX" : "setsockopt TLS_RX");
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    int enabled;
+    struct timespec start_cpu;      // CLOCK_THREAD_CPUTIME_ID: user + system
+    struct timespec start_time;
+} ktls_session_t;
+
+// Server side: encrypts the stream and, for duplex, decrypts the upstream.
+static inline int ktls_server_start(ktls_session_t* s, int sock, int enabled, int duplex) {
+    s->enabled = enabled;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &s->start_cpu);
+    clock_gettime(CLOCK_MONOTONIC, &s->start_time);
+    if (!enabled) {
+        return 0;
+    }
+    if (ktls_attach(sock) < 0 || ktls_install(sock, TLS_TX, KTLS_DOWNSTREAM) < 0) {
+        return -1;
+    }
+    if (duplex && ktls_install(sock, TLS_RX, KTLS_UPSTREAM) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Client side: the mirror image of ktls_server_start().
+static inline int ktls_client_start(int sock, int duplex) {
+    if (ktls_attach(sock) < 0 || ktls_install(sock, TLS_RX, KTLS_DOWNSTREAM) < 0) {
+        return -1;
+    }
+    if (duplex && ktls_install(sock, TLS_TX, KTLS_UPSTREAM) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Reports throughput and sender CPU per byte (user + system time of the
+// connection thread over the bytes the client acknowledged).
+static inline void ktls_session_report(const ktls_session_t* s, int client_socket) {
+    struct timespec end_cpu, end_time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end_cpu);
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double elapsed = (end_time.tv_sec - s->start_time.tv_sec) + (end_time.tv_nsec - s->start_time.tv_nsec) / 1e9;
+    long cpu_ns = (end_cpu.tv_sec - s->start_cpu.tv_sec) * 1000000000L + (end_cpu.tv_nsec - s->start_cpu.tv_nsec);
+
+    struct tcp_info info;
+    memset(&info, 0, sizeof(info));
+    socklen_t len = sizeof(info);
+    if (getsockopt(client_socket, IPPROTO_TCP, TCP_INFO, &info, &len) < 0 || info.tcpi_bytes_acked == 0) {
+        return;
+    }
+    printf("Server: Socket %d %s: %.3f Gbps, CPU %.3f ns/byte (%.1f%% of the thread's time)\n", client_socket,
+           s->enabled ? "kTLS AES-GCM-128" : "plaintext",
+           elapsed > 0 ? info.tcpi_bytes_acked * 8.0 / elapsed / 1e9 : 0.0,
+           (double)cpu_ns / info.tcpi_bytes_acked, elapsed > 0 ? 100.0 * cpu_ns / (elapsed * 1e9) : 0.0);
+}
+
+#endif // MT25043_TLS_H
@@ -0,0 +1,263 @@
+// MT25043
+//
+// File: MT25043_Trace.h
+//
+// Description: Low-overhead event tracer for the send/recv hot paths.
+// Every traced thread owns a ring of rdtsc-timestamped events; recording
+// is a branch, an rdtsc and a 24-byte store, with no locks and no
+// syscalls. When the ring is full the oldest events are overwritten.
+//
+// trace_init(path) enables tracing and dumps all rings to path in a
+// binary format at exit, including on SIGINT/SIGTERM, since the servers
+// are stopped with kill. MT25043_Part_D_Trace.py converts dumps to Chrome
+// trace / Perfetto JSON or prints a per-phase time breakdown (--summary).
+//
+// Phases are recorded as BEGIN/END pairs; the arg of an END event is the
+// byte count of the operation where there is one.
+// ============================================================================
+
+#ifndef MT25043_TRACE_H
+#define MT25043_TRACE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#define TRACE_MAGIC "MT25TRC1"
+#define TRACE_MAX_THREADS 16384
+#define TRACE_DEFAULT_EVENTS (1 << 20)  // Per thread, 24 MB
+#define TRACE_SESSION_BUDGET (1 << 23)  // Events shared by all coroutine sessions, 192 MB
+#define TRACE_MIN_EVENTS 1024
+#define TRACE_LABEL_SIZE 32
+
+// Keep in sync with EVENT_NAMES in MT25043_Part_D_Trace.py
+typedef enum {
+    TRACE_SEND_BEGIN = 0,   // send()/sendmsg()/splice() of one batch or frame
+    TRACE_SEND_END,
+    TRACE_ERRQ_BEGIN,       // MSG_ERRQUEUE drain
+    TRACE_ERRQ_END,
+    TRACE_COMPLETION,       // Instant: zero-copy completions, arg = count
+    TRACE_RECV_BEGIN,       // One receive syscall
+    TRACE_RECV_END,
+    TRACE_CLOCK_BEGIN,      // Duration check (gettimeofday)
+    TRACE_CLOCK_END,
+    TRACE_FILL_BEGIN,       // Payload generation / gather into the send buffer
+    TRACE_FILL_END,
+    TRACE_VERIFY_BEGIN,     // Receive-side checksum verification
+    TRACE_VERIFY_END
+} trace_type_t;
+
+typedef struct {
+    uint64_t tsc;
+    uint64_t arg;
+    uint32_t type;
+    uint32_t thread;
+} trace_event_t;
+
+typedef struct {
+    trace_event_t* events;
+    uint64_t head;          // Total events recorded (wraps into mask)
+    uint64_t mask;
+    uint32_t thread;
+    int32_t sock;
+} trace_ring_t;
+
+// File layout: header, then for each ring a trace_ring_header_t followed by
+// its events oldest first. All fields are native endian (x86-64).
+typedef struct {
+    char magic[8];
+    uint32_t num_threads;
+    uint32_t reserved;
+    double ticks_per_ns;
+    uint64_t base_tsc;
+    uint64_t base_ns;       // CLOCK_MONOTONIC at base_tsc
+    char label[TRACE_LABEL_SIZE];
+} trace_file_header_t;
+
+typedef struct {
+    uint32_t thread;
+    int32_t sock;
+    uint64_t count;
+    uint64_t dropped;       // Overwritten before the dump
+} trace_ring_header_t;
+
+static trace_ring_t* g_trace_rings[TRACE_MAX_THREADS];
+static uint32_t g_trace_num_rings = 0;
+static uint64_t g_trace_ring_events = TRACE_DEFAULT_EVENTS;
+static char g_trace_file[256];
+static trace_file_header_t g_trace_header;
+static volatile sig_atomic_t g_trace_dumped = 0;
+static __thread trace_ring_t* t_trace_ring = NULL;
+
+static inline int trace_enabled(void) {
+    return g_trace_file[0] != '\0';
+}
+
+// Hot path: no-op unless this thread called trace_thread_start().
+static inline void trace_event(trace_type_t type, uint64_t arg) {
+    trace_ring_t* ring = t_trace_ring;
+    if (__builtin_expect(ring == NULL, 1)) {
+        return;
+    }
+    trace_event_t* e = &ring->events[ring->head & ring->mask];
+    e->tsc = __rdtsc();
+    e->arg = arg;
+    e->type = (uint32_t)type;
+    e->thread = ring->thread;
+    ring->head++;
+}
+
+static inline int trace_write_all(int fd, const void* data, size_t len) {
+    const char* p = (const char*)data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Async-signal-safe: only open/write/close on preallocated state.
+static inline void trace_dump(void) {
+    if (!trace_enabled() || g_trace_dumped) {
+        return;
+    }
+    g_trace_dumped = 1;
+    int fd = open(g_trace_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    uint32_t num_rings = __atomic_load_n(&g_trace_num_rings, __ATOMIC_ACQUIRE);
+    if (num_rings > TRACE_MAX_THREADS) num_rings = TRACE_MAX_THREADS;
+    trace_file_header_t header = g_trace_header;
+    header.num_threads = num_rings;
+    trace_write_all(fd, &header, sizeof(header));
+
+    for (uint32_t i = 0; i < num_rings; i++) {
+        trace_ring_t* ring = g_trace_rings[i];
+        trace_ring_header_t rh;
+        memset(&rh, 0, sizeof(rh));
+        uint64_t head = ring ? ring->head : 0;
+        uint64_t capacity = ring ? ring->mask + 1 : 0;
+        rh.thread = i;
+        rh.sock = ring ? ring->sock : -1;
+        rh.count = head < capacity ? head : capacity;
+        rh.dropped = head - rh.count;
+        trace_write_all(fd, &rh, sizeof(rh));
+        if (rh.count == 0) continue;
+
+        // Oldest first: the tail of the ring, then its start
+        uint64_t first = (head - rh.count) & ring->mask;
+        uint64_t tail = capacity - first < rh.count ? capacity - first : rh.count;
+        trace_write_all(fd, &ring->events[first], tail * sizeof(trace_event_t));
+        trace_write_all(fd, ring->events, (rh.count - tail) * sizeof(trace_event_t));
+    }
+    close(fd);
+}
+
+static inline void trace_signal_handler(int sig) {
+    trace_dump();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static inline void trace_atexit(void) {
+    trace_dump();
+}
+
+static inline uint64_t trace_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Enables tracing to path. Calibrates the TSC against CLOCK_MONOTONIC for
+// about 20 ms and installs the exit and signal dump hooks.
+static inline int trace_init(const char* path, const char* label, uint64_t events_per_thread) {
+    if (strlen(path) >= sizeof(g_trace_file)) {
+        fprintf(stderr, "Trace: path too long: %s\n", path);
+        return -1;
+    }
+    if (events_per_thread > 0) {
+        // Round down to a power of two for the ring mask
+        g_trace_ring_events = 1;
+        while (g_trace_ring_events * 2 <= events_per_thread) g_trace_ring_events *= 2;
+    }
+
+    const char* base = strrchr(label, '/');
+    label = base ? base + 1 : label;
+    memset(&g_trace_header, 0, sizeof(g_trace_header));
+    memcpy(g_trace_header.magic, TRACE_MAGIC, sizeof(g_trace_header.magic));
+    snprintf(g_trace_header.label, sizeof(g_trace_header.label), "%s", label);
+
+    uint64_t ns0 = trace_monotonic_ns();
+    uint64_t tsc0 = __rdtsc();
+    struct timespec pause = { 0, 20 * 1000 * 1000 };
+    nanosleep(&pause, NULL);
+    uint64_t ns1 = trace_monotonic_ns();
+    uint64_t tsc1 = __rdtsc();
+    g_trace_header.ticks_per_ns = (double)(tsc1 - tsc0) / (double)(ns1 - ns0);
+    g_trace_header.base_tsc = tsc1;
+    g_trace_header.base_ns = ns1;
+
+    snprintf(g_trace_file, sizeof(g_trace_file), "%s", path);
+    atexit(trace_atexit);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = trace_signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("Trace: %s, %lu events per thread, TSC %.3f GHz\n", path,
+           (unsigned long)g_trace_ring_events, g_trace_header.ticks_per_ns);
+    return 0;
+}
+
+// Ring size for sessions coroutine sessions: they share TRACE_SESSION_BUDGET
+// instead of taking TRACE_DEFAULT_EVENTS each. Pass to trace_init().
+static inline uint64_t trace_session_events(int sessions) {
+    uint64_t events = sessions > 0 ? TRACE_SESSION_BUDGET / (uint64_t)sessions : TRACE_DEFAULT_EVENTS;
+    if (events > TRACE_DEFAULT_EVENTS) events = TRACE_DEFAULT_EVENTS;
+    return events > TRACE_MIN_EVENTS ? events : TRACE_MIN_EVENTS;
+}
+
+// Gives the calling thread its own ring. Call outside the hot path; rings
+// live until the dump so that finished connections stay in the trace.
+static inline void trace_thread_start(int sock) {
+    if (!trace_enabled() || t_trace_ring != NULL) {
+        return;
+    }
+    uint32_t slot = __atomic_fetch_add(&g_trace_num_rings, 1, __ATOMIC_ACQ_REL);
+    if (slot >= TRACE_MAX_THREADS) {
+        if (slot == TRACE_MAX_THREADS) {
+            fprintf(stderr, "Trace: more than %d threads, the rest are not traced\n", TRACE_MAX_THREADS);
+        }
+        return;
+    }
+    trace_ring_t* ring = (trace_ring_t*)calloc(1, sizeof(trace_ring_t));
+    trace_event_t* events = ring ? (trace_event_t*)malloc(g_trace_ring_events * sizeof(trace_event_t)) : NULL;
+    if (!events) {
+        perror("Trace: failed to allocate ring");
+        free(ring);
+        return;
+    }
+    ring->events = events;
+    ring->mask = g_trace_ring_events - 1;
+    ring->thread = slot;
+    ring->sock = sock;
+    __atomic_store_n(&g_trace_rings[slot], ring, __ATOMIC_RELEASE);
+    t_trace_ring = ring;
+}
+
+#endif // MT25043_TRACE_H
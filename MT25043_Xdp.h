@@ -0,0 +1,450 @@
+// MT25043
+//
+// File: MT25043_Xdp.h
+//
+// Description: AF_XDP (kernel-bypass) transport shared by the A6 sender and
+// receiver, written against the raw kernel interfaces (socket options,
+// mmap()ed rings and the bpf() syscall) so it needs no libbpf or libxdp.
+//
+// One UMEM (a page-aligned area of XDP_NUM_FRAMES frames) backs all four
+// rings of the socket:
+// - fill / RX       : the first half of the frames; the receiver hands empty
+//                     frames to the kernel on the fill ring and gets them
+//                     back, holding a packet, on the RX ring
+// - TX / completion : the second half; the sender writes packets into free
+//                     frames, posts them on the TX ring and gets them back
+//                     on the completion ring once the kernel sent them
+//
+// The receiver attaches a small XDP program that redirects frames with the
+// benchmark ethertype into the socket's XSKMAP slot and passes everything
+// else (ARP, the TCP control connection) to the normal stack. The program
+// is attached through a bpf_link, so it goes away when the receiver exits.
+//
+// Wire format: one Ethernet frame per chunk of a message, carrying a
+// 16-byte chunk header (frame sequence number, message number, offset and
+// message length) and up to xsk_chunk_max() bytes of the message's fields.
+// There is no retransmission: gaps in the sequence numbers are lost frames.
+// ============================================================================
+
+#ifndef MT25043_XDP_H
+#define MT25043_XDP_H
+
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+
+#include "MT25043_Message.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+#define XDP_NUM_FRAMES 4096
+#define XDP_FRAME_SIZE 2048
+#define XDP_RING_SIZE 2048
+#define XDP_BATCH 64
+#define ETH_P_MT25043 0x88B5        // IEEE 802 local experimental ethertype
+#define XDP_READY_SIGNAL 'X'        // Control handshake: 'X' + receiver MAC
+
+typedef enum {
+    XDP_MODE_SKB = 0,               // Generic XDP: works on any device
+    XDP_MODE_NATIVE                 // Driver XDP (veth supports it)
+} xdp_mode_t;
+
+static const char* const xdp_mode_names[] = { "skb", "native" };
+
+typedef struct __attribute__((packed)) {
+    uint32_t seq;                   // Frame sequence number
+    uint32_t msg;                   // Message number
+    uint32_t offset;                // Offset of this chunk in the message
+    uint32_t msg_len;
+} xdp_chunk_hdr_t;
+
+typedef struct {
+    uint32_t* producer;
+    uint32_t* consumer;
+    uint32_t* flags;
+    void* ring;
+    uint32_t size;
+    uint32_t mask;
+    uint32_t cached_prod;
+    uint32_t cached_cons;
+    void* map;
+    size_t map_len;
+} xsk_ring_t;
+
+typedef struct {
+    int fd;
+    int ifindex;
+    uint32_t queue;
+    xdp_mode_t mode;
+    int zerocopy;                   // Bound in zero-copy mode (driver support)
+    char* umem;
+    size_t umem_len;
+    xsk_ring_t fill;
+    xsk_ring_t comp;
+    xsk_ring_t rx;
+    xsk_ring_t tx;
+    uint64_t tx_free[XDP_NUM_FRAMES / 2];
+    int num_tx_free;
+    int map_fd;
+    int prog_fd;
+    int link_fd;
+} xsk_t;
+
+static inline int parse_xdp_mode(const char* name, xdp_mode_t* mode) {
+    for (int i = 0; i < (int)(sizeof(xdp_mode_names) / sizeof(xdp_mode_names[0])); i++) {
+        if (strcasecmp(name, xdp_mode_names[i]) == 0) {
+            *mode = (xdp_mode_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline const char* xdp_mode_name(xdp_mode_t mode) {
+    return xdp_mode_names[mode];
+}
+
+// Message bytes per frame: bounded by the MTU and by what fits in a UMEM
+// frame behind the kernel's XDP headroom.
+static inline size_t xsk_chunk_max(int mtu) {
+    size_t frame = XDP_FRAME_SIZE - XDP_PACKET_HEADROOM - ETH_HLEN;
+    size_t l2 = (size_t)mtu < frame ? (size_t)mtu : frame;
+    return l2 - sizeof(xdp_chunk_hdr_t);
+}
+
+// --- Interface lookups ---
+
+static inline int xdp_ifreq(const char* ifname, unsigned long request, struct ifreq* ifr) {
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(ifr, 0, sizeof(*ifr));
+    strncpy(ifr->ifr_name, ifname, IFNAMSIZ - 1);
+    int rc = ioctl(s, request, ifr);
+    if (rc < 0) {
+        perror(ifname);
+    }
+    close(s);
+    return rc;
+}
+
+static inline int xdp_if_mac(const char* ifname, unsigned char mac[ETH_ALEN]) {
+    struct ifreq ifr;
+    if (xdp_ifreq(ifname, SIOCGIFHWADDR, &ifr) < 0) {
+        return -1;
+    }
+    memcpy(mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+    return 0;
+}
+
+static inline int xdp_if_mtu(const char* ifname) {
+    struct ifreq ifr;
+    return xdp_ifreq(ifname, SIOCGIFMTU, &ifr) < 0 ? -1 : ifr.ifr_mtu;
+}
+
+// --- Rings ---
+
+static inline int xsk_ring_map(xsk_ring_t* r, int fd, const struct xdp_ring_offset* off, size_t entry_size,
+                               off_t pgoff) {
+    r->size = XDP_RING_SIZE;
+    r->mask = XDP_RING_SIZE - 1;
+    r->map_len = off->desc + XDP_RING_SIZE * entry_size;
+    r->map = mmap(NULL, r->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, pgoff);
+    if (r->map == MAP_FAILED) {
+        perror("mmap AF_XDP ring");
+        r->map = NULL;
+        return -1;
+    }
+    r->producer = (uint32_t*)((char*)r->map + off->producer);
+    r->consumer = (uint32_t*)((char*)r->map + off->consumer);
+    r->flags = (uint32_t*)((char*)r->map + off->flags);
+    r->ring = (char*)r->map + off->desc;
+    r->cached_prod = *r->producer;
+    r->cached_cons = *r->consumer;
+    return 0;
+}
+
+// Producer side (fill, TX): reserves up to n entries, returns how many.
+static inline uint32_t xsk_prod_reserve(xsk_ring_t* r, uint32_t n, uint32_t* idx) {
+    uint32_t free = r->size - (r->cached_prod - r->cached_cons);
+    if (free < n) {
+        r->cached_cons = __atomic_load_n(r->consumer, __ATOMIC_ACQUIRE);
+        free = r->size - (r->cached_prod - r->cached_cons);
+    }
+    if (n > free) n = free;
+    *idx = r->cached_prod;
+    r->cached_prod += n;
+    return n;
+}
+
+static inline void xsk_prod_submit(xsk_ring_t* r) {
+    __atomic_store_n(r->producer, r->cached_prod, __ATOMIC_RELEASE);
+}
+
+// Consumer side (RX, completion): peeks up to n entries, returns how many.
+static inline uint32_t xsk_cons_peek(xsk_ring_t* r, uint32_t n, uint32_t* idx) {
+    uint32_t avail = r->cached_prod - r->cached_cons;
+    if (avail == 0) {
+        r->cached_prod = __atomic_load_n(r->producer, __ATOMIC_ACQUIRE);
+        avail = r->cached_prod - r->cached_cons;
+    }
+    if (n > avail) n = avail;
+    *idx = r->cached_cons;
+    r->cached_cons += n;
+    return n;
+}
+
+static inline void xsk_cons_release(xsk_ring_t* r) {
+    __atomic_store_n(r->consumer, r->cached_cons, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t* xsk_addr(xsk_ring_t* r, uint32_t idx) {
+    return &((uint64_t*)r->ring)[idx & r->mask];
+}
+
+static inline struct xdp_desc* xsk_desc(xsk_ring_t* r, uint32_t idx) {
+    return &((struct xdp_desc*)r->ring)[idx & r->mask];
+}
+
+static inline int xsk_needs_wakeup(const xsk_ring_t* r) {
+    return (__atomic_load_n(r->flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP) != 0;
+}
+
+// --- XDP program ---
+
+static inline int xdp_bpf(int cmd, union bpf_attr* attr) {
+    return (int)syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+#define XDP_INSN(c, d, s, o, i) ((struct bpf_insn){ .code = (c), .dst_reg = (d), .src_reg = (s), .off = (o), .imm = (i) })
+
+// Loads the redirect program and its XSKMAP, inserts the socket at its
+// queue index and attaches the program to the interface.
+static inline int xsk_attach_program(xsk_t* x) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(int);
+    attr.max_entries = 64;
+    x->map_fd = xdp_bpf(BPF_MAP_CREATE, &attr);
+    if (x->map_fd < 0) {
+        perror("bpf BPF_MAP_CREATE (XSKMAP)");
+        return -1;
+    }
+
+    // r6 = ctx; if the frame is too short or not ETH_P_MT25043 return
+    // XDP_PASS, else return bpf_redirect_map(xsks, rx_queue_index, XDP_PASS)
+    struct bpf_insn prog[] = {
+        XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0),
+        XDP_INSN(BPF_LDX | BPF_W | BPF_MEM, 2, 6, offsetof(struct xdp_md, data), 0),
+        XDP_INSN(BPF_LDX | BPF_W | BPF_MEM, 3, 6, offsetof(struct xdp_md, data_end), 0),
+        XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0),
+        XDP_INSN(BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, ETH_HLEN),
+        XDP_INSN(BPF_JMP | BPF_JGT | BPF_X, 4, 3, 8, 0),
+        XDP_INSN(BPF_LDX | BPF_H | BPF_MEM, 4, 2, offsetof(struct ethhdr, h_proto), 0),
+        XDP_INSN(BPF_JMP | BPF_JNE | BPF_K, 4, 0, 6, htons(ETH_P_MT25043)),
+        XDP_INSN(BPF_LDX | BPF_W | BPF_MEM, 2, 6, offsetof(struct xdp_md, rx_queue_index), 0),
+        XDP_INSN(BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, x->map_fd),
+        XDP_INSN(0, 0, 0, 0, 0),
+        XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS),
+        XDP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+        XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS),
+        XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+    };
+    static char log[4096];
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uint64_t)(uintptr_t)prog;
+    attr.insn_cnt = sizeof(prog) / sizeof(prog[0]);
+    attr.license = (uint64_t)(uintptr_t)"GPL";
+    attr.log_buf = (uint64_t)(uintptr_t)log;
+    attr.log_size = sizeof(log);
+    attr.log_level = 1;
+    x->prog_fd = xdp_bpf(BPF_PROG_LOAD, &attr);
+    if (x->prog_fd < 0) {
+        perror("bpf BPF_PROG_LOAD (XDP redirect)");
+        fprintf(stderr, "%s", log);
+        return -1;
+    }
+
+    uint32_t key = x->queue;
+    int value = x->fd;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = x->map_fd;
+    attr.key = (uint64_t)(uintptr_t)&key;
+    attr.value = (uint64_t)(uintptr_t)&value;
+    attr.flags = BPF_ANY;
+    if (xdp_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+        perror("bpf BPF_MAP_UPDATE_ELEM (XSKMAP)");
+        return -1;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = x->prog_fd;
+    attr.link_create.target_ifindex = x->ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = x->mode == XDP_MODE_SKB ? XDP_FLAGS_SKB_MODE : XDP_FLAGS_DRV_MODE;
+    x->link_fd = xdp_bpf(BPF_LINK_CREATE, &attr);
+    if (x->link_fd < 0) {
+        perror(errno == EBUSY ? "bpf BPF_LINK_CREATE (another XDP program is attached)" : "bpf BPF_LINK_CREATE (XDP)");
+        return -1;
+    }
+    return 0;
+}
+
+// --- Socket ---
+
+// Creates the UMEM and all four rings and binds to ifname/queue. With rx,
+// fills the fill ring and attaches the redirect program.
+static inline int xsk_open(xsk_t* x, const char* ifname, uint32_t queue, xdp_mode_t mode, int rx) {
+    memset(x, 0, sizeof(*x));
+    x->fd = x->map_fd = x->prog_fd = x->link_fd = -1;
+    x->queue = queue;
+    x->mode = mode;
+    x->ifindex = (int)if_nametoindex(ifname);
+    if (x->ifindex == 0) {
+        perror(ifname);
+        return -1;
+    }
+
+    x->umem_len = (size_t)XDP_NUM_FRAMES * XDP_FRAME_SIZE;
+    x->umem = (char*)mmap(NULL, x->umem_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (x->umem == MAP_FAILED) {
+        perror("mmap UMEM");
+        x->umem = NULL;
+        return -1;
+    }
+    x->fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (x->fd < 0) {
+        perror("socket AF_XDP");
+        return -1;
+    }
+
+    struct xdp_umem_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.addr = (uint64_t)(uintptr_t)x->umem;
+    reg.len = x->umem_len;
+    reg.chunk_size = XDP_FRAME_SIZE;
+    if (setsockopt(x->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+        perror("setsockopt XDP_UMEM_REG");
+        return -1;
+    }
+    int ring_size = XDP_RING_SIZE;
+    if (setsockopt(x->fd, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size, sizeof(ring_size)) < 0 ||
+        setsockopt(x->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ring_size, sizeof(ring_size)) < 0 ||
+        setsockopt(x->fd, SOL_XDP, XDP_RX_RING, &ring_size, sizeof(ring_size)) < 0 ||
+        setsockopt(x->fd, SOL_XDP, XDP_TX_RING, &ring_size, sizeof(ring_size)) < 0) {
+        perror("setsockopt AF_XDP ring size");
+        return -1;
+    }
+
+    struct xdp_mmap_offsets off;
+    socklen_t len = sizeof(off);
+    if (getsockopt(x->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &len) < 0) {
+        perror("getsockopt XDP_MMAP_OFFSETS");
+        return -1;
+    }
+    if (xsk_ring_map(&x->fill, x->fd, &off.fr, sizeof(uint64_t), (off_t)XDP_UMEM_PGOFF_FILL_RING) < 0 ||
+        xsk_ring_map(&x->comp, x->fd, &off.cr, sizeof(uint64_t), (off_t)XDP_UMEM_PGOFF_COMPLETION_RING) < 0 ||
+        xsk_ring_map(&x->rx, x->fd, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) < 0 ||
+        xsk_ring_map(&x->tx, x->fd, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) < 0) {
+        return -1;
+    }
+
+    struct sockaddr_xdp sxdp;
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = (uint32_t)x->ifindex;
+    sxdp.sxdp_queue_id = queue;
+    // Generic XDP can only copy; native mode lets the driver pick zero-copy
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | (mode == XDP_MODE_SKB ? XDP_COPY : 0);
+    if (bind(x->fd, (struct sockaddr*)&sxdp, sizeof(sxdp)) < 0) {
+        perror("bind AF_XDP");
+        return -1;
+    }
+    struct xdp_options opts;
+    len = sizeof(opts);
+    if (getsockopt(x->fd, SOL_XDP, XDP_OPTIONS, &opts, &len) == 0) {
+        x->zerocopy = (opts.flags & XDP_OPTIONS_ZEROCOPY) != 0;
+    }
+
+    // Second half of the UMEM: TX frames
+    for (int i = 0; i < XDP_NUM_FRAMES / 2; i++) {
+        x->tx_free[i] = (uint64_t)(XDP_NUM_FRAMES / 2 + i) * XDP_FRAME_SIZE;
+    }
+    x->num_tx_free = XDP_NUM_FRAMES / 2;
+
+    if (!rx) {
+        return 0;
+    }
+    // First half: RX frames, all handed to the kernel up front
+    uint32_t idx;
+    uint32_t n = xsk_prod_reserve(&x->fill, XDP_NUM_FRAMES / 2, &idx);
+    for (uint32_t i = 0; i < n; i++) {
+        *xsk_addr(&x->fill, idx + i) = (uint64_t)i * XDP_FRAME_SIZE;
+    }
+    xsk_prod_submit(&x->fill);
+    return xsk_attach_program(x);
+}
+
+// Returns sent TX frames to the free list.
+static inline int xsk_reclaim(xsk_t* x) {
+    uint32_t idx;
+    uint32_t n = xsk_cons_peek(&x->comp, XDP_RING_SIZE, &idx);
+    for (uint32_t i = 0; i < n; i++) {
+        x->tx_free[x->num_tx_free++] = *xsk_addr(&x->comp, idx + i);
+    }
+    if (n > 0) {
+        xsk_cons_release(&x->comp);
+    }
+    return (int)n;
+}
+
+// Asks the kernel to process the TX ring (needed in copy mode).
+static inline void xsk_kick(xsk_t* x) {
+    if (sendto(x->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 &&
+        errno != EAGAIN && errno != EBUSY && errno != ENOBUFS && errno != ENETDOWN) {
+        perror("sendto AF_XDP");
+    }
+}
+
+static inline void xsk_close(xsk_t* x) {
+    if (x->link_fd >= 0) close(x->link_fd); // Detaches the XDP program
+    if (x->prog_fd >= 0) close(x->prog_fd);
+    if (x->map_fd >= 0) close(x->map_fd);
+    xsk_ring_t* rings[] = { &x->fill, &x->comp, &x->rx, &x->tx };
+    for (int i = 0; i < 4; i++) {
+        if (rings[i]->map) munmap(rings[i]->map, rings[i]->map_len);
+    }
+    if (x->fd >= 0) close(x->fd);
+    if (x->umem) munmap(x->umem, x->umem_len);
+    memset(x, 0, sizeof(*x));
+    x->fd = x->map_fd = x->prog_fd = x->link_fd = -1;
+}
+
+#endif // MT25043_XDP_H